@@ -1,3 +1,9 @@
+#pragma once
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+
 #ifdef _WIN32
 #include <windows.h>
 #else
@@ -6,7 +12,7 @@
 #endif
 
 namespace COMMON {
-    void get_terminal_size(size_t *columns, size_t *rows) {
+    inline void get_terminal_size(size_t *columns, size_t *rows) {
 #ifdef _WIN32
         CONSOLE_SCREEN_BUFFER_INFO csbi;
         GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &csbi);
@@ -20,7 +26,7 @@ namespace COMMON {
 #endif
     }
 
-    std::string formatBytes(size_t bytes) {
+    inline std::string formatBytes(size_t bytes) {
         const char* units[] = { "B", "KB", "MB", "GB", "TB" };
         int unitIndex = 0;
         auto displaySize = (double)bytes;
@@ -1,36 +1,215 @@
 #pragma once
 
 #include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
+#include <sys/uio.h>
+#include "IoUring.hpp"
 
-#define BLOCK_SIZE (512) // 磁盘块大小
+#define DEFAULT_BLOCK_SIZE (512) // 默认磁盘块大小，文件系统按自己的几何参数指定
+#define DEFAULT_STRIPE_BLOCKS (128) // 条带化时默认的条带单元（盘块数）
+#define DIRECT_IO_ALIGNMENT (4096) // 直接读写（O_DIRECT）要求的缓冲区对齐
+
+// 磁盘读写后端
+enum class DiskMode {
+    STREAM, // std::fstream，每次写入后flush
+    POSIX,  // 文件描述符 + pread/pwrite，没有seek状态，持久化交给sync()
+    MMAP,   // 映射整个磁盘文件，读写变为memcpy，sync()为msync
+    URING,  // 与POSIX相同，但批量读写通过io_uring一次提交，可以异步提交
+};
+
+// 磁盘文件在宿主文件系统上的空间分配方式
+enum class ImageAllocation {
+    SPARSE,      // 只ftruncate到目标大小，写过的块才占用宿主空间
+    PREALLOCATE, // 再用fallocate预留全部空间，宿主文件系统可以一次分配物理连续的区段
+};
+
+// 发往宿主文件系统的读写操作次数（合并后的一次向量读写只计一次）
+struct DiskStats {
+    uint64_t read_calls = 0;
+    uint64_t write_calls = 0;
+    uint64_t discard_calls = 0;
+    uint64_t sync_calls = 0;
+};
 
 class DiskManager {
 public:
 
-    explicit DiskManager(const std::string &file_path, const uint32_t& file_size);
+    explicit DiskManager(const std::string &file_path, const uint32_t& file_size, DiskMode mode = DiskMode::POSIX,
+                         const uint32_t& block_size = DEFAULT_BLOCK_SIZE);
+
+    /**
+     * 条带化（RAID-0）：逻辑盘块以stripe_blocks块为单位轮流分布在多个磁盘文件上
+     * 每个磁盘文件有自己的读写队列，submit()时涉及多个文件的批次并行提交
+     * @param file_paths 磁盘文件路径，只有一个时与单文件相同
+     * @param file_size 逻辑磁盘大小（所有文件合计）
+     * @param stripe_blocks 条带单元（盘块数）
+     */
+    DiskManager(const std::vector<std::string> &file_paths, const uint32_t& file_size, DiskMode mode,
+                const uint32_t& block_size, const uint32_t& stripe_blocks);
 
     ~DiskManager();
 
     // 格式化磁盘文件（全部清空）
-    void format();
+    void format(ImageAllocation allocation = ImageAllocation::SPARSE);
 
     // 以盘块为单位读取磁盘
     std::vector<char> read_block(const uint32_t& block_id, const uint32_t& block_num);
 
+    // 以盘块为单位读取磁盘到调用者的缓冲区，buffer至少为 block_num * block_size() 字节
+    void read_block(const uint32_t& block_id, const uint32_t& block_num, char *buffer);
+
     // 以盘块为单位写入磁盘
     void write_block(const uint32_t& block_id, const std::vector<char>& data);
 
+    // 以盘块为单位把调用者的缓冲区写入磁盘，data为 block_num * block_size() 字节
+    void write_block(const uint32_t& block_id, const char *data, const uint32_t& block_num);
+
+    // 批量读写：先排队，submit()时一次提交，全部完成后submit()才返回
+    // 提交前按盘块号排序，物理相邻的请求合并为一次 preadv/pwritev
+    // 同一批次内的请求不保证先后顺序，不能读写重叠的盘块
+    void queue_read(const uint32_t& block_id, const uint32_t& block_num, char *buffer);
+
+    void queue_write(const uint32_t& block_id, const char *data, const uint32_t& block_num);
+
+    void submit();
+
+    // 异步批量读写：submit_async()提交排队的请求后立即返回批次号，不等待完成
+    // 之后由poll()收割已完成的请求，is_complete()查询、wait()等待批次；缓冲区在批次完成前必须保持有效，
+    // 在途的盘块不能再读写。只有URING模式（内核支持io_uring时）真正异步，其他模式在submit_async()中同步完成
+    uint64_t submit_async();
+
+    // 收割已完成的异步请求，不阻塞
+    void poll();
+
+    // 批次是否已经完成（包括失败），批次号仍然有效，直到wait()
+    [[nodiscard]] bool is_complete(const uint64_t &batch);
+
+    // 等待批次完成并释放批次号，批次中有请求失败时抛出异常
+    void wait(const uint64_t &batch);
+
+    // 直接读写：绕过宿主的页缓存（O_DIRECT），用于大块连续数据，同步完成
+    // buffer应按 DIRECT_IO_ALIGNMENT 对齐；宿主不支持O_DIRECT、缓冲区或偏移不满足宿主的对齐要求，
+    // 以及STREAM、MMAP模式下，退化为普通读写
+    void read_direct(const uint32_t& block_id, const uint32_t& block_num, char *buffer);
+
+    void write_direct(const uint32_t& block_id, const char *data, const uint32_t& block_num);
+
+    // 通知宿主文件系统这些盘块不再使用，释放其占用的空间，之后读出为0
+    // 宿主不支持打洞（或STREAM模式）时什么也不做
+    void discard(const uint32_t& block_id, const uint32_t& block_num);
+
+    // 将之前的写入持久化到磁盘（POSIX模式下为fdatasync）
+    void sync();
+
+    [[nodiscard]] DiskMode mode() const {
+        return _mode;
+    }
+
+    [[nodiscard]] uint32_t block_size() const {
+        return _block_size;
+    }
+
+    [[nodiscard]] const DiskStats &stats() const {
+        return _stats;
+    }
+
+    // 磁盘文件数量
+    [[nodiscard]] uint32_t stripe_count() const {
+        return _stripes.empty() ? 1 : _stripes.size();
+    }
+
 private:
+    // 排队中的一个读写请求
+    struct IoRequest {
+        bool write;
+        uint32_t block_id;
+        uint32_t block_num;
+        char *buffer;
+    };
+
+    // 合并后的一段物理连续的读写
+    struct IoRun {
+        bool write;
+        uint32_t block_id;
+        uint32_t block_num;
+        std::vector<iovec> iov;
+    };
+
+    // 异步提交的一个批次
+    struct IoBatch {
+        std::vector<IoRun> runs; // 提交给io_uring的读写，iovec在完成前必须有效
+        uint32_t pending = 0;    // 还没有完成的读写数
+        std::string error;       // 第一个失败的原因，为空表示成功
+        std::vector<std::pair<DiskManager *, uint64_t>> parts; // 条带化时各条带上的批次
+    };
+
+    // 创建（或截断）磁盘文件并设置为_file_size大小，不写入任何数据
+    void _create(ImageAllocation allocation);
+
+    // 打开磁盘文件
+    void _open();
+
+    // 同步执行一段连续读写（POSIX模式下为一次preadv/pwritev）
+    void _transfer(IoRun &run);
+
+    // 取出排队的请求，按盘块号排序，把物理相邻的同类请求合并为一段
+    std::vector<IoRun> _take_runs();
+
+    // 把批次中合并后的读写提交给io_uring，每段一个请求，不等待完成
+    void _submit_uring(const uint64_t &id, IoBatch &batch);
+
+    // 收割io_uring的完成，wait为真时至少等到一个
+    void _reap(const bool &wait);
+
+    // 等待所有在途的异步请求完成，关闭、截断磁盘文件和sync()之前调用
+    void _drain();
+
+    // 关闭磁盘文件
+    void _close();
+
+    // 通过O_DIRECT文件描述符读写一段连续区间，不可用时退化为_read/_write
+    void _direct(bool write, const std::streamoff& position, const std::streamsize& length, char *buffer);
+
+    // 条带化时的直接读写，按条带拆分后并行执行
+    void _direct_striped(bool write, const uint32_t& block_id, const uint32_t& block_num, char *buffer);
+
+    /**
+     * 把逻辑盘块区间按条带单元拆分，对每一段调用 fn(条带, 条带内的盘块号, 在区间中的偏移块数, 块数)
+     */
+    template<typename Fn>
+    void _for_each_stripe_chunk(const uint32_t& block_id, const uint32_t& block_num, Fn fn);
+
+    // 对若干条带分别执行fn，多于一个时并行执行
+    template<typename Fn>
+    void _run_stripes(const std::vector<DiskManager *> &stripes, Fn fn);
+
+    // 汇总各条带的读写次数
+    void _collect_stats();
+
     // 读取磁盘文件的特定部分
-    std::vector<char> _read(const std::streamoff& position, const std::streamsize& length);
+    void _read(const std::streamoff& position, const std::streamsize& length, char *buffer);
 
     // 写入数据到磁盘文件的特定位置
-    void _write(const std::streamoff& position, const std::vector<char>& data);
+    void _write(const std::streamoff& position, const char *data, const std::streamsize& length);
 
 
 private:
     std::string _file_path; // 磁盘文件路径
-    std::fstream _disk_file; // 文件流，用于读写操作
+    std::fstream _disk_file; // 文件流，用于读写操作（STREAM模式）
+    int _fd = -1; // 文件描述符（POSIX、MMAP模式）
+    int _direct_fd = -1; // 以O_DIRECT打开的文件描述符（POSIX、URING模式），宿主不支持时为-1
+    char *_mapping = nullptr; // 磁盘文件的内存映射（MMAP模式）
+    std::unique_ptr<IoUring> _ring; // URING模式的提交队列，内核不支持时为空，退化为同步读写
+    std::vector<IoRequest> _queue; // 等待submit()的请求
+    std::unordered_map<uint64_t, IoBatch> _batches; // 异步提交、还没有wait()的批次
+    uint64_t _next_batch = 1; // 下一个批次号
+    DiskStats _stats; // 读写次数统计
     uint32_t _file_size; // 文件大小
+    uint32_t _block_size; // 盘块大小，块号都按这个大小换算为文件偏移
+    DiskMode _mode; // 读写后端
+    std::vector<std::unique_ptr<DiskManager>> _stripes; // 条带化时每个磁盘文件一个，单文件时为空
+    uint32_t _stripe_blocks = 0; // 条带单元（盘块数）
 };
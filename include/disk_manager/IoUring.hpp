@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/**
+ * io_uring 的最小封装，直接使用 io_uring_setup / io_uring_enter 系统调用，不依赖 liburing
+ * 使用方法：多次 prep_readv / prep_writev 排队，submit 一次提交后立即返回，之后用 reap 收割完成的请求
+ * 在途的请求没有先后顺序，调用者需要保证它们互不重叠；已排队和在途的请求合计不超过队列长度，完成队列不会溢出
+ */
+class IoUring {
+public:
+    // 完成回调：user_data 与 prep_* 时传入的相同，res 为读写的字节数或 -errno
+    using CompletionCallback = std::function<void(uint64_t user_data, int32_t res)>;
+
+    explicit IoUring(const uint32_t &entries);
+
+    ~IoUring();
+
+    IoUring(const IoUring &) = delete;
+
+    IoUring &operator=(const IoUring &) = delete;
+
+    // 还能排队的请求数：队列长度减去已排队和在途（已提交、尚未收割）的请求
+    [[nodiscard]] uint32_t space() const;
+
+    // 在途的请求数
+    [[nodiscard]] uint32_t in_flight() const {
+        return _in_flight;
+    }
+
+    // 向量读写，iov 在请求完成前必须保持有效
+    void prep_readv(const int &fd, const iovec *iov, const uint32_t &count, const uint64_t &offset,
+                    const uint64_t &user_data);
+
+    void prep_writev(const int &fd, const iovec *iov, const uint32_t &count, const uint64_t &offset,
+                     const uint64_t &user_data);
+
+    // 提交所有排队的请求，不等待完成
+    void submit();
+
+    /**
+     * 收割已完成的请求，对每个完成调用 callback
+     * @param wait 为真且有在途请求时，至少等到一个完成；为假时只处理已经完成的，不进入内核等待
+     * @return 收割的请求数
+     */
+    uint32_t reap(const CompletionCallback &callback, const bool &wait);
+
+private:
+    io_uring_sqe *_get_sqe();
+
+    // 进入内核提交还没有被取走的请求，min_complete大于0时等到至少这么多请求完成
+    void _enter(const uint32_t &min_complete);
+
+    // 释放映射和ring的文件描述符
+    void _release();
+
+private:
+    int _ring_fd = -1;
+    uint32_t _entries = 0;
+    uint32_t _queued = 0; // 已排队但还未提交的请求数
+    uint32_t _unsubmitted = 0; // 已发布到提交队列、内核还没有取走的请求数
+    uint32_t _in_flight = 0; // 已发布、尚未收割的请求数
+
+    // 提交队列
+    void *_sq_ring = nullptr;
+    size_t _sq_ring_size = 0;
+    uint32_t *_sq_head = nullptr;
+    uint32_t *_sq_tail = nullptr;
+    uint32_t *_sq_mask = nullptr;
+    uint32_t *_sq_array = nullptr;
+    io_uring_sqe *_sqes = nullptr;
+    size_t _sqes_size = 0;
+
+    // 完成队列
+    void *_cq_ring = nullptr;
+    size_t _cq_ring_size = 0;
+    uint32_t *_cq_head = nullptr;
+    uint32_t *_cq_tail = nullptr;
+    uint32_t *_cq_mask = nullptr;
+    io_uring_cqe *_cqes = nullptr;
+};
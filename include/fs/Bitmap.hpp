@@ -0,0 +1,238 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define BITMAP_AVX2 1
+#endif
+
+#ifdef BITMAP_AVX2
+namespace bitmap_detail {
+    // 运行时检测CPU是否支持AVX2，编译时不需要-mavx2
+    inline const bool HAS_AVX2 = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+
+    // 从first开始跳过全1（ones为真）或全0的字，每次检查4个字（256位），返回第一个不满足的字的下标，最多到last
+    __attribute__((target("avx2")))
+    inline uint32_t skip_words_avx2(const uint64_t *words, uint32_t first, const uint32_t &last, const bool &ones) {
+        const __m256i all = _mm256_set1_epi64x(-1);
+        for (; first + 4 <= last; first += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words + first));
+            if (ones ? !_mm256_testc_si256(v, all) : !_mm256_testz_si256(v, v)) {
+                break;
+            }
+        }
+        return first;
+    }
+}
+#endif
+
+/**
+ * 定长位图，按64位字存放，第i位在第i/64个字的第i%64位，位的排列与之前使用的std::bitset<N>（libstdc++）相同；
+ * 磁盘格式并没有因此保持不变，SuperBlock的头部已经改变，见 Geometry.hpp
+ * 查找按字进行：取反后用ctz找最低的0位，整字全1（或全0）时跳过；支持AVX2时一次跳过4个字
+ * @tparam N 位数
+ */
+template<uint32_t N>
+class Bitmap {
+public:
+    static constexpr uint32_t WORD_COUNT = (N + 63) / 64;
+    static constexpr uint32_t NPOS = UINT32_MAX; // 查找失败
+
+    [[nodiscard]] static constexpr uint32_t size() {
+        return N;
+    }
+
+    [[nodiscard]] bool test(const uint32_t &i) const {
+        return _words[i >> 6] >> (i & 63) & 1;
+    }
+
+    void set(const uint32_t &i) {
+        _words[i >> 6] |= 1ull << (i & 63);
+    }
+
+    void reset(const uint32_t &i) {
+        _words[i >> 6] &= ~(1ull << (i & 63));
+    }
+
+    // 第w个字
+    [[nodiscard]] uint64_t word(const uint32_t &w) const {
+        return _words[w];
+    }
+
+    // 把 [begin, begin + count) 全部置1
+    void set_range(const uint32_t &begin, const uint32_t &count) {
+        _assign_range<true>(begin, count);
+    }
+
+    // 把 [begin, begin + count) 全部清0
+    void reset_range(const uint32_t &begin, const uint32_t &count) {
+        _assign_range<false>(begin, count);
+    }
+
+    // 置1的位数
+    [[nodiscard]] uint32_t count() const {
+        uint32_t result = 0;
+        for (const auto &word: _words) {
+            result += __builtin_popcountll(word);
+        }
+        return result;
+    }
+
+    // [begin, end) 中第一个0位，没有时返回NPOS
+    [[nodiscard]] uint32_t find_zero(const uint32_t &begin, const uint32_t &end) const {
+        return _find<false>(begin, end);
+    }
+
+    // [begin, end) 中第一个1位，没有时返回NPOS
+    [[nodiscard]] uint32_t find_one(const uint32_t &begin, const uint32_t &end) const {
+        return _find<true>(begin, end);
+    }
+
+    // [begin, end) 中第一段连续length个0位的起始位置，没有时返回NPOS
+    [[nodiscard]] uint32_t find_zero_run(const uint32_t &length, const uint32_t &begin, const uint32_t &end) const {
+        uint32_t i = find_zero(begin, end);
+        while (i != NPOS && end - i >= length) {
+            // 窗口 [i, i + length) 中有1位时，从它之后重新找
+            uint32_t one = find_one(i, i + length);
+            if (one == NPOS) {
+                return i;
+            }
+            i = find_zero(one + 1, end);
+        }
+        return NPOS;
+    }
+
+private:
+    template<bool Value>
+    void _assign_range(const uint32_t &begin, const uint32_t &count) {
+        if (count == 0) {
+            return;
+        }
+        const uint32_t end = begin + count;
+        uint32_t first = begin >> 6, last = (end - 1) >> 6;
+        uint64_t head = ~0ull << (begin & 63);
+        uint64_t tail = ~0ull >> (63 - ((end - 1) & 63));
+        auto assign = [this](const uint32_t &w, const uint64_t &mask) {
+            _words[w] = Value ? _words[w] | mask : _words[w] & ~mask;
+        };
+        if (first == last) {
+            assign(first, head & tail);
+            return;
+        }
+        assign(first, head);
+        for (uint32_t w = first + 1; w < last; w++) {
+            _words[w] = Value ? ~0ull : 0;
+        }
+        assign(last, tail);
+    }
+
+    // 找第一个取值为Value的位
+    template<bool Value>
+    [[nodiscard]] uint32_t _find(const uint32_t &begin, const uint32_t &end) const {
+        if (begin >= end) {
+            return NPOS;
+        }
+        const uint32_t last = (end - 1) >> 6;
+        uint32_t w = begin >> 6;
+        uint64_t bits = _load<Value>(w) & (~0ull << (begin & 63));
+        while (bits == 0) {
+            if (++w > last) {
+                return NPOS;
+            }
+            w = _skip<Value>(w, last);
+            bits = _load<Value>(w);
+        }
+        uint32_t i = (w << 6) + __builtin_ctzll(bits);
+        return i < end ? i : NPOS;
+    }
+
+    // 要找1位时原样返回，要找0位时取反
+    template<bool Value>
+    [[nodiscard]] uint64_t _load(const uint32_t &w) const {
+        return Value ? _words[w] : ~_words[w];
+    }
+
+    // 从first开始跳过不含目标位的字，返回第一个可能含有目标位的字的下标，不超过last
+    template<bool Value>
+    [[nodiscard]] uint32_t _skip(uint32_t first, const uint32_t &last) const {
+#ifdef BITMAP_AVX2
+        if (last - first >= 8 && bitmap_detail::HAS_AVX2) {
+            first = bitmap_detail::skip_words_avx2(_words, first, last, !Value);
+        }
+#endif
+        while (first < last && _load<Value>(first) == 0) {
+            first++;
+        }
+        return first;
+    }
+
+private:
+    uint64_t _words[WORD_COUNT]{};
+};
+
+/**
+ * 两级位图：在Bitmap之上为每个字（64位）再记一位，表示这个字中是否有1位，
+ * 查找1位时先看当前字，再在上一级中找到下一个非0的字，不必逐字扫描
+ * N = 32768时上一级只有8个字，查找的代价与置1位的多少无关
+ * @tparam N 位数
+ */
+template<uint32_t N>
+class SummaryBitmap {
+public:
+    static constexpr uint32_t NPOS = Bitmap<N>::NPOS;
+
+    [[nodiscard]] bool test(const uint32_t &i) const {
+        return _bits.test(i);
+    }
+
+    void set(const uint32_t &i) {
+        _bits.set(i);
+        _groups.set(i >> 6);
+    }
+
+    void reset(const uint32_t &i) {
+        _bits.reset(i);
+        if (_bits.word(i >> 6) == 0) {
+            _groups.reset(i >> 6);
+        }
+    }
+
+    void assign(const uint32_t &i, const bool &value) {
+        value ? set(i) : reset(i);
+    }
+
+    [[nodiscard]] uint32_t count() const {
+        return _bits.count();
+    }
+
+    // [begin, end) 中第一个1位，没有时返回NPOS
+    [[nodiscard]] uint32_t find_one(const uint32_t &begin, const uint32_t &end) const {
+        if (begin >= end) {
+            return NPOS;
+        }
+        uint32_t w = begin >> 6;
+        uint64_t bits = _bits.word(w) & (~0ull << (begin & 63));
+        if (bits == 0) {
+            w = _groups.find_one(w + 1, ((end - 1) >> 6) + 1);
+            if (w == NPOS) {
+                return NPOS;
+            }
+            bits = _bits.word(w);
+        }
+        uint32_t i = (w << 6) + __builtin_ctzll(bits);
+        return i < end ? i : NPOS;
+    }
+
+    // [begin, end) 中第一个0位，没有时返回NPOS
+    [[nodiscard]] uint32_t find_zero(const uint32_t &begin, const uint32_t &end) const {
+        return _bits.find_zero(begin, end);
+    }
+
+private:
+    Bitmap<N> _bits;
+    Bitmap<Bitmap<N>::WORD_COUNT> _groups; // 第g位表示_bits的第g个字是否非0
+};
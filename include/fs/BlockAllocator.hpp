@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include "Bitmap.hpp"
+#include "FreeExtents.hpp"
+#include "SuperBlock.hpp"
+
+// 连续分配时选择空闲区间的方式
+enum class Fit {
+    BEST, // 能放下的最短区间，尽量保留长区间
+    NEXT, // 从上次分配的位置（last_i）向后第一个能放下的区间
+};
+
+/**
+ * 数据块分配器：在SuperBlock的block_bitmap之上维护只在内存中的空闲空间索引，分配时直接跳到候选位置
+ *  - _partial: 每个位图字（64块）一位，表示其中还有空闲块，是两级位图，上一级的一位对应64个字即4096块，
+ *    单块分配的代价与磁盘占用率无关
+ *  - _extents: 空闲区间，按起始位置和长度索引，用于连续分配
+ *  - _reserved: 已预留（延迟分配）的块数，其他分配不能占用，预留者分配前先unreserve()
+ * 位图本身仍是唯一的持久化状态：挂载、格式化后调用rebuild()重建索引，之后所有分配和释放都要经过分配器
+ * @tparam G 几何参数
+ */
+template<typename G>
+class BasicBlockAllocator {
+public:
+    using SuperBlock = BasicSuperBlock<G>;
+    static constexpr uint32_t WORD_COUNT = Bitmap<G::BLOCK_COUNT>::WORD_COUNT;
+    static constexpr uint32_t NPOS = Bitmap<G::BLOCK_COUNT>::NPOS;
+
+    explicit BasicBlockAllocator(SuperBlock &super_block) : _super_block(super_block) {
+        rebuild();
+    }
+
+    BasicBlockAllocator(const BasicBlockAllocator &) = delete;
+
+    BasicBlockAllocator &operator=(const BasicBlockAllocator &) = delete;
+
+    // 按位图重建索引，位图被整体替换（挂载、格式化）后调用
+    void rebuild() {
+        const auto &bitmap = _super_block.block_bitmap;
+        for (uint32_t w = 0; w < WORD_COUNT; w++) {
+            _update(w);
+        }
+        // 0号数据块不使用
+        _extents.clear();
+        _free_count = 0;
+        _reserved = 0;
+        for (uint32_t i = bitmap.find_zero(1, G::BLOCK_COUNT); i != NPOS;) {
+            uint32_t end = bitmap.find_one(i, G::BLOCK_COUNT);
+            if (end == NPOS) {
+                end = G::BLOCK_COUNT;
+            }
+            _extents.insert(i, end - i);
+            _free_count += end - i;
+            i = bitmap.find_zero(end, G::BLOCK_COUNT);
+        }
+    }
+
+    // 可以分配的块数，不包括已预留的
+    [[nodiscard]] uint32_t free_count() const {
+        return _free_count - _reserved;
+    }
+
+    /**
+     * 预留block_num块，之后的分配不会占用它们，空间不足时抛出异常
+     * 预留的块还没有确定位置，预留者在分配前调用unreserve()归还同样的块数
+     */
+    void reserve(const uint32_t &block_num) {
+        if (block_num > free_count()) {
+            throw std::runtime_error("No free block");
+        }
+        _reserved += block_num;
+    }
+
+    void unreserve(const uint32_t &block_num) {
+        if (block_num > _reserved) {
+            throw std::logic_error("Unreserving more blocks than reserved");
+        }
+        _reserved -= block_num;
+    }
+
+    // 空闲区间，按起始位置（位图下标）遍历
+    [[nodiscard]] const FreeExtents &free_extents() const {
+        return _extents;
+    }
+
+    /**
+     * 分配一个空闲Block，与SuperBlock::get_free_block相同：从last_i向后找，到末尾后回绕，不使用0号数据块
+     * @return 盘块号
+     */
+    uint32_t get_free_block() {
+        if (free_count() == 0) {
+            throw std::runtime_error("No free block");
+        }
+        auto &bitmap = _super_block.block_bitmap;
+        uint32_t start = _super_block.last_i;
+        uint32_t w = start >> 6;
+        uint64_t bits = ~_used(w) & (~0ull << (start & 63));
+        if (bits == 0) {
+            w = _partial.find_one(w + 1, WORD_COUNT);
+            if (w == NPOS) {
+                // 回绕，包括start所在的字中start之前的部分
+                w = _partial.find_one(0, (start >> 6) + 1);
+            }
+            if (w == NPOS) {
+                throw std::runtime_error("No free block");
+            }
+            bits = ~_used(w);
+        }
+        uint32_t i = (w << 6) + __builtin_ctzll(bits);
+        bitmap.set(i);
+        _update(w);
+        _extents.remove(i, 1);
+        _free_count--;
+        _super_block.dirty_flag = 1;
+        _super_block.last_i = (i + 1) % _super_block.block_count;
+        return i + G::BLOCK_START_INDEX;
+    }
+
+    /**
+     * 分配连续的block_num个空闲Block
+     * @param fit 选择空闲区间的方式，NEXT同时移动last_i
+     * @return 第一个盘块号
+     */
+    uint32_t get_free_blocks(uint32_t block_num, Fit fit = Fit::BEST) {
+        if (block_num == 0) {
+            throw std::invalid_argument("Block count must be positive");
+        }
+        uint32_t i = fit == Fit::BEST ? _extents.best_fit(block_num)
+                                      : _extents.next_fit(block_num, _super_block.last_i);
+        if (i == NPOS || block_num > free_count()) {
+            throw std::runtime_error("No free blocks");
+        }
+        _take(i, block_num);
+        if (fit == Fit::NEXT) {
+            _super_block.last_i = (i + block_num) % _super_block.block_count;
+        }
+        return i + G::BLOCK_START_INDEX;
+    }
+
+    /**
+     * 分配最多block_num个连续的空闲Block：有足够长的空闲区间时按下次适配，否则取最长的空闲区间
+     * 用于一次为文件分配很多块，空闲空间零碎时分几次调用
+     * @return {第一个盘块号, 块数}
+     */
+    std::pair<uint32_t, uint32_t> get_free_run(const uint32_t &block_num) {
+        const uint32_t length = std::min({block_num, _extents.largest(), free_count()});
+        if (length == 0) {
+            throw std::runtime_error("No free block");
+        }
+        uint32_t i = length == block_num ? _extents.next_fit(length, _super_block.last_i)
+                                         : _extents.best_fit(length);
+        _take(i, length);
+        _super_block.last_i = (i + length) % _super_block.block_count;
+        return {i + G::BLOCK_START_INDEX, length};
+    }
+
+    /**
+     * 释放一个Block
+     * @param block_no 盘块号
+     */
+    void free_block(const uint32_t &block_no) {
+        uint32_t i = block_no - G::BLOCK_START_INDEX;
+        if (!_super_block.block_bitmap.test(i)) {
+            return;
+        }
+        _super_block.block_bitmap.reset(i);
+        _update(i >> 6);
+        _extents.insert(i, 1);
+        _free_count++;
+        _super_block.dirty_flag = 1;
+    }
+
+    /**
+     * 释放连续的block_count个Block，它们必须都已分配
+     * @param block_no 第一个盘块号
+     */
+    void free_blocks(const uint32_t &block_no, const uint32_t &block_count) {
+        if (block_count == 0) {
+            return;
+        }
+        uint32_t i = block_no - G::BLOCK_START_INDEX;
+        _super_block.block_bitmap.reset_range(i, block_count);
+        _update_range(i, block_count);
+        _extents.insert(i, block_count);
+        _free_count += block_count;
+        _super_block.dirty_flag = 1;
+    }
+
+private:
+    // 把空闲区间中的 [i, i + block_num) 标记为已分配
+    void _take(const uint32_t &i, const uint32_t &block_num) {
+        _super_block.block_bitmap.set_range(i, block_num);
+        _update_range(i, block_num);
+        _extents.remove(i, block_num);
+        _free_count -= block_num;
+        _super_block.dirty_flag = 1;
+    }
+
+    void _update_range(const uint32_t &i, const uint32_t &block_num) {
+        for (uint32_t w = i >> 6; w <= (i + block_num - 1) >> 6; w++) {
+            _update(w);
+        }
+    }
+
+    // 第w个字中不能分配的位：已分配的，以及0号数据块和位图末尾超出BLOCK_COUNT的位
+    [[nodiscard]] uint64_t _used(const uint32_t &w) const {
+        uint64_t used = _super_block.block_bitmap.word(w);
+        if (w == 0) {
+            used |= 1;
+        }
+        if (w == WORD_COUNT - 1 && G::BLOCK_COUNT % 64 != 0) {
+            used |= ~0ull << (G::BLOCK_COUNT % 64);
+        }
+        return used;
+    }
+
+    // 第w个字改变后更新摘要
+    void _update(const uint32_t &w) {
+        uint64_t used = _used(w);
+        _partial.assign(w, used != ~0ull);
+    }
+
+private:
+    SuperBlock &_super_block;
+    SummaryBitmap<WORD_COUNT> _partial; // 字中还有空闲块
+    FreeExtents _extents;               // 空闲区间，以位图下标表示
+    uint32_t _free_count = 0;           // 空闲块数
+    uint32_t _reserved = 0;             // 已预留的块数
+};
@@ -1,34 +1,98 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
-#include "disk_manager/DiskManager.hpp"
+#include <cstring>
+#include <stdexcept>
+#include "Geometry.hpp"
 
 
-class BufferCache {
+// 侵入式双向链表的节点，缓存块通过它挂在空闲链表或替换策略的队列上
+struct CacheLink {
+    CacheLink *prev = nullptr;
+    CacheLink *next = nullptr;
+    uint8_t tag = 0; // 由替换策略解释：所在队列、访问位等
+};
+
+/**
+ * 高速缓存块的元数据，数据本身在缓存池的数据区中，由attach()指定
+ * 元数据按缓存行对齐，与块数据分开存放：查找、换出只访问元数据，不会把块数据带进CPU缓存
+ * @tparam G 几何参数
+ */
+template<typename G>
+class alignas(64) BasicBufferCache : public CacheLink {
 private:
-    char data[BLOCK_SIZE]{}; // 数据
+    char *data = nullptr; // 数据，G::BLOCK_SIZE字节
     bool dirty = false;  // 是否脏块
+    std::chrono::steady_clock::time_point dirty_since; // 从干净变为脏的时间
+    uint32_t pin_count = 0; // 持有者数量，大于0时不会被换出
 public:
 
     uint32_t block_no = 0;  // 块号
-    BufferCache() = default;
+    uint32_t owner_inode = 0; // 作为文件数据页时所属的Inode编号，0表示不是文件数据页
+    uint32_t owner_block = 0; // 作为文件数据页时的文件块号
+    BasicBufferCache() = default;
+
+    // 指定存放数据的内存，由缓存池在初始化时调用
+    void attach(char *block_data) {
+        data = block_data;
+    }
 
     [[nodiscard]] bool is_dirty() const {
         return dirty;
     }
 
     void set_dirty(const bool& d) {
+        if (d && !dirty) {
+            dirty_since = std::chrono::steady_clock::now();
+        }
         this->dirty = d;
     }
 
+    // 延迟分配的文件页：有数据，但还没有分配盘块，不能写回
+    [[nodiscard]] bool is_delayed() const {
+        return dirty && block_no == 0;
+    }
+
+    [[nodiscard]] bool is_pinned() const {
+        return pin_count != 0;
+    }
+
+    // 增加一个持有者，返回增加前是否未被持有
+    bool pin() {
+        return pin_count++ == 0;
+    }
+
+    // 减少一个持有者，返回减少后是否不再被持有
+    bool unpin() {
+        return --pin_count == 0;
+    }
+
+    // 成为脏块的时间，只对脏块有意义
+    [[nodiscard]] std::chrono::steady_clock::time_point get_dirty_since() const {
+        return dirty_since;
+    }
+
     void clear() {
         block_no = 0;
+        owner_inode = 0;
+        owner_block = 0;
         dirty = false;
-        std::memset(data, 0, BLOCK_SIZE);
+        pin_count = 0;
+        std::memset(data, 0, G::BLOCK_SIZE);
     }
 
     void clear_data() {
-        std::memset(data, 0, BLOCK_SIZE);
+        std::memset(data, 0, G::BLOCK_SIZE);
+    }
+
+    // 整块数据的指针，用于与磁盘直接交换数据，不经过临时缓冲区
+    char *block_data() {
+        return data;
+    }
+
+    [[nodiscard]] const char *block_data() const {
+        return data;
     }
 
     /**
@@ -42,7 +106,7 @@ public:
     template<typename T>
     const T* read(const uint32_t& index) const {
         // 检查是否越界
-        if (index * sizeof(T) + sizeof(T) > BLOCK_SIZE) {
+        if (index * sizeof(T) + sizeof(T) > G::BLOCK_SIZE) {
             throw std::out_of_range("BufferCache::read out of range");
         }
         return reinterpret_cast<const T *>(data + index * sizeof(T));
@@ -62,16 +126,89 @@ public:
         uint32_t offset = index_by_char ? index : index * size;
 
         // 检查是否越界
-        if (offset + size > BLOCK_SIZE) {
+        if (offset + size > G::BLOCK_SIZE) {
             throw std::out_of_range("BufferCache::write out of range");
         }
         const auto& p = reinterpret_cast<const char*>(value);
         std::copy(p, p + size, data + offset);
 
-        dirty = true;
+        set_dirty(true);
 
         // 如果写到末尾了，返回true
-        return offset + size == BLOCK_SIZE;
+        return offset + size == G::BLOCK_SIZE;
     }
 
-};
\ No newline at end of file
+};
+
+using BufferCache = BasicBufferCache<Geometry512>;
+
+/**
+ * 缓存块的侵入式双向链表，带哨兵，插入、删除都是O(1)
+ * @tparam G 几何参数
+ */
+template<typename G>
+class BasicBufferList {
+public:
+    using BufferCache = BasicBufferCache<G>;
+
+    BasicBufferList() {
+        clear();
+    }
+
+    BasicBufferList(const BasicBufferList &) = delete;
+
+    BasicBufferList &operator=(const BasicBufferList &) = delete;
+
+    // 只重置哨兵，不修改原来链表中的缓存块
+    void clear() {
+        _head.prev = _head.next = &_head;
+        _size = 0;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return _size == 0;
+    }
+
+    [[nodiscard]] uint32_t size() const {
+        return _size;
+    }
+
+    // 链表头，即最早插入的缓存块，链表为空时返回nullptr
+    [[nodiscard]] BufferCache *front() const {
+        return empty() ? nullptr : static_cast<BufferCache *>(_head.next);
+    }
+
+    void push_back(BufferCache *cache_block) {
+        cache_block->prev = _head.prev;
+        cache_block->next = &_head;
+        _head.prev->next = cache_block;
+        _head.prev = cache_block;
+        _size++;
+    }
+
+    // 缓存块必须在这个链表中
+    void remove(BufferCache *cache_block) {
+        cache_block->prev->next = cache_block->next;
+        cache_block->next->prev = cache_block->prev;
+        cache_block->prev = cache_block->next = nullptr;
+        _size--;
+    }
+
+    BufferCache *pop_front() {
+        auto cache_block = front();
+        if (cache_block != nullptr) {
+            remove(cache_block);
+        }
+        return cache_block;
+    }
+
+    // 移到链表尾
+    void move_to_back(BufferCache *cache_block) {
+        remove(cache_block);
+        push_back(cache_block);
+    }
+
+private:
+    CacheLink _head; // 哨兵
+    uint32_t _size = 0;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include "BufferCache.hpp"
+
+// 按物理盘块号索引缓存块
+template<typename G>
+struct BlockKey {
+    static uint64_t of(const BasicBufferCache<G> *cache_block) {
+        return cache_block->block_no;
+    }
+};
+
+// 按（Inode编号，文件块号）索引缓存块，即文件的逻辑页
+template<typename G>
+struct PageKey {
+    static uint64_t make(const uint32_t &inode_id, const uint32_t &file_block) {
+        return (uint64_t) inode_id << 32 | file_block;
+    }
+
+    static uint64_t of(const BasicBufferCache<G> *cache_block) {
+        return make(cache_block->owner_inode, cache_block->owner_block);
+    }
+};
+
+/**
+ * 缓存块的开放寻址（线性探测）哈希表，键由Key::of从缓存块中取出，表中只存指针
+ * 删除时把之后的项向前移动填补空位，不使用墓碑
+ * @tparam G 几何参数
+ * @tparam Key 从缓存块取键的方式，见 BlockKey、PageKey
+ */
+template<typename G, typename Key>
+class BasicBufferIndex {
+public:
+    using BufferCache = BasicBufferCache<G>;
+
+    /**
+     * 重新分配哈希表，所有项被清空
+     * @param capacity 最多存放的缓存块数量，表的大小至少是它的两倍，装载因子不超过0.5
+     */
+    void resize(const uint32_t &capacity) {
+        _size = 1;
+        _shift = 64;
+        while (_size < 2ull * capacity) {
+            _size <<= 1;
+            _shift--;
+        }
+        _table = std::make_unique<BufferCache *[]>(_size);
+    }
+
+    void clear() {
+        std::fill(_table.get(), _table.get() + _size, nullptr);
+    }
+
+    // 查找键对应的缓存块，不存在时返回nullptr
+    BufferCache *find(const uint64_t &key) const {
+        for (uint32_t slot = _hash(key); ; slot = (slot + 1) & (_size - 1)) {
+            auto cache_block = _table[slot];
+            if (cache_block == nullptr || Key::of(cache_block) == key) {
+                return cache_block;
+            }
+        }
+    }
+
+    // 登记缓存块，它的键不能已经在表中
+    void insert(BufferCache *cache_block) {
+        auto slot = _hash(Key::of(cache_block));
+        while (_table[slot] != nullptr) {
+            slot = (slot + 1) & (_size - 1);
+        }
+        _table[slot] = cache_block;
+    }
+
+    // 删除键对应的项，键必须在表中
+    void erase(const uint64_t &key) {
+        const uint32_t mask = _size - 1;
+        uint32_t slot = _hash(key);
+        while (Key::of(_table[slot]) != key) {
+            slot = (slot + 1) & mask;
+        }
+        _table[slot] = nullptr;
+        for (uint32_t next = (slot + 1) & mask; _table[next] != nullptr; next = (next + 1) & mask) {
+            uint32_t home = _hash(Key::of(_table[next]));
+            // home不在 (slot, next] 区间内时，这一项可以移到空位上
+            if (((next - home) & mask) >= ((next - slot) & mask)) {
+                _table[slot] = _table[next];
+                _table[next] = nullptr;
+                slot = next;
+            }
+        }
+    }
+
+private:
+    // Fibonacci散列：连续的键被打散到整个表中
+    [[nodiscard]] uint32_t _hash(const uint64_t &key) const {
+        return static_cast<uint32_t>((key * 11400714819323198485ull) >> _shift) & (_size - 1);
+    }
+
+private:
+    std::unique_ptr<BufferCache *[]> _table; // nullptr表示空位
+    uint32_t _size = 0;  // 哈希表大小，2的幂
+    uint32_t _shift = 64; // Fibonacci散列取高位时的右移位数
+};
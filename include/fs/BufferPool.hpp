@@ -0,0 +1,410 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include "BufferCache.hpp"
+#include "BufferIndex.hpp"
+#include "HugePageArena.hpp"
+#include "ReplacementPolicy.hpp"
+
+/**
+ * 高速缓存池：容量在运行时确定的一组缓存块
+ * 缓存块自身带有双向链表的指针（侵入式链表），盘块号到缓存块的映射是开放寻址（线性探测）的哈希表，
+ * 命中时一次探测即可找到；换出哪个块由可替换的策略决定，见 ReplacementPolicy.hpp
+ * 文件数据块还可以登记为（Inode编号，文件块号）的逻辑页，读写文件时不必先经过索引块找到盘块号
+ * 延迟分配时，逻辑页可以先于盘块存在：这样的页不在盘块号哈希表中，一直被钉住，分配盘块后才参与换出
+ * 缓存块的元数据和块数据放在同一个大页arena中的两个区域，块数据区按4KiB对齐，每块按块大小对齐
+ * @tparam G 几何参数
+ */
+template<typename G>
+class BasicBufferPool {
+public:
+    using BufferCache = BasicBufferCache<G>;
+    // arena释放时不调用析构函数
+    static_assert(std::is_trivially_destructible_v<BufferCache>, "Buffer cache metadata must be trivially destructible");
+
+    /**
+     * @param capacity 缓存块数量
+     * @param policy 替换策略
+     */
+    explicit BasicBufferPool(const uint32_t &capacity, CachePolicy policy = CachePolicy::LRU) : _policy_kind(policy) {
+        resize(capacity);
+    }
+
+    BasicBufferPool(const BasicBufferPool &) = delete;
+
+    BasicBufferPool &operator=(const BasicBufferPool &) = delete;
+
+    /**
+     * 改变容量，所有缓存块被清空，脏块需要调用者事先写回
+     * @param capacity 缓存块数量
+     */
+    void resize(const uint32_t &capacity) {
+        _check_unpinned();
+        if (capacity == 0) {
+            throw std::invalid_argument("Buffer pool capacity must be positive");
+        }
+        // 先释放旧的arena，容量很大时不同时占用两份
+        _blocks = nullptr;
+        _capacity = 0;
+        _arena = HugePageArena();
+        _arena = HugePageArena((size_t) capacity * sizeof(BufferCache) + 4096 + (size_t) capacity * G::BLOCK_SIZE);
+        auto blocks = reinterpret_cast<BufferCache *>(
+                _arena.allocate((size_t) capacity * sizeof(BufferCache), alignof(BufferCache)));
+        char *block_data = _arena.allocate((size_t) capacity * G::BLOCK_SIZE, 4096);
+        for (uint32_t i = 0; i < capacity; i++) {
+            new(&blocks[i]) BufferCache();
+            blocks[i].attach(block_data + (size_t) i * G::BLOCK_SIZE);
+        }
+        _blocks = blocks;
+        _capacity = capacity;
+        // 哈希表至少是容量的两倍，装载因子不超过0.5，线性探测的平均探测次数接近1
+        _table.resize(capacity);
+        _pages.resize(capacity);
+        _policy = make_replacement_policy<G>(_policy_kind, capacity);
+        clear();
+    }
+
+    /**
+     * 更换替换策略，所有缓存块被清空，脏块需要调用者事先写回
+     * @param policy 替换策略
+     */
+    void set_policy(CachePolicy policy) {
+        _check_unpinned();
+        _policy_kind = policy;
+        _policy = make_replacement_policy<G>(policy, _capacity);
+        clear();
+    }
+
+    [[nodiscard]] CachePolicy policy() const {
+        return _policy_kind;
+    }
+
+    // 清空所有缓存块，全部放回空闲链表
+    void clear() {
+        _table.clear();
+        _pages.clear();
+        _policy->clear();
+        _free.clear();
+        for (uint32_t i = 0; i < _capacity; i++) {
+            _blocks[i].clear();
+            _free.push_back(&_blocks[i]);
+        }
+        _size = 0;
+        _pinned = 0;
+        _delayed = 0;
+    }
+
+    [[nodiscard]] uint32_t capacity() const {
+        return _capacity;
+    }
+
+    // 已装入盘块的缓存块数量
+    [[nodiscard]] uint32_t size() const {
+        return _size;
+    }
+
+    // 被钉住的缓存块数量
+    [[nodiscard]] uint32_t pinned_count() const {
+        return _pinned;
+    }
+
+    // 延迟分配、还没有盘块的逻辑页数量，包含在pinned_count()中
+    [[nodiscard]] uint32_t delayed_count() const {
+        return _delayed;
+    }
+
+    /**
+     * 查找盘块号对应的缓存块，不改变LRU顺序
+     * @return 缓存块指针，不在缓存中时返回nullptr
+     */
+    BufferCache *find(const uint32_t &block_no) const {
+        return _table.find(block_no);
+    }
+
+    /**
+     * 查找盘块号对应的缓存块，命中时通知替换策略
+     * 被钉住的块不在策略的队列中，放开时才算一次访问
+     * @return 缓存块指针，不在缓存中时返回nullptr
+     */
+    BufferCache *lookup(const uint32_t &block_no) {
+        auto cache_block = find(block_no);
+        if (cache_block != nullptr && !cache_block->is_pinned()) {
+            _policy->on_hit(cache_block);
+        }
+        return cache_block;
+    }
+
+    /**
+     * 为即将装入的盘块取得一个不在哈希表中的缓存块：优先使用空闲块，否则由替换策略选出一个换出
+     * 换出的块保留原来的盘块号和数据，是否为脏块由调用者检查并写回
+     * 被钉住的块不会被换出，所有缓存块都被钉住时抛出异常
+     * @param block_no 即将装入的盘块号，随后应调用insert登记
+     */
+    BufferCache *take(const uint32_t &block_no) {
+        if (_free.empty() && _pinned == _size) {
+            throw std::runtime_error("All buffer cache blocks are pinned");
+        }
+        _policy->on_miss(block_no);
+        auto cache_block = _free.pop_front();
+        if (cache_block == nullptr) {
+            cache_block = _policy->evict(block_no);
+            _table.erase(cache_block->block_no);
+            detach_page(cache_block);
+            _size--;
+        }
+        return cache_block;
+    }
+
+    /**
+     * 把take()得到的缓存块登记为盘块号block_no的缓存
+     */
+    void insert(BufferCache *cache_block, const uint32_t &block_no) {
+        cache_block->block_no = block_no;
+        _table.insert(cache_block);
+        _policy->on_insert(cache_block);
+        _size++;
+    }
+
+    /**
+     * 把缓存块从哈希表中移除并放回空闲链表，数据被清空
+     */
+    void erase(BufferCache *cache_block) {
+        if (cache_block->is_pinned()) {
+            throw std::logic_error("Cannot erase a pinned buffer cache block");
+        }
+        _table.erase(cache_block->block_no);
+        detach_page(cache_block);
+        _policy->on_erase(cache_block);
+        cache_block->clear();
+        _free.push_back(cache_block);
+        _size--;
+    }
+
+    /**
+     * 把take()得到、尚未登记的缓存块放回空闲链表，数据被清空
+     */
+    void release(BufferCache *cache_block) {
+        cache_block->clear();
+        _free.push_back(cache_block);
+    }
+
+    /**
+     * 查找文件的逻辑页，命中时通知替换策略
+     * @param inode_id Inode编号
+     * @param file_block 文件块号
+     * @return 缓存块指针，不在缓存中时返回nullptr
+     */
+    BufferCache *lookup_page(const uint32_t &inode_id, const uint32_t &file_block) {
+        auto cache_block = _pages.find(PageKey<G>::make(inode_id, file_block));
+        if (cache_block != nullptr && !cache_block->is_pinned()) {
+            _policy->on_hit(cache_block);
+        }
+        return cache_block;
+    }
+
+    /**
+     * 把已登记的缓存块同时登记为文件的逻辑页，替换这个逻辑页和这个缓存块原来的登记
+     * @param cache_block 存放文件块数据的缓存块
+     * @param inode_id Inode编号，不能为0
+     * @param file_block 文件块号
+     */
+    void attach_page(BufferCache *cache_block, const uint32_t &inode_id, const uint32_t &file_block) {
+        forget_page(inode_id, file_block);
+        detach_page(cache_block);
+        cache_block->owner_inode = inode_id;
+        cache_block->owner_block = file_block;
+        _pages.insert(cache_block);
+    }
+
+    /**
+     * 把take()得到的缓存块登记为还没有分配盘块的逻辑页（延迟分配），只能通过lookup_page找到
+     * 这样的页被钉住，不会被换出，直到assign()或discard_delayed()
+     * @param cache_block 缓存块，调用者负责清零数据并置为脏块
+     * @param inode_id Inode编号，不能为0
+     * @param file_block 文件块号
+     */
+    void insert_delayed(BufferCache *cache_block, const uint32_t &inode_id, const uint32_t &file_block) {
+        cache_block->block_no = 0;
+        _policy->on_insert(cache_block);
+        _size++;
+        attach_page(cache_block, inode_id, file_block);
+        pin(cache_block);
+        _delayed++;
+    }
+
+    /**
+     * 延迟分配的页分配到了盘块，登记盘块号并放开，之后与普通缓存块相同
+     * 盘块号不能已经在哈希表中，逻辑页登记不变
+     */
+    void assign(BufferCache *cache_block, const uint32_t &block_no) {
+        cache_block->block_no = block_no;
+        _table.insert(cache_block);
+        _delayed--;
+        unpin(cache_block);
+    }
+
+    // 丢弃延迟分配的页（文件被删除），放回空闲链表，数据被清空
+    void discard_delayed(BufferCache *cache_block) {
+        detach_page(cache_block);
+        _delayed--;
+        unpin(cache_block);
+        _policy->on_erase(cache_block);
+        cache_block->clear();
+        _free.push_back(cache_block);
+        _size--;
+    }
+
+    // 取消缓存块的逻辑页登记，缓存块本身仍按盘块号缓存
+    void detach_page(BufferCache *cache_block) {
+        if (cache_block->owner_inode != 0) {
+            _pages.erase(PageKey<G>::of(cache_block));
+            cache_block->owner_inode = 0;
+            cache_block->owner_block = 0;
+        }
+    }
+
+    // 文件块号对应的盘块改变（重新分配）时，取消这个逻辑页的登记
+    void forget_page(const uint32_t &inode_id, const uint32_t &file_block) {
+        auto cache_block = _pages.find(PageKey<G>::make(inode_id, file_block));
+        if (cache_block != nullptr) {
+            detach_page(cache_block);
+        }
+    }
+
+    /**
+     * 文件的数据块全部释放时，取消它所有逻辑页的登记
+     * 逐个查找文件自己的页，文件比缓存还大时改为遍历所有缓存块
+     * @param inode_id Inode编号
+     * @param file_blocks 文件的块数，登记的页都在这之前
+     */
+    void forget_inode(const uint32_t &inode_id, const uint32_t &file_blocks) {
+        if (file_blocks >= _capacity) {
+            for (uint32_t i = 0; i < _capacity; i++) {
+                if (_blocks[i].owner_inode == inode_id) {
+                    detach_page(&_blocks[i]);
+                }
+            }
+            return;
+        }
+        for (uint32_t b = 0; b < file_blocks; b++) {
+            forget_page(inode_id, b);
+        }
+    }
+
+    /**
+     * 钉住已登记的缓存块，在对应的unpin()之前不会被换出，可以重复钉住
+     * 一般通过 BasicBufferHandle 使用
+     */
+    void pin(BufferCache *cache_block) {
+        if (cache_block->pin()) {
+            _policy->on_pin(cache_block);
+            _pinned++;
+        }
+    }
+
+    void unpin(BufferCache *cache_block) {
+        if (cache_block->unpin()) {
+            _policy->on_unpin(cache_block);
+            _pinned--;
+        }
+    }
+
+    // 遍历所有缓存块（包括空闲的），用于写回脏块
+    BufferCache *begin() {
+        return _blocks;
+    }
+
+    BufferCache *end() {
+        return _blocks + _capacity;
+    }
+
+private:
+    // 被钉住的块由外部持有指针，不能重建缓存池
+    void _check_unpinned() const {
+        if (_pinned != 0) {
+            throw std::runtime_error("Buffer cache blocks are still pinned");
+        }
+    }
+
+private:
+    HugePageArena _arena; // 缓存块元数据和块数据
+    BufferCache *_blocks = nullptr; // 缓存块元数据，位于_arena中
+    uint32_t _capacity = 0; // 缓存块数量
+    uint32_t _size = 0; // 已装入盘块的缓存块数量
+    uint32_t _pinned = 0; // 被钉住的缓存块数量
+    uint32_t _delayed = 0; // 还没有盘块的逻辑页数量
+
+    BasicBufferIndex<G, BlockKey<G>> _table; // 盘块号到缓存块
+    BasicBufferIndex<G, PageKey<G>> _pages;  // 逻辑页到缓存块，只包含登记过的文件数据块
+
+    BasicBufferList<G> _free; // 空闲缓存块
+    CachePolicy _policy_kind;
+    std::unique_ptr<BasicReplacementPolicy<G>> _policy; // 管理已装入盘块的缓存块
+};
+
+/**
+ * 缓存块的钉住句柄（RAII）：持有期间缓存块不会被换出，指针和数据一直有效，析构时放开
+ * 只能移动不能复制；多级索引、目录扫描等需要同时使用多个缓存块时，各持有一个句柄即可，不必复制整块数据
+ * @tparam G 几何参数
+ */
+template<typename G>
+class BasicBufferHandle {
+public:
+    using BufferCache = BasicBufferCache<G>;
+
+    BasicBufferHandle() = default;
+
+    BasicBufferHandle(BasicBufferPool<G> &pool, BufferCache *cache_block) : _pool(&pool), _block(cache_block) {
+        _pool->pin(_block);
+    }
+
+    BasicBufferHandle(const BasicBufferHandle &) = delete;
+
+    BasicBufferHandle &operator=(const BasicBufferHandle &) = delete;
+
+    BasicBufferHandle(BasicBufferHandle &&other) noexcept: _pool(other._pool), _block(other._block) {
+        other._block = nullptr;
+    }
+
+    BasicBufferHandle &operator=(BasicBufferHandle &&other) noexcept {
+        if (this != &other) {
+            reset();
+            _pool = other._pool;
+            _block = other._block;
+            other._block = nullptr;
+        }
+        return *this;
+    }
+
+    ~BasicBufferHandle() {
+        reset();
+    }
+
+    // 放开缓存块，句柄变为空
+    void reset() {
+        if (_block != nullptr) {
+            _pool->unpin(_block);
+            _block = nullptr;
+        }
+    }
+
+    [[nodiscard]] BufferCache *get() const {
+        return _block;
+    }
+
+    BufferCache *operator->() const {
+        return _block;
+    }
+
+    explicit operator bool() const {
+        return _block != nullptr;
+    }
+
+private:
+    BasicBufferPool<G> *_pool = nullptr;
+    BufferCache *_block = nullptr;
+};
@@ -8,10 +8,11 @@ public:
     FileType file_type = FileType::NONE; // 0: 未分配 1: 文件 2: 目录
     uint32_t file_size = 0;
     uint32_t block_pointers[10] {}; // 存的值是盘块号
-    uint32_t padding[4] {};
+    uint32_t preallocated_blocks = 0; // fallocate预先分配到的文件块数，可以超出文件大小，旧磁盘上为0
+    uint32_t padding[3] {};
 
     DiskInode() = default;
 
 
 };
-// 4 + 4 + 40 + 16 = 64
\ No newline at end of file
+// 4 + 4 + 40 + 4 + 12 = 64
\ No newline at end of file
@@ -17,12 +17,20 @@ public:
     uint32_t inode_id = 0;
     char file_name[28] {};
 
+    // 顺序预读状态，见 FileSystem::readahead
+    uint32_t readahead_next = 0;   // 顺序读时下一个要读的文件块号
+    uint32_t readahead_window = 0; // 预读窗口（块数），0表示还没有检测到顺序读
+    uint32_t readahead_end = 0;    // 已经预读到的文件块号（不含）
+
     File() = default;
     void clear() {
         reference_count = 0;
         offset = 0;
         inode_id = 0;
         file_name[0] = '\0';
+        readahead_next = 0;
+        readahead_window = 0;
+        readahead_end = 0;
     }
 
     [[nodiscard]] bool is_busy() const {
@@ -1,75 +1,316 @@
 #pragma once
 
-#include <list>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <unordered_map>
 #include <array>
+#include "Geometry.hpp"
 #include "SuperBlock.hpp"
+#include "BlockAllocator.hpp"
 #include "DiskInode.hpp"
 #include "disk_manager/DiskManager.hpp"
 #include "Inode.hpp"
 #include "File.hpp"
 #include "DirectoryEntry.hpp"
 #include "BufferCache.hpp"
+#include "BufferPool.hpp"
+#include "SlotList.hpp"
 #include <functional>
+#include <chrono>
+#include <atomic>
+#include <exception>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #ifdef RUNNING_TESTS
 #define DISK_PATH "disk_dev.img"
 #else
 #define DISK_PATH "disk.img"
 #endif
-#define DISK_SIZE ((SUPER_BLOCK_SIZE + INODE_SIZE + BLOCK_COUNT) * BLOCK_SIZE)
 
-#define MEMORY_INODE_NUM (100)  // 内存Inode数量
 #define OPEN_FILE_NUM (16)      // 同时打开文件数量上限
+#define DISCARD_BATCH_BLOCKS (4096) // 累计释放这么多盘块后批量打洞，其余的在save()时处理
+
+// 持久化策略：什么时候自动把修改写回磁盘并fdatasync
+// 两次持久化之间的所有修改合并为一次提交，只调用一次sync
+// STREAM模式的sync不会fdatasync，只支持NONE
+enum class Durability {
+    NONE,     // 不自动持久化，只在显式save()（包括析构）时持久化
+    PERIODIC, // 定时提交线程每隔一个间隔持久化一次期间的修改，不依赖之后的操作
+    ON_CLOSE, // 关闭文件时持久化
+    PER_OP,   // 每个修改操作（mkdir、touch、rm、fwrite）完成后持久化
+};
+
+#define DEFAULT_COMMIT_INTERVAL_MS (1000) // PERIODIC策略的默认间隔
+
+// 后台写回的默认参数
+#define DIRTY_BACKGROUND_PERCENT (10) // 脏块超过缓存的这个比例时，后台线程开始写回
+#define DIRTY_HARD_PERCENT (40)       // 脏块超过缓存的这个比例时，前台写入先同步写回一批，再继续
+#define DIRTY_EXPIRE_MS (500)         // 脏块在缓存中停留超过这个时间后，由后台线程写回
+#define WRITEBACK_INTERVAL_MS (100)   // 后台线程没有被唤醒时的检查间隔
+#define WRITEBACK_BATCH_BLOCKS (1024)  // 一次写回的最大块数
+
+#define DIRECT_IO_BOUNCE_BYTES (1024 * 1024) // 用户缓冲区未对齐时，直接读写经过的对齐缓冲区大小
+
+/**
+ * 文件系统
+ * @tparam G 几何参数（块大小、块数量、缓存大小等），见 Geometry.hpp
+ */
+template<typename G>
+class BasicFileSystem {
+public:
+    using SuperBlock = BasicSuperBlock<G>;
+    using BufferCache = BasicBufferCache<G>;
+    using BufferHandle = BasicBufferHandle<G>;
 
-#define CACHE_BLOCK_NUM (16)   // 高速缓存块数量
-
-class FileSystem {
 private:
     DiskManager disk_manager;
 
 private:
     // SuperBlock
     SuperBlock super_block;
+    // 数据块的分配和释放都经过它，位图改变后要rebuild()
+    BasicBlockAllocator<G> block_allocator{super_block};
 
     // 打开文件表
     std::array<File, OPEN_FILE_NUM> open_files;
 
     // 内存Inode
-    std::array<Inode, MEMORY_INODE_NUM> m_inodes;
+    std::array<Inode, G::MEMORY_INODE_NUM> m_inodes;
     // 约定：写入数据push_back，读取数据pop_front
-    std::list<Inode *> device_m_inodes;
-    std::list<Inode *> free_m_inodes;
+    SlotList<Inode, G::MEMORY_INODE_NUM> device_m_inodes{m_inodes.data()};
+    SlotList<Inode, G::MEMORY_INODE_NUM> free_m_inodes{m_inodes.data()};
 
     // 内存高速缓存
-    std::array<BufferCache, CACHE_BLOCK_NUM> buffer_cache;
-    // 约定：写入数据push_back，读取数据pop_front
-    std::list<BufferCache *> device_buffer_cache; // 设备缓存队列，有哪些缓存已经被加载在内存中了
-    std::list<BufferCache *> free_buffer_cache; // 空闲缓存队列
-    std::unordered_map<uint32_t, std::list<BufferCache*>::iterator> buffer_cache_map; // 盘块号到缓存块的映射
+    BasicBufferPool<G> buffer_pool;
+
+    // 异步预读：正在读入的缓存块被钉住，读完之前不能使用，盘块号 -> 批次号
+    std::unordered_map<uint32_t, uint64_t> reads_in_flight;
+    // 批次号 -> 批次中的缓存块
+    std::map<uint64_t, std::vector<BufferCache *>> read_batches;
+
+    // 已释放、尚未通知宿主文件系统的盘块号
+    std::vector<uint32_t> freed_blocks;
+
+    // 持久化策略
+    Durability durability = Durability::NONE;
+    std::chrono::milliseconds commit_interval{DEFAULT_COMMIT_INTERVAL_MS};
+    // 上次持久化之后完成的修改操作数
+    uint32_t uncommitted_ops = 0;
+
+    // 组提交：提交在锁内把修改写入操作系统并取得序号，在锁外sync；
+    // sync进行中到达的提交等它结束后，由其中一个再sync一次，覆盖它们全部
+    std::unique_ptr<DiskManager> commit_disk;  // 锁外sync用的磁盘，第一次提交时打开
+    mutable std::mutex commit_mutex;           // 保护下面几项
+    std::condition_variable commit_finished;   // 一次sync结束
+    std::condition_variable commit_wakeup;     // 唤醒定时提交线程
+    uint64_t commit_written = 0;               // 已写入操作系统的最后一个提交序号
+    uint64_t commit_synced = 0;                // 已持久化的最后一个提交序号
+    bool commit_syncing = false;
+    uint64_t commit_syncs = 0;                 // commit_disk上的sync次数，计入disk_stats()
+    std::thread commit_thread;                 // PERIODIC策略的定时提交线程
+    bool commit_stop = false;
+
+    // 保护文件系统的全部状态：public方法先加锁，后台写回线程只在挑选、复制脏块时加锁
+    std::recursive_mutex mutex;
+    uint32_t lock_depth = 0; // 当前持有锁的线程嵌套加锁的层数
+
+    // 加锁并记录嵌套层数，修改操作据此只在最外层调用结束时等待提交持久化
+    class Guard {
+        BasicFileSystem &fs;
+    public:
+        explicit Guard(BasicFileSystem &fs) : fs(fs) {
+            fs.mutex.lock();
+            fs.lock_depth++;
+        }
+
+        ~Guard() {
+            fs.lock_depth--;
+            fs.mutex.unlock();
+        }
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+        // 不是在另一个public方法内部调用的
+        [[nodiscard]] bool outermost() const {
+            return fs.lock_depth == 1;
+        }
+    };
+
+    // 磁盘文件，后台写回线程用它们再打开一份磁盘，读写互不干扰
+    std::vector<std::string> disk_paths;
+    uint32_t stripe_blocks;
+
+    // 脏缓存块数量
+    uint32_t dirty_blocks = 0;
+
+    // 后台写回
+    std::thread writeback_thread;
+    std::mutex writeback_mutex;                 // 保护下面几项
+    std::condition_variable writeback_wakeup;   // 唤醒后台线程
+    std::condition_variable writeback_finished; // 一批写回完成
+    bool writeback_stop = false;
+    std::vector<uint32_t> writeback_in_flight;  // 已复制出缓存、尚未写入磁盘的盘块号，有序
+    std::atomic<bool> writeback_busy{false};    // writeback_in_flight非空，前台不加锁即可判断
+    std::unique_ptr<DiskManager> writeback_disk; // 后台线程自己的磁盘
+    std::exception_ptr writeback_error;          // 后台写回失败的原因，下次save()时抛出
+    uint32_t dirty_background_percent = DIRTY_BACKGROUND_PERCENT;
+    uint32_t dirty_hard_percent = DIRTY_HARD_PERCENT;
+    std::chrono::milliseconds dirty_expire{DIRTY_EXPIRE_MS};
+
+    // 块对齐的fread/fwrite至少这么多块时绕过高速缓存，0表示关闭
+    uint32_t direct_io_min_blocks = G::DIRECT_IO_MIN_BLOCKS;
+
+    // 延迟分配：fwrite只预留空间，数据写回前才分配盘块
+    bool delay_allocation = false;
 
 private:
     // 当前文件InodeId
     uint32_t current_inode_id;
 
 public:
-    FileSystem();
+    /**
+     * @param disk_mode 磁盘读写后端
+     * @param disk_path 磁盘文件路径，不同几何参数的文件系统应使用不同的磁盘文件
+     */
+    explicit BasicFileSystem(DiskMode disk_mode = DiskMode::POSIX, const std::string &disk_path = DISK_PATH);
 
-    ~FileSystem();
+    /**
+     * 条带化的文件系统：逻辑磁盘以条带单元为单位轮流分布在多个磁盘文件上
+     * @param disk_mode 磁盘读写后端
+     * @param disk_paths 磁盘文件路径，顺序决定条带的分布，挂载时必须与格式化时相同
+     * @param stripe_blocks 条带单元（盘块数）
+     */
+    BasicFileSystem(DiskMode disk_mode, const std::vector<std::string> &disk_paths,
+                    const uint32_t &stripe_blocks = DEFAULT_STRIPE_BLOCKS);
 
-    void format();
+    ~BasicFileSystem();
+
+    /**
+     * 格式化文件系统
+     * @param allocation 磁盘文件的空间分配方式，默认保持稀疏
+     */
+    void format(ImageAllocation allocation = ImageAllocation::SPARSE);
 
     void init();
 
+    // 写回所有修改并fdatasync
     void save();
 
+    /**
+     * 设置持久化策略。STREAM模式的sync只刷新用户态缓冲区，不支持NONE以外的策略
+     * @param policy 策略
+     * @param interval PERIODIC策略下定时提交的间隔
+     */
+    void set_durability(Durability policy,
+                        std::chrono::milliseconds interval = std::chrono::milliseconds(DEFAULT_COMMIT_INTERVAL_MS));
+
+    [[nodiscard]] Durability get_durability() const {
+        return durability;
+    }
+
+    // 如果上次持久化之后有修改，则持久化（组提交）
+    void commit();
+
+    /**
+     * 启动后台写回线程：脏块超过背景阈值或停留超过expire时异步写回，
+     * 超过硬阈值时前台写入先同步写回一批（限流）。STREAM模式不支持
+     * @param background_percent 背景阈值，占缓存块数量的百分比
+     * @param hard_percent 硬阈值，占缓存块数量的百分比
+     * @param expire 脏块最长停留时间
+     */
+    void start_writeback(uint32_t background_percent = DIRTY_BACKGROUND_PERCENT,
+                         uint32_t hard_percent = DIRTY_HARD_PERCENT,
+                         std::chrono::milliseconds expire = std::chrono::milliseconds(DIRTY_EXPIRE_MS));
+
+    // 停止后台写回线程，已经复制出去的一批写完后才返回
+    void stop_writeback();
+
+    [[nodiscard]] bool writeback_running() const {
+        return writeback_thread.joinable();
+    }
+
+    // 当前脏缓存块数量
+    uint32_t dirty_block_count();
+
+    /**
+     * 设置绕过高速缓存的阈值：fread/fwrite中从块边界开始、至少min_blocks块的部分，
+     * 直接在用户缓冲区和磁盘之间传输（O_DIRECT），缓存中重叠的块被作废，不会冲掉元数据块
+     * @param min_blocks 最少块数，0表示总是经过缓存
+     */
+    void set_direct_io_threshold(const uint32_t &min_blocks);
+
+    [[nodiscard]] uint32_t direct_io_threshold() const {
+        return direct_io_min_blocks;
+    }
+
+    /**
+     * 设置延迟分配：fwrite追加的数据块只预留空间，数据留在按（Inode编号，文件块号）登记的缓存页中，
+     * 在save()、后台写回、内存Inode被换出或这样的页超过硬阈值时才一次分配盘块，
+     * 多次小的追加也能得到连续的盘块，写回前被删除的数据不占用盘块。关闭时立即分配所有延迟的块
+     * 可能绕过缓存的大段写入（见set_direct_io_threshold）仍然立即分配
+     * @param enabled 是否启用
+     */
+    void set_delayed_allocation(const bool &enabled);
+
+    [[nodiscard]] bool delayed_allocation() const {
+        return delay_allocation;
+    }
+
 
     bool exist(const std::string &path);
 
     uint32_t get_file_size(uint32_t i);
 
+    /**
+     * 文件数据块在磁盘上的分布，按文件块顺序，盘块号连续的块合并为一段
+     * 包括fallocate在文件末尾之后预先分配的块，不包括还没有分配盘块的延迟写入
+     * @param i 文件id
+     * @return 每段的 {第一个盘块号, 块数}
+     */
+    std::vector<std::pair<uint32_t, uint32_t>> file_extents(uint32_t i);
+
+    // 当前文件系统的磁盘块大小
+    [[nodiscard]] static constexpr uint32_t block_size() {
+        return G::BLOCK_SIZE;
+    }
+
+    /**
+     * 调整高速缓存块数量，脏块先写回，缓存随后被清空
+     * @param capacity 缓存块数量，不少于 G::MIN_CACHE_BLOCK_NUM
+     */
+    void set_cache_capacity(const uint32_t &capacity);
+
+    [[nodiscard]] uint32_t cache_capacity() const {
+        return buffer_pool.capacity();
+    }
+
+    /**
+     * 更换高速缓存的替换策略，脏块先写回，缓存随后被清空
+     * @param policy 替换策略
+     */
+    void set_cache_policy(CachePolicy policy);
+
+    [[nodiscard]] CachePolicy cache_policy() const {
+        return buffer_pool.policy();
+    }
+
+    // 磁盘文件数量
+    [[nodiscard]] uint32_t stripe_count() const {
+        return disk_manager.stripe_count();
+    }
+
+    // 磁盘读写次数统计，sync次数包括锁外的组提交
+    [[nodiscard]] DiskStats disk_stats() const {
+        DiskStats stats = disk_manager.stats();
+        std::lock_guard<std::mutex> lock(commit_mutex);
+        stats.sync_calls += commit_syncs;
+        return stats;
+    }
+
     using ProgressCallback = std::function<void(uint32_t current, uint32_t size)>;
     void fwrite(const uint32_t &file_id, const char *data, const uint32_t &size, const ProgressCallback& callback);
 
@@ -83,6 +324,120 @@ private:
      */
     BufferCache *allocate_buffer_cache(const uint32_t &block_no);
 
+    /**
+     * 给一个盘块分配高速缓存并钉住，句柄析构前缓存块不会被换出
+     * 需要在读写其他盘块期间继续使用这个缓存块时使用
+     * @param block_no 盘块号
+     */
+    BufferHandle pin_buffer_cache(const uint32_t &block_no);
+
+    /**
+     * 为刚分配的盘块取得缓存块，不从磁盘读取，内容清零
+     * @param block_no 盘块号
+     */
+    BufferCache *new_buffer_cache(const uint32_t &block_no);
+
+    /**
+     * 取得文件第block_index块数据的高速缓存：先按（Inode编号，文件块号）查找逻辑页，
+     * 命中时不经过索引块；未命中时通过get_block_pointer找到盘块，装入后登记为逻辑页
+     * @param inode 文件的Inode
+     * @param block_index 文件块号，必须已经分配
+     * @param fresh 数据块是这次写入新分配的，不从磁盘读取，内容为0
+     */
+    BufferCache *allocate_file_block(Inode *inode, const uint32_t &block_index, const bool &fresh = false);
+
+    /**
+     * 为盘块取得一个可用的缓存块：优先使用空闲块，否则由替换策略换出一个块，换出的脏块先写回
+     * @param block_no 即将装入的盘块号
+     * @return BufferCache* 高速缓存块指针，尚未登记到缓存池中
+     */
+    BufferCache *take_buffer_cache(const uint32_t &block_no);
+
+    // 把所有脏缓存块作为一批写回（连同之前排队的写入一起提交）
+    void flush_buffer_cache();
+
+    // 脏块变为干净（写回或丢弃后），维护脏块计数
+    void mark_clean(BufferCache *cache_block);
+
+    /**
+     * 挑选最久的脏块，按盘块号排序，最多 WRITEBACK_BATCH_BLOCKS 块
+     * @param only_expired 只挑选超过停留时间的脏块
+     */
+    std::vector<BufferCache *> pick_dirty_blocks(bool only_expired);
+
+    // 后台写回线程的主循环
+    void writeback_loop();
+
+    // 等待后台线程正在写的一批完成，前台向磁盘写缓存块之前调用
+    void wait_for_writeback();
+
+    // 如果block_no正在被后台线程写回，等待它完成，前台从磁盘读盘块之前调用
+    void wait_for_writeback(const uint32_t &block_no);
+
+    // 脏块超过硬阈值时由前台同步写回一批
+    void throttle_dirty_blocks();
+
+    /**
+     * 把若干盘块批量读入高速缓存，缺失的盘块一次提交给磁盘，最多装入缓存容量的一半
+     * @param block_nos 盘块号数组，0表示未分配，会被跳过
+     * @param count 数组长度
+     * @param async 提交后立即返回，缓存块在读完之前被钉住，使用前由wait_for_read()等待
+     */
+    void prefetch_buffer_cache(const uint32_t *block_nos, const uint32_t &count, const bool &async = false);
+
+    /**
+     * 完成一个异步读取的批次：等待它读完，放开其中的缓存块
+     * 读取失败时丢弃这些缓存块，之后访问时重新同步读取，错误在那时抛出
+     */
+    void finish_read_batch(const uint64_t &batch);
+
+    // 完成已经读完的异步读取批次，不阻塞
+    void reap_reads();
+
+    // 如果盘块正在异步读入缓存，等待它读完，使用缓存中的盘块之前调用
+    void wait_for_read(const uint32_t &block_no);
+
+    // 等待所有异步读取完成，清空或重建缓存之前调用
+    void wait_for_reads();
+
+    /**
+     * 顺序预读：fread读取每个文件块之前调用
+     * 连续读取相邻的文件块时，提前把之后一个窗口的数据块批量读入缓存，窗口从 G::PREFETCH_BLOCK_NUM 块
+     * 开始每次翻倍，最大 G::READAHEAD_MAX_BLOCKS 块；读到窗口中点时发起下一个窗口；跳读时关闭预读
+     * 预读异步提交（URING模式），fread读到还在途的块时才等待
+     * @param file 打开文件
+     * @param inode 文件的Inode
+     * @param block_index 即将读取的文件块号
+     */
+    void readahead(File &file, Inode *inode, const uint32_t &block_index);
+
+    /**
+     * fread/fwrite在文件位置ptr处可以绕过缓存的块数
+     * @param remaining 剩余的字节数
+     * @return 块数，不满足条件时为0
+     */
+    [[nodiscard]] uint32_t direct_io_blocks(const uint32_t &ptr, const uint32_t &remaining) const;
+
+    /**
+     * 绕过高速缓存读取文件从ptr（块对齐）开始的block_num块，缓存中的块比磁盘新，覆盖读出的数据
+     */
+    void direct_read(Inode *inode, const uint32_t &ptr, char *data, const uint32_t &block_num);
+
+    /**
+     * 绕过高速缓存写入文件从ptr（块对齐）开始的block_num块，数据块已由allocate_for_write分配，缓存中重叠的块被作废
+     */
+    void direct_write(Inode *inode, const uint32_t &ptr, const char *data, const uint32_t &block_num);
+
+    /**
+     * 在盘块和用户缓冲区之间直接传输，物理相邻的盘块合并为一次读写
+     * 用户缓冲区未按 DIRECT_IO_ALIGNMENT 对齐时经过一个对齐的中转缓冲区
+     * @param block_nos 依次对应用户缓冲区中每一块的盘块号
+     */
+    void transfer_direct(bool write, const std::vector<uint32_t> &block_nos, char *data);
+
+    // 作废盘块的缓存（包括脏块），之后磁盘上的数据以直接写入的为准
+    void invalidate_buffer_cache(const uint32_t &block_no);
+
     Inode *allocate_memory_inode(const uint32_t &inode_id);
 
     /**
@@ -93,7 +448,7 @@ private:
     void read_from_disk_to_cache(const uint32_t &block_no, BufferCache *cache_block);
 
     /**
-     * 将高速缓存块的数据写入磁盘
+     * 将高速缓存块的数据写入磁盘，缓存中与它物理相邻的脏块合并在同一次写入中
      * @param cache_block 高速缓存块
      */
     void write_cache_to_disk(BufferCache *cache_block);
@@ -101,9 +456,11 @@ private:
     /**
      * 转换Inode编号到实际盘块号、第几个
      * @param inode_id Inode 编号
-     * @return std::pair<uint32_t, uint32_t> [第几个盘块(2~59)，第几个(0~7)]
+     * @return std::pair<uint32_t, uint32_t> [第几个盘块，盘块中的第几个]
      */
-    static std::pair<uint32_t, uint32_t> inode_id_to_block_no(const uint32_t &inode_id);
+    static constexpr std::pair<uint32_t, uint32_t> inode_id_to_block_no(const uint32_t &inode_id) {
+        return {inode_id / G::INODES_PER_BLOCK + G::INODE_START_INDEX, inode_id % G::INODES_PER_BLOCK};
+    }
 
 
     /**
@@ -112,7 +469,7 @@ private:
      * @param i     第i个数据块
      * @return    第i个数据块指针
      */
-    const uint32_t &get_block_pointer(Inode *pInode, uint32_t i);
+    uint32_t get_block_pointer(Inode *pInode, uint32_t i);
 
     /**
      * 通过路径获取Inode指针
@@ -127,9 +484,64 @@ private:
      */
     void alloc_new_block(Inode *inode);
 
-    void write_back_inode(Inode *pInode);
+    /**
+     * 给Inode分配文件块号 [first, first + count) 的数据块，之前的块必须都已分配
+     * 数据块和途中需要的索引块一次向分配器预留，按文件顺序依次使用，尽量物理连续；
+     * 指针按索引块成批写入，每个索引块只查找一次
+     * @param inode 文件的Inode，file_size不变
+     * @param first 第一个文件块号
+     * @param count 块数
+     * @param block_nos 不为空时依次存入分配的数据块号
+     */
+    void alloc_new_blocks(Inode *inode, const uint32_t &first, const uint32_t &count,
+                          std::vector<uint32_t> *block_nos = nullptr);
+
+    /**
+     * 依次分配文件块号 [first, first + count) 时，途中要新建的索引块数
+     */
+    static uint32_t new_index_blocks(const uint32_t &first, const uint32_t &count);
+
+    // 已经分配盘块的文件块数，包括fallocate在文件末尾之后预先分配的块，延迟分配的块都在它们之后
+    static uint32_t allocated_blocks(const Inode *inode) {
+        if (inode->delayed_blocks != 0) {
+            return inode->delayed_first;
+        }
+        return std::max((inode->file_size + G::BLOCK_SIZE - 1) / G::BLOCK_SIZE, inode->preallocated_blocks);
+    }
+
+    /**
+     * 追加延迟分配的文件块 [first, first + count)：预留盘块（包括途中的索引块），数据为0的缓存页登记为逻辑页
+     * @param inode 文件的Inode，file_size不变
+     * @param first 第一个文件块号，紧接在已分配或已延迟的块之后
+     */
+    void delay_new_blocks(Inode *inode, const uint32_t &first, const uint32_t &count);
+
+    // 为文件所有延迟分配的块一次分配盘块，缓存页变为普通的脏块
+    void allocate_delayed_blocks(Inode *inode);
 
-    void write_back_cache_block(BufferCache *pCache);
+    /**
+     * 为所有内存Inode中延迟分配的块分配盘块
+     * @param only_expired 只处理最早的页已经超过脏块停留时间的文件
+     */
+    void allocate_delayed_blocks(bool only_expired = false);
+
+    // 丢弃文件所有延迟分配的块，归还预留的空间
+    void discard_delayed_blocks(Inode *inode);
+
+    /**
+     * 把文件 [from, to) 在磁盘上清零，数据块必须都已分配
+     * from所在的不完整的块读出后清零其中的一段，与之后的整块一起直接写入磁盘，缓存中的旧内容被作废
+     */
+    void zero_file_range(Inode *inode, const uint32_t &from, const uint32_t &to);
+
+    /**
+     * fwrite写入 [offset, offset + size) 之前一次分配所有新的数据块，写入位置在文件末尾之后时中间补0
+     * 延迟分配时只追加延迟分配的块
+     * @return 原来已分配的块数，文件块号不小于它的数据块是新分配的
+     */
+    uint32_t allocate_for_write(Inode *inode, const uint32_t &offset, const uint32_t &size);
+
+    void write_back_inode(Inode *pInode);
 
 
 public:
@@ -154,11 +566,13 @@ public:
 
     /**
      * 获取这个Inode节点的第i个目录项
+     * 扫描目录时在循环外定义一个句柄，同一盘块中的目录项只钉住一次
      * @param pInode  Inode指针
      * @param i     第i个目录项
+     * @param block 钉住目录项所在盘块的句柄，目录项指针在句柄换到其他盘块或析构之前有效
      * @return 目录项指针
      */
-    const DirectoryEntry *get_directory_entry(Inode *pInode, uint32_t i);
+    const DirectoryEntry *get_directory_entry(Inode *pInode, uint32_t i, BufferHandle &block);
 
     /**
      * 列出当前目录下所有文件 ls
@@ -212,6 +626,17 @@ public:
      */
     void fread(const uint32_t &file_id, char *data, const uint32_t &size);
 
+    /**
+     * 为文件预先分配 [offset, offset + len) 的数据块（fallocate），一次申请，尽量物理连续，不经过高速缓存
+     * 之后写入这个范围不需要再分配盘块；已分配的部分不变
+     * @param file_id 文件id
+     * @param offset 起始偏移
+     * @param len 长度，不能为0
+     * @param zero 为假时文件大小不变，预先分配的块在文件末尾之后；
+     *             为真时文件大小扩展到 offset + len，新扩展的部分在磁盘上清零
+     */
+    void fallocate(const uint32_t &file_id, const uint32_t &offset, const uint32_t &len, const bool &zero = false);
+
     /**
      * 移动读写指针 fseek
      * @param file_id 文件id
@@ -229,11 +654,57 @@ private:
                       bool index_by_char = false);
 
 
-    const uint32_t &get_parent_inode_id(Inode *pInode);
+    uint32_t get_parent_inode_id(Inode *pInode);
 
     void free_memory_inode(Inode *pInode);
 
     std::string get_pwd_by_inode(const uint32_t &inode_id);
 
     void free_all_data_block(Inode *inode);
-};
\ No newline at end of file
+
+    // 一个修改操作完成，按持久化策略决定是否提交
+    void operation_done();
+
+    // 延迟分配的块分配盘块，把有修改的Inode、有修改的SuperBlock和所有脏缓存块写入操作系统，不sync
+    void flush_metadata();
+
+    // 上次提交之后有修改时写入操作系统，取得新的提交序号，持久化由sync_commits()完成
+    void flush_commit();
+
+    /*
+     * 在锁外等待此刻之前写入的提交全部持久化，sync进行中时等它结束，多个等待者共享下一次sync
+     * 修改操作在释放锁之后显式调用，嵌套在其他public方法中时由最外层的方法调用
+     */
+    void sync_commits();
+
+    // 定时提交线程的主循环
+    void commit_loop();
+
+    // 停止定时提交线程，不能在持有锁时调用
+    void stop_periodic_commit();
+
+    // 释放一个数据块，并记录下来等待打洞
+    void free_block(const uint32_t &block_no);
+
+    /**
+     * 把已释放的盘块合并为连续区间，在磁盘文件上打洞，归还宿主空间
+     * 释放后又被重新分配的盘块会被跳过
+     */
+    void discard_freed_blocks();
+};
+
+extern template class BasicFileSystem<Geometry512>;
+extern template class BasicFileSystem<Geometry4K>;
+
+using FileSystem = BasicFileSystem<Geometry512>;
+
+/**
+ * 读取磁盘文件SuperBlock中记录的块大小，用于挂载前选择几何参数
+ * @param disk_path 磁盘文件路径
+ * @return 块大小，磁盘文件不存在或尚未格式化（头部全为0）时为0；
+ *         旧版本格式化的磁盘返回无意义的值，用 is_known_block_size() 判断
+ */
+uint32_t probe_block_size(const std::string &disk_path);
+
+// 是否是某个几何参数的块大小，不是时磁盘需要重新格式化
+bool is_known_block_size(const uint32_t &block_size);
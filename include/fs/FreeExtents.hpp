@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+/**
+ * 空闲区间集合：每个空闲区间 [start, start + length) 同时按起始位置和按（长度，起始位置）索引，
+ * 两个索引都是平衡树，插入、删除、最佳适配都是O(log n)
+ * 插入时与相邻的区间合并，所以任意两个区间都不相邻，区间数量就是空闲空间的碎片数
+ */
+class FreeExtents {
+public:
+    static constexpr uint32_t NPOS = UINT32_MAX; // 查找失败
+
+    void clear() {
+        _by_start.clear();
+        _by_length.clear();
+    }
+
+    // 区间数量
+    [[nodiscard]] size_t size() const {
+        return _by_start.size();
+    }
+
+    // 最长的区间长度，没有空闲区间时返回0
+    [[nodiscard]] uint32_t largest() const {
+        return _by_length.empty() ? 0 : _by_length.rbegin()->first;
+    }
+
+    /**
+     * 加入空闲区间，与前后相邻的区间合并
+     * 区间不能与已有的空闲区间重叠
+     */
+    void insert(uint32_t start, uint32_t length) {
+        if (length == 0) {
+            return;
+        }
+        auto next = _by_start.lower_bound(start);
+        auto prev = next == _by_start.begin() ? _by_start.end() : std::prev(next);
+        bool merge_prev = prev != _by_start.end() && prev->first + prev->second == start;
+        bool merge_next = next != _by_start.end() && next->first == start + length;
+        if (merge_prev && merge_next) {
+            uint32_t total = prev->second + length + next->second;
+            _erase(next);
+            _update(prev, prev->first, total);
+        } else if (merge_prev) {
+            _update(prev, prev->first, prev->second + length);
+        } else if (merge_next) {
+            _update(next, start, length + next->second);
+        } else {
+            _insert(start, length);
+        }
+    }
+
+    /**
+     * 从空闲区间中取出 [start, start + length)，剩下的前后两部分仍是空闲区间
+     * 取出的部分必须完全位于一个空闲区间中
+     */
+    void remove(const uint32_t &start, const uint32_t &length) {
+        auto it = _by_start.upper_bound(start);
+        if (it == _by_start.begin()) {
+            throw std::logic_error("Range is not free");
+        }
+        --it;
+        auto [extent_start, extent_length] = *it;
+        const uint32_t extent_end = extent_start + extent_length, end = start + length;
+        if (end > extent_end) {
+            throw std::logic_error("Range is not free");
+        }
+        // 原来的区间改为前一部分（没有前一部分时改为后一部分），常见的从区间头部分配不需要重新分配树节点
+        if (start > extent_start) {
+            _update(it, extent_start, start - extent_start);
+            if (extent_end > end) {
+                _insert(end, extent_end - end);
+            }
+        } else if (extent_end > end) {
+            _update(it, end, extent_end - end);
+        } else {
+            _erase(it);
+        }
+    }
+
+    /**
+     * 最佳适配：长度不小于length的区间中最短的，一样短时取起始位置最小的
+     * @return 区间的起始位置，没有时返回NPOS
+     */
+    [[nodiscard]] uint32_t best_fit(const uint32_t &length) const {
+        auto it = _by_length.lower_bound({length, 0});
+        return it == _by_length.end() ? NPOS : it->second;
+    }
+
+    /**
+     * 下次适配：从hint开始向后第一个能放下length的位置，到末尾后回绕
+     * hint落在一个空闲区间中间时，从hint开始的部分也可以使用
+     * @return 起始位置，没有时返回NPOS
+     */
+    [[nodiscard]] uint32_t next_fit(const uint32_t &length, const uint32_t &hint) const {
+        if (largest() < length) {
+            return NPOS;
+        }
+        auto it = _by_start.upper_bound(hint);
+        if (it != _by_start.begin()) {
+            auto prev = std::prev(it);
+            if (prev->first + prev->second >= hint + length) {
+                return hint;
+            }
+        }
+        for (; it != _by_start.end(); ++it) {
+            if (it->second >= length) {
+                return it->first;
+            }
+        }
+        // 回绕：最长的区间足够长，一定能找到
+        for (it = _by_start.begin(); ; ++it) {
+            if (it->second >= length) {
+                return it->first;
+            }
+        }
+    }
+
+    // 按起始位置遍历 (start, length)
+    [[nodiscard]] std::map<uint32_t, uint32_t>::const_iterator begin() const {
+        return _by_start.begin();
+    }
+
+    [[nodiscard]] std::map<uint32_t, uint32_t>::const_iterator end() const {
+        return _by_start.end();
+    }
+
+private:
+    void _insert(const uint32_t &start, const uint32_t &length) {
+        _by_start.emplace(start, length);
+        _by_length.emplace(length, start);
+    }
+
+    // 修改区间的起始位置和长度，新的起始位置不能越过相邻的区间，复用两个索引中原来的节点
+    void _update(std::map<uint32_t, uint32_t>::iterator it, const uint32_t &start, const uint32_t &length) {
+        auto length_node = _by_length.extract({it->second, it->first});
+        length_node.value() = {length, start};
+        _by_length.insert(std::move(length_node));
+        if (it->first == start) {
+            it->second = length;
+            return;
+        }
+        auto hint = std::next(it);
+        auto start_node = _by_start.extract(it);
+        start_node.key() = start;
+        start_node.mapped() = length;
+        _by_start.insert(hint, std::move(start_node));
+    }
+
+    std::map<uint32_t, uint32_t>::iterator _erase(std::map<uint32_t, uint32_t>::iterator it) {
+        _by_length.erase({it->second, it->first});
+        return _by_start.erase(it);
+    }
+
+private:
+    std::map<uint32_t, uint32_t> _by_start;             // 起始位置 -> 长度
+    std::set<std::pair<uint32_t, uint32_t>> _by_length; // （长度，起始位置）
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include "Bitmap.hpp"
+#include "DiskInode.hpp"
+#include "DirectoryEntry.hpp"
+
+/**
+ * 文件系统的几何参数，在编译期确定
+ * FileSystem、SuperBlock、BufferCache以它为模板参数，所有索引计算都是常量表达式，
+ * 块大小是2的幂，除以每块指针数、取模都会被编译为移位和掩码
+ * @tparam BlockSize 磁盘块大小
+ * @tparam BlockCount 数据块数量
+ * @tparam InodeCount DiskInode数量
+ * @tparam MemoryInodeNum 内存Inode数量
+ * @tparam CacheBlockNum 默认的高速缓存块数量，运行时可以调整
+ */
+template<uint32_t BlockSize, uint32_t BlockCount, uint32_t InodeCount = 3968,
+        uint32_t MemoryInodeNum = 100, uint32_t CacheBlockNum = 1024>
+struct Geometry {
+    static_assert(BlockSize >= 512 && (BlockSize & (BlockSize - 1)) == 0, "Block size must be a power of two >= 512");
+    static_assert(InodeCount * sizeof(DiskInode) % BlockSize == 0, "Inode area must fill whole blocks");
+
+    static constexpr uint32_t BLOCK_SIZE = BlockSize;          // 磁盘块大小
+    static constexpr uint32_t BLOCK_COUNT = BlockCount;        // 数据块数量，用于位图
+    static constexpr uint32_t INODE_COUNT = InodeCount;        // DiskInode数量，用于位图
+    static constexpr uint32_t MEMORY_INODE_NUM = MemoryInodeNum; // 内存Inode数量
+    static constexpr uint32_t CACHE_BLOCK_NUM = CacheBlockNum;   // 默认高速缓存块数量
+    static constexpr uint32_t PREFETCH_BLOCK_NUM = 8; // 一次批量预读的最大块数
+    static constexpr uint32_t MIN_CACHE_BLOCK_NUM = 2 * PREFETCH_BLOCK_NUM; // 高速缓存块数量下限，预读不超过缓存的一半
+    static constexpr uint32_t READAHEAD_MAX_BLOCKS = 256 * 1024 / BlockSize; // 顺序读的最大预读窗口，256KiB
+    static constexpr uint32_t DIRECT_IO_MIN_BLOCKS = 256 * 1024 / BlockSize; // 默认至少这么多块的对齐读写绕过缓存，256KiB
+    static_assert(CacheBlockNum >= MIN_CACHE_BLOCK_NUM, "Buffer cache is too small");
+
+    static constexpr uint32_t PTRS_PER_BLOCK = BlockSize / sizeof(uint32_t);          // 每个块可以包含的指针数量
+    static constexpr uint32_t INODES_PER_BLOCK = BlockSize / sizeof(DiskInode);       // 每个块可以包含的DiskInode数量
+    static constexpr uint32_t ENTRIES_PER_BLOCK = BlockSize / sizeof(DirectoryEntry); // 每个块可以包含的目录项数量
+
+    // SuperBlock中位图之前的字段大小
+    static constexpr uint32_t SUPER_BLOCK_HEADER_SIZE = 32;
+    // SuperBlock占用的块数
+    static constexpr uint32_t SUPER_BLOCK_BLOCKS =
+            (SUPER_BLOCK_HEADER_SIZE + sizeof(Bitmap<InodeCount>) + sizeof(Bitmap<BlockCount>) +
+             BlockSize - 1) / BlockSize;
+    // Inode区占用的块数
+    static constexpr uint32_t INODE_BLOCKS = InodeCount * sizeof(DiskInode) / BlockSize;
+
+    static constexpr uint32_t INODE_START_INDEX = SUPER_BLOCK_BLOCKS;               // Inode区起始块号
+    static constexpr uint32_t BLOCK_START_INDEX = SUPER_BLOCK_BLOCKS + INODE_BLOCKS; // 数据区起始块号
+
+    // 磁盘文件大小：SuperBlock | Inode区 | 数据区
+    static constexpr uint64_t DISK_SIZE = (uint64_t) (BLOCK_START_INDEX + BlockCount) * BlockSize;
+    static_assert(DISK_SIZE <= UINT32_MAX, "Disk image must fit in 4 GiB");
+
+    /*
+     * 索引表：block_pointers中5个直接索引，2个一次间接索引，2个二次间接索引和1个三次间接索引
+     * INDEX_POINTER_BEGIN[k] 是第k级索引在block_pointers中的起始下标，
+     * INDEX_LEVEL_END[k] 是第k级索引能覆盖的文件块号的上界（不含），即get_block_pointer的分界点
+     */
+    static constexpr uint32_t INDEX_POINTER_BEGIN[4] = {0, 5, 7, 9};
+    static constexpr uint64_t INDEX_LEVEL_END[4] = {
+            5,
+            5 + 2ull * PTRS_PER_BLOCK,
+            5 + 2ull * PTRS_PER_BLOCK + 2ull * PTRS_PER_BLOCK * PTRS_PER_BLOCK,
+            5 + 2ull * PTRS_PER_BLOCK + 2ull * PTRS_PER_BLOCK * PTRS_PER_BLOCK +
+            1ull * PTRS_PER_BLOCK * PTRS_PER_BLOCK * PTRS_PER_BLOCK,
+    };
+};
+
+// 512字节块，1GiB数据区
+// SuperBlock头部从16字节增加到32字节，512字节块时SuperBlock多占一块，Inode区和数据区的起始块号随之后移，
+// 这是新的磁盘格式，之前格式化的磁盘需要重新格式化
+using Geometry512 = Geometry<512, 2097152>;
+
+// 4KiB块，与宿主页大小一致，数据区同样为1GiB
+using Geometry4K = Geometry<4096, 262144>;
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <sys/mman.h>
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024) // 透明大页大小
+
+/**
+ * 一整块匿名映射的内存，起始地址按大页对齐并建议内核使用透明大页（MADV_HUGEPAGE）
+ * 大容量的高速缓存放在一个arena中，TLB项少，也不经过通用的内存分配器；
+ * 内核不支持透明大页时仍然可用，只是退化为普通页。内存初始为0
+ * 用allocate()按顺序切出对齐的几段，整块在析构时一起释放
+ */
+class HugePageArena {
+public:
+    HugePageArena() = default;
+
+    /**
+     * @param size 字节数，向上取整到大页大小
+     */
+    explicit HugePageArena(size_t size) {
+        _size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        if (_size == 0) {
+            return;
+        }
+        // 多映射一个大页，把起始地址调整到大页边界，再把前后多余的部分归还
+        size_t mapped = _size + HUGE_PAGE_SIZE;
+        void *mapping = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        auto begin = reinterpret_cast<uintptr_t>(mapping);
+        auto aligned = (begin + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        if (aligned > begin) {
+            ::munmap(mapping, aligned - begin);
+        }
+        if (begin + mapped > aligned + _size) {
+            ::munmap(reinterpret_cast<void *>(aligned + _size), begin + mapped - aligned - _size);
+        }
+        _data = reinterpret_cast<char *>(aligned);
+#ifdef MADV_HUGEPAGE
+        // 只是建议，内核关闭了透明大页时忽略
+        ::madvise(_data, _size, MADV_HUGEPAGE);
+#endif
+    }
+
+    HugePageArena(const HugePageArena &) = delete;
+
+    HugePageArena &operator=(const HugePageArena &) = delete;
+
+    HugePageArena(HugePageArena &&other) noexcept
+            : _data(std::exchange(other._data, nullptr)), _size(std::exchange(other._size, 0)),
+              _used(std::exchange(other._used, 0)) {}
+
+    HugePageArena &operator=(HugePageArena &&other) noexcept {
+        if (this != &other) {
+            _release();
+            _data = std::exchange(other._data, nullptr);
+            _size = std::exchange(other._size, 0);
+            _used = std::exchange(other._used, 0);
+        }
+        return *this;
+    }
+
+    ~HugePageArena() {
+        _release();
+    }
+
+    /**
+     * 从arena中切出一段内存
+     * @param size 字节数
+     * @param alignment 对齐，2的幂，不超过大页大小
+     */
+    char *allocate(size_t size, size_t alignment) {
+        size_t offset = (_used + alignment - 1) & ~(alignment - 1);
+        if (offset + size > _size) {
+            throw std::bad_alloc();
+        }
+        _used = offset + size;
+        return _data + offset;
+    }
+
+    [[nodiscard]] char *data() const {
+        return _data;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return _size;
+    }
+
+private:
+    void _release() {
+        if (_data != nullptr) {
+            ::munmap(_data, _size);
+            _data = nullptr;
+        }
+        _size = 0;
+        _used = 0;
+    }
+
+private:
+    char *_data = nullptr;
+    size_t _size = 0; // 映射的字节数，大页大小的整数倍
+    size_t _used = 0; // 已经切出的字节数
+};
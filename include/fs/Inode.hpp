@@ -19,7 +19,11 @@ public:
     uint32_t block_pointers[10] {};
     uint32_t reference_count = 0; // 引用计数，为0时可以写回内存
     uint32_t inode_id = 0; // Inode编号
-    uint32_t padding[2] {};
+    uint32_t preallocated_blocks = 0; // fallocate预先分配到的文件块数，之后的写入不需要再分配
+    // 延迟分配：文件块号 [delayed_first, delayed_first + delayed_blocks) 还没有分配盘块，只在内存中
+    uint32_t delayed_first = 0;
+    uint32_t delayed_blocks = 0;
+    bool dirty = false; // 有修改尚未写回缓存块，提交时只写回这些Inode
 
     // 判断Inode是否还未被分配
     [[nodiscard]] bool is_available() const {
@@ -43,6 +47,10 @@ public:
         file_size = 0;
         reference_count = 0;
         inode_id = 0;
+        preallocated_blocks = 0;
+        delayed_first = 0;
+        delayed_blocks = 0;
+        dirty = false;
         for (auto &block_pointer : block_pointers) {
             block_pointer = 0;
         }
@@ -54,6 +62,7 @@ public:
         m_inode.inode_id = inode_id;
         m_inode.reference_count = 0;
         m_inode.file_size = inode.file_size;
+        m_inode.preallocated_blocks = inode.preallocated_blocks;
         memcpy(m_inode.block_pointers, inode.block_pointers, sizeof inode.block_pointers);
         return m_inode;
     }
@@ -62,6 +71,7 @@ public:
         DiskInode disk_inode;
         disk_inode.file_type = inode.file_type;
         disk_inode.file_size = inode.file_size;
+        disk_inode.preallocated_blocks = inode.preallocated_blocks;
         memcpy(disk_inode.block_pointers, inode.block_pointers, sizeof inode.block_pointers);
         return disk_inode;
     }
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include "BufferCache.hpp"
+
+// 高速缓存的替换策略
+enum class CachePolicy {
+    LRU,   // 换出最久未使用的块，一次大文件的顺序读写会冲掉所有元数据块
+    CLOCK, // 时钟（二次机会）：命中只设置访问位，换出时跳过并清除有访问位的块
+    TWO_Q, // 2Q：新块先进入FIFO，被再次访问（在换出记录中命中）后才进入LRU主队列
+    ARC,   // 自适应替换：在"只访问一次"和"多次访问"两个队列之间按换出记录的命中自动调整比例
+};
+
+/**
+ * 替换策略的接口，由BasicBufferPool调用
+ * 策略只管理已装入盘块的缓存块，空闲块由缓存池自己管理
+ * @tparam G 几何参数
+ */
+template<typename G>
+class BasicReplacementPolicy {
+public:
+    using BufferCache = BasicBufferCache<G>;
+
+    virtual ~BasicReplacementPolicy() = default;
+
+    // 缓存未命中，即将为block_no装入一个缓存块（在evict、on_insert之前调用）
+    virtual void on_miss(const uint32_t & /*block_no*/) {}
+
+    // 缓存块刚装入盘块block_no
+    virtual void on_insert(BufferCache *cache_block) = 0;
+
+    // 缓存命中
+    virtual void on_hit(BufferCache *cache_block) = 0;
+
+    // 缓存块被显式移除（不是换出），不留换出记录
+    virtual void on_erase(BufferCache *cache_block) = 0;
+
+    // 缓存块第一次被钉住，在被放开之前不参与换出，默认与移除相同
+    virtual void on_pin(BufferCache *cache_block) {
+        on_erase(cache_block);
+    }
+
+    // 缓存块的最后一个持有者放开，按tag放回原来的队列尾，视为最近访问
+    virtual void on_unpin(BufferCache *cache_block) = 0;
+
+    /**
+     * 选出一个缓存块换出，并把它从策略的队列中移除
+     * @param incoming 即将装入的盘块号
+     */
+    virtual BufferCache *evict(const uint32_t &incoming) = 0;
+
+    // 清空所有队列和换出记录
+    virtual void clear() = 0;
+};
+
+/**
+ * 换出记录（ghost list）：只记录最近被换出的盘块号，不占用缓存块
+ * 只在未命中时访问，此时本来就要读磁盘，使用标准容器即可
+ */
+class GhostList {
+public:
+    [[nodiscard]] bool contains(const uint32_t &block_no) const {
+        return _index.count(block_no) != 0;
+    }
+
+    [[nodiscard]] uint32_t size() const {
+        return _order.size();
+    }
+
+    void push_back(const uint32_t &block_no) {
+        _order.push_back(block_no);
+        _index[block_no] = --_order.end();
+    }
+
+    void erase(const uint32_t &block_no) {
+        auto it = _index.find(block_no);
+        if (it != _index.end()) {
+            _order.erase(it->second);
+            _index.erase(it);
+        }
+    }
+
+    void pop_front() {
+        _index.erase(_order.front());
+        _order.pop_front();
+    }
+
+    void clear() {
+        _order.clear();
+        _index.clear();
+    }
+
+private:
+    std::list<uint32_t> _order; // 从旧到新
+    std::unordered_map<uint32_t, std::list<uint32_t>::iterator> _index;
+};
+
+template<typename G>
+class LruPolicy : public BasicReplacementPolicy<G> {
+public:
+    using BufferCache = BasicBufferCache<G>;
+
+    void on_insert(BufferCache *cache_block) override {
+        _queue.push_back(cache_block);
+    }
+
+    void on_hit(BufferCache *cache_block) override {
+        _queue.move_to_back(cache_block);
+    }
+
+    void on_erase(BufferCache *cache_block) override {
+        _queue.remove(cache_block);
+    }
+
+    void on_unpin(BufferCache *cache_block) override {
+        _queue.push_back(cache_block);
+    }
+
+    BufferCache *evict(const uint32_t &) override {
+        return _queue.pop_front();
+    }
+
+    void clear() override {
+        _queue.clear();
+    }
+
+private:
+    BasicBufferList<G> _queue; // 从最久未使用到最近使用
+};
+
+template<typename G>
+class ClockPolicy : public BasicReplacementPolicy<G> {
+public:
+    using BufferCache = BasicBufferCache<G>;
+
+    // 新块不带访问位，只访问一次的块在指针第一次扫过时就被换出
+    void on_insert(BufferCache *cache_block) override {
+        cache_block->tag = 0;
+        _ring.push_back(cache_block);
+    }
+
+    void on_hit(BufferCache *cache_block) override {
+        cache_block->tag = 1;
+    }
+
+    void on_erase(BufferCache *cache_block) override {
+        _ring.remove(cache_block);
+    }
+
+    // 被钉住期间一直在使用，放回时带访问位
+    void on_unpin(BufferCache *cache_block) override {
+        cache_block->tag = 1;
+        _ring.push_back(cache_block);
+    }
+
+    // 链表头就是时钟指针，有访问位的块清除访问位后移到链表尾，相当于指针前进
+    BufferCache *evict(const uint32_t &) override {
+        while (_ring.front()->tag != 0) {
+            auto cache_block = _ring.front();
+            cache_block->tag = 0;
+            _ring.move_to_back(cache_block);
+        }
+        return _ring.pop_front();
+    }
+
+    void clear() override {
+        _ring.clear();
+    }
+
+private:
+    BasicBufferList<G> _ring;
+};
+
+template<typename G>
+class TwoQueuePolicy : public BasicReplacementPolicy<G> {
+public:
+    using BufferCache = BasicBufferCache<G>;
+
+    /**
+     * 按论文建议，A1in占容量的1/4，A1out记录容量一半的盘块号
+     * @param capacity 缓存块数量
+     */
+    explicit TwoQueuePolicy(const uint32_t &capacity)
+            : _in_limit(std::max<uint32_t>(1, capacity / 4)), _out_limit(std::max<uint32_t>(1, capacity / 2)) {}
+
+    // 在A1out中命中说明不久前访问过，直接进入主队列
+    void on_insert(BufferCache *cache_block) override {
+        if (_a1_out.contains(cache_block->block_no)) {
+            _a1_out.erase(cache_block->block_no);
+            cache_block->tag = MAIN;
+            _am.push_back(cache_block);
+        } else {
+            cache_block->tag = IN;
+            _a1_in.push_back(cache_block);
+        }
+    }
+
+    // A1in中的块命中不移动，避免一次扫描中的相关访问被当作多次访问
+    void on_hit(BufferCache *cache_block) override {
+        if (cache_block->tag == MAIN) {
+            _am.move_to_back(cache_block);
+        }
+    }
+
+    void on_erase(BufferCache *cache_block) override {
+        (cache_block->tag == MAIN ? _am : _a1_in).remove(cache_block);
+    }
+
+    void on_unpin(BufferCache *cache_block) override {
+        (cache_block->tag == MAIN ? _am : _a1_in).push_back(cache_block);
+    }
+
+    BufferCache *evict(const uint32_t &) override {
+        if (_a1_in.size() > _in_limit || _am.empty()) {
+            auto cache_block = _a1_in.pop_front();
+            _a1_out.push_back(cache_block->block_no);
+            if (_a1_out.size() > _out_limit) {
+                _a1_out.pop_front();
+            }
+            return cache_block;
+        }
+        return _am.pop_front();
+    }
+
+    void clear() override {
+        _a1_in.clear();
+        _am.clear();
+        _a1_out.clear();
+    }
+
+private:
+    static constexpr uint8_t IN = 0;
+    static constexpr uint8_t MAIN = 1;
+
+    BasicBufferList<G> _a1_in; // 第一次访问的块，FIFO
+    BasicBufferList<G> _am;    // 多次访问的块，LRU
+    GhostList _a1_out;         // 从A1in换出的盘块号
+    const uint32_t _in_limit;
+    const uint32_t _out_limit;
+};
+
+template<typename G>
+class ArcPolicy : public BasicReplacementPolicy<G> {
+public:
+    using BufferCache = BasicBufferCache<G>;
+
+    explicit ArcPolicy(const uint32_t &capacity) : _capacity(capacity) {}
+
+    // 在换出记录中命中时调整T1的目标大小：B1命中说明T1太小，B2命中说明T2太小
+    void on_miss(const uint32_t &block_no) override {
+        if (_b1.contains(block_no)) {
+            _target = std::min(_capacity, _target + std::max<uint32_t>(1, _b2.size() / _b1.size()));
+        } else if (_b2.contains(block_no)) {
+            uint32_t delta = std::max<uint32_t>(1, _b1.size() / _b2.size());
+            _target = _target > delta ? _target - delta : 0;
+        }
+    }
+
+    void on_insert(BufferCache *cache_block) override {
+        auto block_no = cache_block->block_no;
+        if (_b1.contains(block_no) || _b2.contains(block_no)) {
+            _b1.erase(block_no);
+            _b2.erase(block_no);
+            cache_block->tag = FREQUENT;
+            _t2.push_back(cache_block);
+            return;
+        }
+        cache_block->tag = RECENT;
+        _t1.push_back(cache_block);
+        // 保持 |T1|+|B1| <= c 且总记录数 <= 2c
+        if (_t1.size() + _b1.size() > _capacity && _b1.size() > 0) {
+            _b1.pop_front();
+        }
+        if (_t1.size() + _t2.size() + _b1.size() + _b2.size() > 2 * _capacity && _b2.size() > 0) {
+            _b2.pop_front();
+        }
+    }
+
+    void on_hit(BufferCache *cache_block) override {
+        (cache_block->tag == FREQUENT ? _t2 : _t1).remove(cache_block);
+        cache_block->tag = FREQUENT;
+        _t2.push_back(cache_block);
+    }
+
+    void on_erase(BufferCache *cache_block) override {
+        (cache_block->tag == FREQUENT ? _t2 : _t1).remove(cache_block);
+    }
+
+    void on_unpin(BufferCache *cache_block) override {
+        (cache_block->tag == FREQUENT ? _t2 : _t1).push_back(cache_block);
+    }
+
+    BufferCache *evict(const uint32_t &incoming) override {
+        bool from_t1 = !_t1.empty() &&
+                       (_t1.size() > _target || (_b2.contains(incoming) && _t1.size() == _target) || _t2.empty());
+        if (from_t1) {
+            auto cache_block = _t1.pop_front();
+            _b1.push_back(cache_block->block_no);
+            return cache_block;
+        }
+        auto cache_block = _t2.pop_front();
+        _b2.push_back(cache_block->block_no);
+        return cache_block;
+    }
+
+    void clear() override {
+        _t1.clear();
+        _t2.clear();
+        _b1.clear();
+        _b2.clear();
+        _target = 0;
+    }
+
+private:
+    static constexpr uint8_t RECENT = 0;
+    static constexpr uint8_t FREQUENT = 1;
+
+    BasicBufferList<G> _t1; // 最近只访问过一次的块
+    BasicBufferList<G> _t2; // 最近访问过多次的块
+    GhostList _b1;          // 从T1换出的盘块号
+    GhostList _b2;          // 从T2换出的盘块号
+    const uint32_t _capacity;
+    uint32_t _target = 0;   // T1的目标大小p
+};
+
+/**
+ * 创建替换策略
+ * @param policy 策略
+ * @param capacity 缓存块数量
+ */
+template<typename G>
+std::unique_ptr<BasicReplacementPolicy<G>> make_replacement_policy(CachePolicy policy, const uint32_t &capacity) {
+    switch (policy) {
+        case CachePolicy::LRU:
+            return std::make_unique<LruPolicy<G>>();
+        case CachePolicy::CLOCK:
+            return std::make_unique<ClockPolicy<G>>();
+        case CachePolicy::TWO_Q:
+            return std::make_unique<TwoQueuePolicy<G>>(capacity);
+        case CachePolicy::ARC:
+            return std::make_unique<ArcPolicy<G>>(capacity);
+    }
+    throw std::invalid_argument("Unknown cache policy");
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+/**
+ * 固定数组中元素的双向链表：链接以下标保存在链表自己的数组中，元素本身不带指针，
+ * 插入、删除都是O(1)且不分配内存，用于管理内存Inode表
+ * 一个元素同一时间只能在一个链表中
+ * @tparam T 元素类型
+ * @tparam N 数组长度
+ */
+template<typename T, uint32_t N>
+class SlotList {
+public:
+    /**
+     * @param base 元素数组的起始地址，链表中的指针都必须指向这个数组
+     */
+    explicit SlotList(T *base) : _base(base) {
+        clear();
+    }
+
+    SlotList(const SlotList &) = delete;
+
+    SlotList &operator=(const SlotList &) = delete;
+
+    void clear() {
+        _prev.fill(NONE);
+        _next.fill(NONE);
+        _prev[HEAD] = _next[HEAD] = HEAD;
+        _size = 0;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return _size == 0;
+    }
+
+    [[nodiscard]] uint32_t size() const {
+        return _size;
+    }
+
+    // 链表头，即最早插入的元素，链表为空时返回nullptr
+    [[nodiscard]] T *front() const {
+        return empty() ? nullptr : _base + _next[HEAD];
+    }
+
+    void push_back(T *element) {
+        uint32_t index = element - _base;
+        _prev[index] = _prev[HEAD];
+        _next[index] = HEAD;
+        _next[_prev[HEAD]] = index;
+        _prev[HEAD] = index;
+        _size++;
+    }
+
+    // 元素不在链表中时什么也不做
+    void remove(T *element) {
+        uint32_t index = element - _base;
+        if (_next[index] == NONE) {
+            return;
+        }
+        _next[_prev[index]] = _next[index];
+        _prev[_next[index]] = _prev[index];
+        _prev[index] = _next[index] = NONE;
+        _size--;
+    }
+
+    void pop_front() {
+        if (!empty()) {
+            remove(front());
+        }
+    }
+
+private:
+    static constexpr uint32_t HEAD = N;         // 哨兵的下标
+    static constexpr uint32_t NONE = UINT32_MAX; // 不在链表中
+
+    T *_base;
+    std::array<uint32_t, N + 1> _prev{};
+    std::array<uint32_t, N + 1> _next{};
+    uint32_t _size = 0;
+};
@@ -2,20 +2,12 @@
 
 #include <cstdint>
 #include <ctime>
-#include <bitset>
+#include <stdexcept>
+#include "Geometry.hpp"
 
-#define INODE_COUNT (3968) // 几个inode块，用于bitset
-#define BLOCK_COUNT (2097152) // 几个数据块，用于bitset
 
-#define INODE_SIZE (INODE_COUNT / 8) // INODE扇区数量，8个inode块一个扇区
-
-#define SUPER_BLOCK_SIZE ((16 + INODE_COUNT / 8 + BLOCK_COUNT / 8) / 512) // SUPER_BLOCK扇区数量
-
-#define INODE_START_INDEX (SUPER_BLOCK_SIZE) // INODE起始扇区
-#define BLOCK_START_INDEX (SUPER_BLOCK_SIZE + INODE_SIZE)   // 数据块起始扇区
-
-
-class SuperBlock {
+template<typename G>
+class BasicSuperBlock {
 public:
     // Block的数量
     uint32_t block_count;
@@ -28,100 +20,94 @@ public:
     // 记录block_bitmap上次分配到哪个位置，加速get_free_block
     uint32_t last_i;
 
-    std::bitset<INODE_COUNT> inode_bitmap;
+    // 磁盘块大小，格式化时记录，挂载时与编译期的几何参数比对
+    uint32_t block_size;
+    // Inode区的起始块号
+    uint32_t inode_start_index;
+    // 数据区的起始块号
+    uint32_t block_start_index;
+
+    uint32_t padding;
+
+    Bitmap<G::INODE_COUNT> inode_bitmap;
 
-    std::bitset<BLOCK_COUNT> block_bitmap;
+    Bitmap<G::BLOCK_COUNT> block_bitmap;
 
+private:
+    // 补齐到整数个块
+    char padding_to_block[G::SUPER_BLOCK_BLOCKS * G::BLOCK_SIZE - G::SUPER_BLOCK_HEADER_SIZE -
+                          sizeof(Bitmap<G::INODE_COUNT>) - sizeof(Bitmap<G::BLOCK_COUNT>)] {};
 
 public:
-    SuperBlock() {
-        block_count = BLOCK_COUNT;
-        inode_count = INODE_COUNT;
+    BasicSuperBlock() {
+        block_count = G::BLOCK_COUNT;
+        inode_count = G::INODE_COUNT;
         dirty_flag = 0;
         last_i = 0;
+        block_size = G::BLOCK_SIZE;
+        inode_start_index = G::INODE_START_INDEX;
+        block_start_index = G::BLOCK_START_INDEX;
+        padding = 0;
     }
 
     void format() {
-        block_count = BLOCK_COUNT;
-        inode_count = INODE_COUNT;
+        *this = BasicSuperBlock();
         dirty_flag = 1; // 格式化后需要写回磁盘，所以设置脏标志
+    }
 
-        inode_bitmap.reset();
-        block_bitmap.reset();
-        last_i = 0;
+    // 磁盘上记录的布局是否与编译期的几何参数一致
+    [[nodiscard]] bool matches_geometry() const {
+        return block_size == G::BLOCK_SIZE && block_count == G::BLOCK_COUNT && inode_count == G::INODE_COUNT &&
+               inode_start_index == G::INODE_START_INDEX && block_start_index == G::BLOCK_START_INDEX;
     }
 
     // 获取空闲Inode
     uint32_t get_free_inode() {
-        // 从位图中找到第一个空闲的Inode
-        for (uint32_t i = 1; i < inode_count; i++) {
-            if (!inode_bitmap.test(i)) {
-                inode_bitmap.set(i);
-                dirty_flag = 1;
-                return i;
-            }
+        // 从位图中找到第一个空闲的Inode，0号不使用
+        auto i = inode_bitmap.find_zero(1, inode_count);
+        if (i == inode_bitmap.NPOS) {
+            throw std::runtime_error("No free inode");
         }
-        // 如果没有空闲Inode
-        throw std::runtime_error("No free inode");
+        inode_bitmap.set(i);
+        dirty_flag = 1;
+        return i;
     }
 
     // 获取空闲Block
     uint32_t get_free_block() {
-        // 从位图中找到第一个空闲的Block
-        // for (uint32_t i = last_i; i < block_count; i++) {
-        //     if (!block_bitmap.test(i)) {
-        //         block_bitmap.set(i);
-        //         dirty_flag = 1;
-        //         last_i = (i + 1) % block_count;
-        //         return i + BLOCK_START_INDEX;
-        //     }
-        //
-        //     if (i + 1 == last_i) {
-        //         break;
-        //     }
-        // }
-        uint32_t i = last_i;
-        do {
-            if (i == 0) ++i;
-            if (!block_bitmap.test(i)) {
-                block_bitmap.set(i);
-                dirty_flag = 1;
-                last_i = (i + 1) % block_count;
-                return i + BLOCK_START_INDEX;
-            }
-            i = (i + 1) % block_count;
-        } while (i != last_i);
-
-        // 如果没有空闲Block
-        throw std::runtime_error("No free block");
+        // 从上次分配的位置向后找，到末尾后再从头找到上次的位置；0号数据块不使用
+        uint32_t start = last_i == 0 ? 1 : last_i;
+        auto i = block_bitmap.find_zero(start, block_count);
+        if (i == block_bitmap.NPOS) {
+            i = block_bitmap.find_zero(1, start);
+        }
+        if (i == block_bitmap.NPOS) {
+            throw std::runtime_error("No free block");
+        }
+        block_bitmap.set(i);
+        dirty_flag = 1;
+        last_i = (i + 1) % block_count;
+        return i + G::BLOCK_START_INDEX;
     }
 
     // 获取连续的空闲Block
     uint32_t get_free_blocks(uint32_t block_num) {
-        // 从位图中找到连续的block_num个空闲的Block
-        for (uint32_t i = 0; i < block_count - block_num; i++) {
-            if (block_bitmap.test(i)) {
-                continue;
-            }
-            uint32_t j = 1;
-            for (; j < block_num; j++) {
-                if (block_bitmap.test(i + j)) {
-                    break;
-                }
-            }
-            if (j == block_num) {
-                for (uint32_t k = 0; k < block_num; k++) {
-                    block_bitmap.set(i + k);
-                }
-                dirty_flag = 1;
-                return i + BLOCK_START_INDEX;
-            }
+        if (block_num == 0) {
+            throw std::invalid_argument("Block count must be positive");
+        }
+        // 从位图中找到连续的block_num个空闲的Block，与get_free_block一样不使用0号数据块
+        auto i = block_bitmap.find_zero_run(block_num, 1, block_count);
+        if (i == block_bitmap.NPOS) {
+            throw std::runtime_error("No free blocks");
         }
-        // 如果没有连续的空闲Block
-        throw std::runtime_error("No free blocks");
+        block_bitmap.set_range(i, block_num);
+        dirty_flag = 1;
+        return i + G::BLOCK_START_INDEX;
     }
 
     [[nodiscard]] inline bool check_block_bit(const uint32_t &p) const {
-        return p != 0 && block_bitmap.test(p - BLOCK_START_INDEX);
+        return p != 0 && block_bitmap.test(p - G::BLOCK_START_INDEX);
     }
-};
\ No newline at end of file
+};
+
+using SuperBlock = BasicSuperBlock<Geometry512>;
@@ -7,7 +7,8 @@
 #include <iomanip>
 #include "fs/FileSystem.hpp"
 
-class Shell {
+template<typename G>
+class BasicShell {
 private:
     // ANSI颜色代码
     const std::string reset = "\033[0m";
@@ -15,7 +16,7 @@ private:
     const std::string green = "\033[1;32m"; // 加粗绿色
     const std::string red = "\033[1;31m";   // 加粗红色
 private:
-    FileSystem fs;
+    BasicFileSystem<G> fs;
 
     // 命令结构，包括处理函数、介绍和使用方法
     struct Command {
@@ -24,10 +25,10 @@ private:
         std::string usage;
     };
 
-    FileSystem::ProgressCallback callback;
+    typename BasicFileSystem<G>::ProgressCallback callback;
 
 public:
-    Shell();
+    BasicShell();
 
     void run();
 
@@ -35,13 +36,17 @@ public:
     std::map<std::string, Command> commands;
     bool is_active = true;
 
+    // format要求的块大小与G不同时，Shell退出，由main换用对应几何参数的Shell重新格式化
+    uint32_t reformat_block_size = 0;
+    std::vector<std::string> reformat_args;
+
     void process_command(const std::string& input);
 
     void help();
 
     void exit_shell();
 
-    void format();
+    void format(const std::vector<std::string> &args);
 
     void ls();
 
@@ -65,13 +70,30 @@ public:
 
     void fseek(const std::vector<std::string> &vector);
 
+    void fallocate(const std::vector<std::string> &vector);
+
     void fwrite(const std::vector<std::string> &vector);
 
     void cat(const std::vector<std::string> &vector);
 
     void flist();
 
+    void durability(const std::vector<std::string> &vector);
+
+    void cache(const std::vector<std::string> &vector);
+
+    void writeback(const std::vector<std::string> &vector);
+
+    void directio(const std::vector<std::string> &vector);
+
+    void delalloc(const std::vector<std::string> &vector);
+
     void upload(const std::vector<std::string> &vector);
 
     void download(const std::vector<std::string> &vector);
 };
+
+extern template class BasicShell<Geometry512>;
+extern template class BasicShell<Geometry4K>;
+
+using Shell = BasicShell<Geometry512>;
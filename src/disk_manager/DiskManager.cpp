@@ -4,76 +4,720 @@
 
 #include "disk_manager/DiskManager.hpp"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <fcntl.h>
+#include <future>
+#include <sys/mman.h>
+#include <unordered_map>
+#include <unistd.h>
 
-DiskManager::DiskManager(const std::string &file_path, const uint32_t& file_size) : _file_path(file_path), _file_size(file_size) {
-    if (!_disk_file.is_open()) {
-        // 检查文件是否存在
-        std::ifstream existing_file(file_path, std::ios::binary);
-        if (!existing_file) {
-            // 文件不存在，创建并设置为1G大小
-            std::ofstream new_file(file_path, std::ios::binary | std::ios::out);
-            if (!new_file) {
-                throw std::runtime_error("Failed to create disk file.");
+#define IO_URING_ENTRIES (256) // io_uring 提交队列长度
+
+
+DiskManager::DiskManager(const std::string &file_path, const uint32_t& file_size, DiskMode mode,
+                         const uint32_t& block_size)
+        : _file_path(file_path), _file_size(file_size), _block_size(block_size), _mode(mode) {
+    // 检查文件是否存在，不存在则创建一个稀疏文件
+    if (::access(file_path.c_str(), F_OK) != 0) {
+        _create(ImageAllocation::SPARSE);
+    }
+
+    // 打开文件以供读写
+    _open();
+}
+
+DiskManager::DiskManager(const std::vector<std::string> &file_paths, const uint32_t& file_size, DiskMode mode,
+                         const uint32_t& block_size, const uint32_t& stripe_blocks)
+        : _file_size(file_size), _block_size(block_size), _mode(mode), _stripe_blocks(stripe_blocks) {
+    if (file_paths.empty() || stripe_blocks == 0) {
+        throw std::runtime_error("Striped disk needs at least one file and a non-zero stripe unit");
+    }
+    if (file_paths.size() == 1) {
+        _file_path = file_paths[0];
+        if (::access(_file_path.c_str(), F_OK) != 0) {
+            _create(ImageAllocation::SPARSE);
+        }
+        _open();
+        return;
+    }
+    // 每个文件存放 ceil(总块数 / (条带单元 * 文件数)) 行条带
+    uint64_t total_blocks = ((uint64_t) file_size + block_size - 1) / block_size;
+    uint64_t row_blocks = (uint64_t) stripe_blocks * file_paths.size();
+    uint64_t rows = (total_blocks + row_blocks - 1) / row_blocks;
+    auto stripe_size = static_cast<uint32_t>(rows * stripe_blocks * block_size);
+    for (const auto &path: file_paths) {
+        _stripes.push_back(std::make_unique<DiskManager>(path, stripe_size, mode, block_size));
+    }
+}
+
+template<typename Fn>
+void DiskManager::_for_each_stripe_chunk(const uint32_t& block_id, const uint32_t& block_num, Fn fn) {
+    const uint32_t stripe_count = _stripes.size();
+    uint32_t done = 0;
+    while (done < block_num) {
+        uint32_t block = block_id + done;
+        uint32_t unit = block / _stripe_blocks;     // 第几个条带单元
+        uint32_t in_unit = block % _stripe_blocks;  // 在条带单元中的偏移
+        uint32_t count = std::min(_stripe_blocks - in_unit, block_num - done);
+        uint32_t physical = unit / stripe_count * _stripe_blocks + in_unit;
+        fn(unit % stripe_count, physical, done, count);
+        done += count;
+    }
+}
+
+template<typename Fn>
+void DiskManager::_run_stripes(const std::vector<DiskManager *> &stripes, Fn fn) {
+    if (stripes.size() == 1) {
+        fn(*stripes[0]);
+    } else if (stripes.size() > 1) {
+        // 第一个在当前线程执行，其余的各用一个线程，全部完成后再抛出异常
+        std::vector<std::future<void>> futures;
+        for (size_t i = 1; i < stripes.size(); i++) {
+            futures.push_back(std::async(std::launch::async, [&fn, stripe = stripes[i]]() { fn(*stripe); }));
+        }
+        std::exception_ptr error;
+        try {
+            fn(*stripes[0]);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        for (auto &future: futures) {
+            try {
+                future.get();
+            } catch (...) {
+                if (!error) {
+                    error = std::current_exception();
+                }
             }
-            // new_file.seekp((1LL << 30) - 1); // 移动到1G-1位置
-            new_file.seekp((file_size) - 1); // 移动到1G-1位置
-            new_file.write("\0", 1); // 写入一个字节以扩展文件大小到1G
-            new_file.close();
         }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    _collect_stats();
+}
+
+void DiskManager::_collect_stats() {
+    _stats = DiskStats();
+    for (const auto &stripe: _stripes) {
+        _stats.read_calls += stripe->_stats.read_calls;
+        _stats.write_calls += stripe->_stats.write_calls;
+        _stats.discard_calls += stripe->_stats.discard_calls;
+        _stats.sync_calls += stripe->_stats.sync_calls;
+    }
+}
 
-        // 打开文件以供读写
-        _disk_file.open(file_path, std::ios::in | std::ios::out | std::ios::binary);
+void DiskManager::_open() {
+    if (_mode == DiskMode::STREAM) {
+        _disk_file.open(_file_path, std::ios::in | std::ios::out | std::ios::binary);
         if (!_disk_file) {
             throw std::runtime_error("Failed to open disk file.");
         }
+        return;
     }
-}
 
-void DiskManager::format() {
-    // 关闭当前打开的文件
-    _disk_file.close();
+    _fd = ::open(_file_path.c_str(), O_RDWR);
+    if (_fd < 0) {
+        throw std::runtime_error("Failed to open disk file: " + std::string(std::strerror(errno)));
+    }
 
-    // 以输出模式重新打开文件，这将清空文件内容
-    _disk_file.open(_file_path, std::ios::out | std::ios::trunc | std::ios::binary);
-    _disk_file.seekp(_file_size - 1);
-    _disk_file.write("\0", 1);
-    // 关闭并以读写模式重新打开文件
-    _disk_file.close();
-    _disk_file.open(_file_path, std::ios::in | std::ios::out | std::ios::binary);
+    if (_mode == DiskMode::MMAP) {
+        void *mapping = ::mmap(nullptr, _file_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Failed to map disk file: " + std::string(std::strerror(errno)));
+        }
+        _mapping = static_cast<char *>(mapping);
+    }
 
-    // 确保文件流处于良好状态
-    if (!_disk_file.good()) {
-        throw std::runtime_error("Failed to format the disk file.");
+#ifdef O_DIRECT
+    if (_mode == DiskMode::POSIX || _mode == DiskMode::URING) {
+        // 宿主文件系统不支持O_DIRECT时直接读写退化为普通读写
+        _direct_fd = ::open(_file_path.c_str(), O_RDWR | O_DIRECT);
+    }
+#endif
+
+    if (_mode == DiskMode::URING && !_ring) {
+        try {
+            _ring = std::make_unique<IoUring>(IO_URING_ENTRIES);
+        } catch (const std::runtime_error &) {
+            // 内核不支持或禁用了io_uring，submit()退化为逐个同步读写
+            _ring.reset();
+        }
     }
 }
 
-DiskManager::~DiskManager() {
+void DiskManager::_close() {
+    if (_mapping != nullptr) {
+        ::munmap(_mapping, _file_size);
+        _mapping = nullptr;
+    }
     if (_disk_file.is_open()) {
         _disk_file.close();
     }
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+    if (_direct_fd >= 0) {
+        ::close(_direct_fd);
+        _direct_fd = -1;
+    }
 }
 
-std::vector<char> DiskManager::_read(const std::streamoff& position, const std::streamsize& length) {
-    std::vector<char> buffer(length);
-    _disk_file.seekg(position);
-    _disk_file.read(buffer.data(), length);
-    return buffer;
+void DiskManager::format(ImageAllocation allocation) {
+    if (!_stripes.empty()) {
+        std::vector<DiskManager *> stripes;
+        for (auto &stripe: _stripes) {
+            stripes.push_back(stripe.get());
+        }
+        _run_stripes(stripes, [allocation](DiskManager &stripe) { stripe.format(allocation); });
+        return;
+    }
+    // 关闭当前打开的文件，截断后重新打开
+    _drain();
+    _close();
+    _create(allocation);
+    _open();
+}
+
+void DiskManager::_create(ImageAllocation allocation) {
+    int fd = ::open(_file_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create disk file: " + std::string(std::strerror(errno)));
+    }
+    // 截断到0再扩展，旧数据全部丢弃，未写过的部分读出为0且不占用宿主空间
+    int error = ::ftruncate(fd, _file_size) == 0 ? 0 : errno;
+    if (error == 0 && allocation == ImageAllocation::PREALLOCATE) {
+#ifdef __linux__
+        // 只分配不写入，区段标记为未写入，读出仍为0
+        if (::fallocate(fd, 0, 0, _file_size) != 0) {
+            error = errno;
+            if (error == EOPNOTSUPP) {
+                // 宿主文件系统不支持fallocate，退化为posix_fallocate（可能逐块写0）
+                error = ::posix_fallocate(fd, 0, _file_size);
+            }
+        }
+#else
+        // 其他平台没有通用的只分配不写入的接口，保持稀疏
+#endif
+    }
+    ::close(fd);
+    if (error != 0) {
+        throw std::runtime_error("Failed to format the disk file: " + std::string(std::strerror(error)));
+    }
+}
+
+DiskManager::~DiskManager() {
+    // 内核可能还在读写调用者的缓冲区，先等它们完成
+    try {
+        _drain();
+    } catch (const std::runtime_error &) {
+    }
+    _close();
+}
+
+void DiskManager::_read(const std::streamoff& position, const std::streamsize& length, char *buffer) {
+    if (_mode == DiskMode::STREAM || _mode == DiskMode::MMAP) {
+        _stats.read_calls++;
+    }
+    if (_mode == DiskMode::STREAM) {
+        _disk_file.seekg(position);
+        _disk_file.read(buffer, length);
+        return;
+    }
+    if (_mode == DiskMode::MMAP) {
+        if (position + length > _file_size) {
+            throw std::out_of_range("DiskManager::_read out of range");
+        }
+        std::memcpy(buffer, _mapping + position, length);
+        return;
+    }
+
+    std::streamsize done = 0;
+    while (done < length) {
+        auto n = ::pread(_fd, buffer + done, length - done, position + done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Failed to read disk file: " + std::string(std::strerror(errno)));
+        }
+        _stats.read_calls++;
+        if (n == 0) {
+            // 超过文件末尾的部分置为0
+            std::memset(buffer + done, 0, length - done);
+            break;
+        }
+        done += n;
+    }
+}
+
+void DiskManager::_write(const std::streamoff& position, const char *data, const std::streamsize& length) {
+    if (_mode == DiskMode::STREAM || _mode == DiskMode::MMAP) {
+        _stats.write_calls++;
+    }
+    if (_mode == DiskMode::STREAM) {
+        _disk_file.seekp(position);
+        _disk_file.write(data, length);
+        _disk_file.flush();
+        return;
+    }
+    if (_mode == DiskMode::MMAP) {
+        if (position + length > _file_size) {
+            throw std::out_of_range("DiskManager::_write out of range");
+        }
+        std::memcpy(_mapping + position, data, length);
+        return;
+    }
+
+    std::streamsize done = 0;
+    while (done < length) {
+        auto n = ::pwrite(_fd, data + done, length - done, position + done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Failed to write disk file: " + std::string(std::strerror(errno)));
+        }
+        _stats.write_calls++;
+        done += n;
+    }
+}
+
+void DiskManager::queue_read(const uint32_t& block_id, const uint32_t& block_num, char *buffer) {
+    if (!_stripes.empty()) {
+        _for_each_stripe_chunk(block_id, block_num, [&](uint32_t stripe, uint32_t physical, uint32_t offset,
+                                                        uint32_t count) {
+            _stripes[stripe]->queue_read(physical, count, buffer + (size_t) offset * _block_size);
+        });
+        return;
+    }
+    _queue.push_back({false, block_id, block_num, buffer});
+}
+
+void DiskManager::queue_write(const uint32_t& block_id, const char *data, const uint32_t& block_num) {
+    if (!_stripes.empty()) {
+        _for_each_stripe_chunk(block_id, block_num, [&](uint32_t stripe, uint32_t physical, uint32_t offset,
+                                                        uint32_t count) {
+            _stripes[stripe]->queue_write(physical, data + (size_t) offset * _block_size, count);
+        });
+        return;
+    }
+    _queue.push_back({true, block_id, block_num, const_cast<char *>(data)});
+}
+
+void DiskManager::submit() {
+    if (!_stripes.empty()) {
+        // 只提交有请求的条带，每个条带在自己的队列上合并相邻请求
+        std::vector<DiskManager *> stripes;
+        for (auto &stripe: _stripes) {
+            if (!stripe->_queue.empty()) {
+                stripes.push_back(stripe.get());
+            }
+        }
+        _run_stripes(stripes, [](DiskManager &stripe) { stripe.submit(); });
+        return;
+    }
+    if (_queue.empty()) {
+        return;
+    }
+    if (_ring) {
+        wait(submit_async());
+        return;
+    }
+    for (auto &run: _take_runs()) {
+        _transfer(run);
+    }
+}
+
+std::vector<DiskManager::IoRun> DiskManager::_take_runs() {
+    auto queue = std::move(_queue);
+    _queue.clear();
+
+    // 按盘块号排序，把物理相邻的同类请求合并为一次向量读写
+    std::sort(queue.begin(), queue.end(), [](const IoRequest &a, const IoRequest &b) {
+        return a.write != b.write ? a.write < b.write : a.block_id < b.block_id;
+    });
+    std::vector<IoRun> runs;
+    for (const auto &request: queue) {
+        iovec iov{request.buffer, (size_t) request.block_num * _block_size};
+        if (!runs.empty()) {
+            auto &last = runs.back();
+            if (last.write == request.write && last.block_id + last.block_num == request.block_id &&
+                last.iov.size() < IOV_MAX) {
+                last.block_num += request.block_num;
+                last.iov.push_back(iov);
+                continue;
+            }
+        }
+        runs.push_back({request.write, request.block_id, request.block_num, {iov}});
+    }
+    return runs;
+}
+
+uint64_t DiskManager::submit_async() {
+    const uint64_t id = _next_batch++;
+    const bool async = _stripes.empty() ? _ring != nullptr : _mode == DiskMode::URING;
+    if (!async) {
+        // 没有io_uring时同步完成，返回的批次已经完成
+        submit();
+        _batches[id];
+        return id;
+    }
+
+    IoBatch batch;
+    if (!_stripes.empty()) {
+        // 各条带在自己的队列上合并、提交，不需要为并行另开线程
+        try {
+            for (auto &stripe: _stripes) {
+                if (!stripe->_queue.empty()) {
+                    batch.parts.emplace_back(stripe.get(), stripe->submit_async());
+                }
+            }
+        } catch (...) {
+            // 已经提交到其他条带的部分完成后再抛出，它们的缓冲区由调用者释放
+            for (auto &[stripe, part]: batch.parts) {
+                try {
+                    stripe->wait(part);
+                } catch (const std::runtime_error &) {
+                }
+            }
+            throw;
+        }
+        _collect_stats();
+        _batches.emplace(id, std::move(batch));
+        return id;
+    }
+    batch.runs = _take_runs();
+    _submit_uring(id, _batches.emplace(id, std::move(batch)).first->second);
+    return id;
 }
 
-void DiskManager::_write(const std::streamoff& position, const std::vector<char>& data) {
-    _disk_file.seekp(position);
-    _disk_file.write(data.data(), static_cast<std::streamsize>(data.size()));
-    _disk_file.flush();
+void DiskManager::poll() {
+    for (auto &stripe: _stripes) {
+        stripe->poll();
+    }
+    if (_ring) {
+        _reap(false);
+    }
+}
+
+bool DiskManager::is_complete(const uint64_t &batch) {
+    poll();
+    auto it = _batches.find(batch);
+    if (it == _batches.end()) {
+        throw std::logic_error("Unknown disk batch: " + std::to_string(batch));
+    }
+    if (it->second.pending > 0) {
+        return false;
+    }
+    return std::all_of(it->second.parts.begin(), it->second.parts.end(), [](const auto &part) {
+        return part.first->is_complete(part.second);
+    });
+}
+
+void DiskManager::wait(const uint64_t &batch) {
+    auto it = _batches.find(batch);
+    if (it == _batches.end()) {
+        throw std::logic_error("Unknown disk batch: " + std::to_string(batch));
+    }
+    // 收割时不会增删批次，迭代器一直有效
+    while (it->second.pending > 0) {
+        _reap(true);
+    }
+    std::string error = std::move(it->second.error);
+    auto parts = std::move(it->second.parts);
+    _batches.erase(it);
+    for (auto &[stripe, part]: parts) {
+        try {
+            stripe->wait(part);
+        } catch (const std::runtime_error &e) {
+            if (error.empty()) {
+                error = e.what();
+            }
+        }
+    }
+    if (!parts.empty()) {
+        _collect_stats();
+    }
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+}
+
+void DiskManager::_drain() {
+    for (auto &stripe: _stripes) {
+        stripe->_drain();
+    }
+    while (_ring && _ring->in_flight() > 0) {
+        _reap(true);
+    }
+}
+
+void DiskManager::_transfer(IoRun &run) {
+    auto position = (std::streamoff) run.block_id * _block_size;
+    if (_mode == DiskMode::STREAM || _mode == DiskMode::MMAP) {
+        for (const auto &iov: run.iov) {
+            if (run.write) {
+                _write(position, static_cast<const char *>(iov.iov_base), (std::streamsize) iov.iov_len);
+            } else {
+                _read(position, (std::streamsize) iov.iov_len, static_cast<char *>(iov.iov_base));
+            }
+            position += (std::streamoff) iov.iov_len;
+        }
+        return;
+    }
+
+    size_t index = 0;
+    while (index < run.iov.size()) {
+        auto count = static_cast<int>(run.iov.size() - index);
+        auto n = run.write ? ::pwritev(_fd, &run.iov[index], count, position)
+                           : ::preadv(_fd, &run.iov[index], count, position);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Failed to transfer disk blocks: " + std::string(std::strerror(errno)));
+        }
+        run.write ? _stats.write_calls++ : _stats.read_calls++;
+        if (n == 0 && !run.write) {
+            // 超过文件末尾的部分置为0
+            for (; index < run.iov.size(); index++) {
+                std::memset(run.iov[index].iov_base, 0, run.iov[index].iov_len);
+            }
+            break;
+        }
+        position += n;
+        // 跳过已经完成的部分
+        while (n > 0) {
+            auto &iov = run.iov[index];
+            if ((size_t) n >= iov.iov_len) {
+                n -= (ssize_t) iov.iov_len;
+                index++;
+            } else {
+                iov.iov_base = static_cast<char *>(iov.iov_base) + n;
+                iov.iov_len -= n;
+                n = 0;
+            }
+        }
+    }
+}
+
+void DiskManager::_submit_uring(const uint64_t &id, IoBatch &batch) {
+    // user_data的高32位是批次号，低32位是批次中的下标；队列满时先收割一些完成的请求
+    try {
+        for (uint32_t i = 0; i < batch.runs.size(); i++) {
+            while (_ring->space() == 0) {
+                _ring->submit();
+                _reap(true);
+            }
+            const auto &run = batch.runs[i];
+            auto offset = (uint64_t) run.block_id * _block_size;
+            auto count = static_cast<uint32_t>(run.iov.size());
+            const uint64_t user_data = id << 32 | i;
+            if (run.write) {
+                _ring->prep_writev(_fd, run.iov.data(), count, offset, user_data);
+                _stats.write_calls++;
+            } else {
+                _ring->prep_readv(_fd, run.iov.data(), count, offset, user_data);
+                _stats.read_calls++;
+            }
+            batch.pending++;
+        }
+        _ring->submit();
+    } catch (const std::runtime_error &e) {
+        // 已经排队的请求仍会提交并完成，没有排队的不再提交，错误在wait()时抛出
+        batch.error = e.what();
+    }
+}
+
+void DiskManager::_reap(const bool &wait) {
+    _ring->reap([this](uint64_t user_data, int32_t res) {
+        auto &batch = _batches.at(user_data >> 32);
+        auto &run = batch.runs[user_data & UINT32_MAX];
+        batch.pending--;
+        if (res < 0) {
+            if (batch.error.empty()) {
+                batch.error = "Failed to submit disk requests: " + std::string(std::strerror(-res));
+            }
+        } else if ((uint64_t) res != (uint64_t) run.block_num * _block_size) {
+            // 短读写由同步读写补全
+            try {
+                _transfer(run);
+            } catch (const std::runtime_error &e) {
+                if (batch.error.empty()) {
+                    batch.error = e.what();
+                }
+            }
+        }
+    }, wait);
+}
+
+void DiskManager::read_direct(const uint32_t& block_id, const uint32_t& block_num, char *buffer) {
+    if (!_stripes.empty()) {
+        _direct_striped(false, block_id, block_num, buffer);
+        return;
+    }
+    _direct(false, (std::streamoff) block_id * _block_size, (std::streamsize) block_num * _block_size, buffer);
+}
+
+void DiskManager::write_direct(const uint32_t& block_id, const char *data, const uint32_t& block_num) {
+    if (!_stripes.empty()) {
+        _direct_striped(true, block_id, block_num, const_cast<char *>(data));
+        return;
+    }
+    _direct(true, (std::streamoff) block_id * _block_size, (std::streamsize) block_num * _block_size,
+            const_cast<char *>(data));
+}
+
+void DiskManager::_direct_striped(bool write, const uint32_t& block_id, const uint32_t& block_num, char *buffer) {
+    // 按条带拆分后，各条带内的段依次读写，不同条带并行
+    std::unordered_map<DiskManager *, std::vector<IoRequest>> requests;
+    std::vector<DiskManager *> stripes;
+    _for_each_stripe_chunk(block_id, block_num, [&](uint32_t stripe, uint32_t physical, uint32_t offset,
+                                                    uint32_t count) {
+        auto disk = _stripes[stripe].get();
+        if (requests.count(disk) == 0) {
+            stripes.push_back(disk);
+        }
+        requests[disk].push_back({write, physical, count, buffer + (size_t) offset * _block_size});
+    });
+    _run_stripes(stripes, [&requests](DiskManager &stripe) {
+        for (const auto &request: requests.at(&stripe)) {
+            stripe._direct(request.write, (std::streamoff) request.block_id * stripe._block_size,
+                           (std::streamsize) request.block_num * stripe._block_size, request.buffer);
+        }
+    });
+}
+
+void DiskManager::_direct(bool write, const std::streamoff& position, const std::streamsize& length, char *buffer) {
+    bool aligned = reinterpret_cast<uintptr_t>(buffer) % DIRECT_IO_ALIGNMENT == 0;
+    std::streamsize done = 0;
+    while (_direct_fd >= 0 && aligned && done < length) {
+        auto n = write ? ::pwrite(_direct_fd, buffer + done, length - done, position + done)
+                       : ::pread(_direct_fd, buffer + done, length - done, position + done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EINVAL) {
+                // 偏移或长度不满足宿主设备的对齐要求，剩余部分走普通读写
+                break;
+            }
+            throw std::runtime_error("Failed to transfer disk blocks directly: " + std::string(std::strerror(errno)));
+        }
+        write ? _stats.write_calls++ : _stats.read_calls++;
+        if (n == 0) {
+            // 超过文件末尾的部分置为0
+            std::memset(buffer + done, 0, length - done);
+            return;
+        }
+        done += n;
+    }
+    if (done < length) {
+        write ? _write(position + done, buffer + done, length - done)
+              : _read(position + done, length - done, buffer + done);
+    }
+}
+
+void DiskManager::discard(const uint32_t& block_id, const uint32_t& block_num) {
+    if (!_stripes.empty()) {
+        // 同一个文件中物理相邻的段合并为一次打洞
+        std::vector<std::pair<uint32_t, uint32_t>> runs(_stripes.size(), {0, 0});
+        _for_each_stripe_chunk(block_id, block_num, [&](uint32_t stripe, uint32_t physical, uint32_t,
+                                                        uint32_t count) {
+            auto &[start, length] = runs[stripe];
+            if (length > 0 && start + length == physical) {
+                length += count;
+                return;
+            }
+            _stripes[stripe]->discard(start, length);
+            start = physical;
+            length = count;
+        });
+        for (size_t i = 0; i < runs.size(); i++) {
+            _stripes[i]->discard(runs[i].first, runs[i].second);
+        }
+        _collect_stats();
+        return;
+    }
+#ifdef __linux__
+    if (_fd < 0 || block_num == 0) {
+        return;
+    }
+    // 保持文件大小不变，只释放这段区间的宿主空间
+    auto position = (off_t) block_id * _block_size;
+    auto length = (off_t) block_num * _block_size;
+    if (::fallocate(_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, position, length) != 0) {
+        if (errno == EOPNOTSUPP) {
+            return;
+        }
+        throw std::runtime_error("Failed to discard disk blocks: " + std::string(std::strerror(errno)));
+    }
+    _stats.discard_calls++;
+#endif
+}
+
+void DiskManager::sync() {
+    // 还在途的写入也要持久化
+    _drain();
+    if (!_stripes.empty()) {
+        std::vector<DiskManager *> stripes;
+        for (auto &stripe: _stripes) {
+            stripes.push_back(stripe.get());
+        }
+        _run_stripes(stripes, [](DiskManager &stripe) { stripe.sync(); });
+        return;
+    }
+    _stats.sync_calls++;
+    if (_mode == DiskMode::STREAM) {
+        _disk_file.flush();
+        return;
+    }
+    if (_mode == DiskMode::MMAP) {
+        if (::msync(_mapping, _file_size, MS_SYNC) != 0) {
+            throw std::runtime_error("Failed to sync disk file: " + std::string(std::strerror(errno)));
+        }
+        return;
+    }
+#ifdef __linux__
+    if (::fdatasync(_fd) != 0) {
+#else
+    if (::fsync(_fd) != 0) {
+#endif
+        throw std::runtime_error("Failed to sync disk file: " + std::string(std::strerror(errno)));
+    }
 }
 
 std::vector<char> DiskManager::read_block(const uint32_t& block_id, const uint32_t& block_num) {
-    return _read(block_id * BLOCK_SIZE, block_num * BLOCK_SIZE);
+    std::vector<char> buffer((size_t) block_num * _block_size);
+    read_block(block_id, block_num, buffer.data());
+    return buffer;
+}
+
+void DiskManager::read_block(const uint32_t& block_id, const uint32_t& block_num, char *buffer) {
+    if (!_stripes.empty()) {
+        _for_each_stripe_chunk(block_id, block_num, [&](uint32_t stripe, uint32_t physical, uint32_t offset,
+                                                        uint32_t count) {
+            _stripes[stripe]->read_block(physical, count, buffer + (size_t) offset * _block_size);
+        });
+        _collect_stats();
+        return;
+    }
+    _read((std::streamoff) block_id * _block_size, (std::streamsize) block_num * _block_size, buffer);
 }
 
 void DiskManager::write_block(const uint32_t& block_id, const std::vector<char>& data) {
-    // data 必须是 BLOCK_SIZE 的整数倍
-    if (data.size() % BLOCK_SIZE != 0) {
-        throw std::runtime_error("Data size must be multiple of BLOCK_SIZE. Data size: " + std::to_string(data.size()));
+    // data 必须是盘块大小的整数倍
+    if (data.size() % _block_size != 0) {
+        throw std::runtime_error("Data size must be multiple of block size. Data size: " + std::to_string(data.size()));
     }
-    _write(block_id * BLOCK_SIZE, data);
-}
\ No newline at end of file
+    write_block(block_id, data.data(), data.size() / _block_size);
+}
+
+void DiskManager::write_block(const uint32_t& block_id, const char *data, const uint32_t& block_num) {
+    if (!_stripes.empty()) {
+        _for_each_stripe_chunk(block_id, block_num, [&](uint32_t stripe, uint32_t physical, uint32_t offset,
+                                                        uint32_t count) {
+            _stripes[stripe]->write_block(physical, data + (size_t) offset * _block_size, count);
+        });
+        _collect_stats();
+        return;
+    }
+    _write((std::streamoff) block_id * _block_size, data, (std::streamsize) block_num * _block_size);
+}
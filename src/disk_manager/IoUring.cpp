@@ -0,0 +1,225 @@
+//
+// io_uring 的最小封装，只在Linux下可用
+//
+
+#include "disk_manager/IoUring.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int io_uring_setup(uint32_t entries, io_uring_params *params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+IoUring::IoUring(const uint32_t &entries) {
+    io_uring_params params{};
+    _ring_fd = io_uring_setup(entries, &params);
+    if (_ring_fd < 0) {
+        throw std::runtime_error("io_uring_setup failed: " + std::string(std::strerror(errno)));
+    }
+    _entries = params.sq_entries;
+
+    _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    // 新内核中SQ和CQ共用一次mmap
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+    }
+
+    _sq_ring = ::mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      _ring_fd, IORING_OFF_SQ_RING);
+    if (_sq_ring == MAP_FAILED) {
+        _sq_ring = nullptr;
+        _release();
+        throw std::runtime_error("Failed to map io_uring SQ ring");
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        _cq_ring = _sq_ring;
+    } else {
+        _cq_ring = ::mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          _ring_fd, IORING_OFF_CQ_RING);
+        if (_cq_ring == MAP_FAILED) {
+            _cq_ring = nullptr;
+            _release();
+            throw std::runtime_error("Failed to map io_uring CQ ring");
+        }
+    }
+
+    _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = ::mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        _ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        _release();
+        throw std::runtime_error("Failed to map io_uring SQEs");
+    }
+    _sqes = static_cast<io_uring_sqe *>(sqes);
+
+    auto sq = static_cast<char *>(_sq_ring);
+    _sq_head = reinterpret_cast<uint32_t *>(sq + params.sq_off.head);
+    _sq_tail = reinterpret_cast<uint32_t *>(sq + params.sq_off.tail);
+    _sq_mask = reinterpret_cast<uint32_t *>(sq + params.sq_off.ring_mask);
+    _sq_array = reinterpret_cast<uint32_t *>(sq + params.sq_off.array);
+
+    auto cq = static_cast<char *>(_cq_ring);
+    _cq_head = reinterpret_cast<uint32_t *>(cq + params.cq_off.head);
+    _cq_tail = reinterpret_cast<uint32_t *>(cq + params.cq_off.tail);
+    _cq_mask = reinterpret_cast<uint32_t *>(cq + params.cq_off.ring_mask);
+    _cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+IoUring::~IoUring() {
+    _release();
+}
+
+void IoUring::_release() {
+    if (_sqes != nullptr) {
+        ::munmap(_sqes, _sqes_size);
+        _sqes = nullptr;
+    }
+    if (_cq_ring != nullptr && _cq_ring != _sq_ring) {
+        ::munmap(_cq_ring, _cq_ring_size);
+    }
+    _cq_ring = nullptr;
+    if (_sq_ring != nullptr) {
+        ::munmap(_sq_ring, _sq_ring_size);
+        _sq_ring = nullptr;
+    }
+    if (_ring_fd >= 0) {
+        ::close(_ring_fd);
+        _ring_fd = -1;
+    }
+}
+
+uint32_t IoUring::space() const {
+    return _entries - _queued - _in_flight;
+}
+
+io_uring_sqe *IoUring::_get_sqe() {
+    if (space() == 0) {
+        throw std::runtime_error("io_uring submission queue is full");
+    }
+    // 只有本线程会修改tail，head由内核更新
+    uint32_t tail = *_sq_tail + _queued;
+    uint32_t index = tail & *_sq_mask;
+    io_uring_sqe *sqe = &_sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    _sq_array[index] = index;
+    _queued++;
+    return sqe;
+}
+
+void IoUring::prep_readv(const int &fd, const iovec *iov, const uint32_t &count, const uint64_t &offset,
+                         const uint64_t &user_data) {
+    auto sqe = _get_sqe();
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(iov);
+    sqe->len = count;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+}
+
+void IoUring::prep_writev(const int &fd, const iovec *iov, const uint32_t &count, const uint64_t &offset,
+                          const uint64_t &user_data) {
+    auto sqe = _get_sqe();
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(iov);
+    sqe->len = count;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+}
+
+void IoUring::_enter(const uint32_t &min_complete) {
+    while (true) {
+        const uint32_t flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+        int ret = io_uring_enter(_ring_fd, _unsubmitted, min_complete, flags);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("io_uring_enter failed: " + std::string(std::strerror(errno)));
+        }
+        _unsubmitted -= std::min<uint32_t>(_unsubmitted, ret);
+        return;
+    }
+}
+
+void IoUring::submit() {
+    if (_queued == 0) {
+        return;
+    }
+    // 发布新的tail，之后内核才能看到这些请求；进入内核失败时，它们在下一次进入时提交
+    __atomic_store_n(_sq_tail, *_sq_tail + _queued, __ATOMIC_RELEASE);
+    _unsubmitted += _queued;
+    _in_flight += _queued;
+    _queued = 0;
+    _enter(0);
+}
+
+uint32_t IoUring::reap(const CompletionCallback &callback, const bool &wait) {
+    uint32_t head = *_cq_head;
+    uint32_t tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail && _unsubmitted > 0) {
+        _enter(0);
+        tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+    }
+    if (head == tail && wait && _in_flight > 0) {
+        _enter(1);
+        tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+    }
+    uint32_t reaped = 0;
+    while (head != tail) {
+        const io_uring_cqe cqe = _cqes[head & *_cq_mask];
+        // 先归还完成队列的位置，回调中可以再提交新的请求
+        __atomic_store_n(_cq_head, ++head, __ATOMIC_RELEASE);
+        _in_flight--;
+        reaped++;
+        callback(cqe.user_data, cqe.res);
+    }
+    return reaped;
+}
+
+#else
+
+IoUring::IoUring(const uint32_t &) {
+    throw std::runtime_error("io_uring is only available on Linux");
+}
+
+IoUring::~IoUring() = default;
+
+void IoUring::_release() {}
+
+uint32_t IoUring::space() const {
+    return 0;
+}
+
+void IoUring::prep_readv(const int &, const iovec *, const uint32_t &, const uint64_t &, const uint64_t &) {}
+
+void IoUring::prep_writev(const int &, const iovec *, const uint32_t &, const uint64_t &, const uint64_t &) {}
+
+void IoUring::submit() {}
+
+uint32_t IoUring::reap(const CompletionCallback &, const bool &) {
+    return 0;
+}
+
+void IoUring::_enter(const uint32_t &) {}
+
+io_uring_sqe *IoUring::_get_sqe() {
+    return nullptr;
+}
+
+#endif
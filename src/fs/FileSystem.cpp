@@ -4,7 +4,12 @@
 
 #include "fs/FileSystem.hpp"
 
-std::vector<std::string> FileSystem::parse_path(const std::string &path) {
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+template<typename G>
+std::vector<std::string> BasicFileSystem<G>::parse_path(const std::string &path) {
     std::vector<std::string> dirs;
     std::string dir;
     for (char c: path) {
@@ -23,7 +28,8 @@ std::vector<std::string> FileSystem::parse_path(const std::string &path) {
     return dirs;
 }
 
-Inode *FileSystem::get_inode_by_path(const std::string &path) {
+template<typename G>
+Inode *BasicFileSystem<G>::get_inode_by_path(const std::string &path) {
     auto _current_inode_id = current_inode_id;
 
     std::string file = path.substr(path.find_last_of('/') + 1);
@@ -31,8 +37,9 @@ Inode *FileSystem::get_inode_by_path(const std::string &path) {
 
     cd(parent_path);
     auto inode = allocate_memory_inode(current_inode_id);
+    BufferHandle block;
     for (uint32_t i = 0; i < inode->get_directory_num(); i++) {
-        auto dir_entry = get_directory_entry(inode, i);
+        auto dir_entry = get_directory_entry(inode, i, block);
         if (dir_entry->inode_id != 0 && std::string(dir_entry->name) == file) {
             current_inode_id = _current_inode_id;
             return allocate_memory_inode(dir_entry->inode_id);
@@ -43,15 +50,21 @@ Inode *FileSystem::get_inode_by_path(const std::string &path) {
     throw std::runtime_error("File not found: " + path);
 }
 
-void FileSystem::format() {
+template<typename G>
+void BasicFileSystem<G>::format(ImageAllocation allocation) {
+    Guard guard(*this);
     /**
      * 初始化文件系统
      * 1. 磁盘文件清空
      * 2. 初始化磁盘文件的SuperBlock
      * 3. 初始化磁盘根目录
      */
-    disk_manager.format(); // 清空磁盘文件
+    wait_for_writeback();
+    wait_for_reads();
+    disk_manager.format(allocation); // 清空磁盘文件
+    freed_blocks.clear();
     super_block.format();  // 初始化SuperBlock
+    block_allocator.rebuild();
 
     // 清空打开文件表
     for (auto &open_file: open_files) {
@@ -67,27 +80,23 @@ void FileSystem::format() {
     }
 
     // 清除高速缓存
-    buffer_cache_map.clear();
-    device_buffer_cache.clear();
-    free_buffer_cache.clear();
-    for (auto &cache_block: buffer_cache) {
-        cache_block.clear();
-        free_buffer_cache.push_back(&cache_block);
-    }
+    buffer_pool.clear();
+    dirty_blocks = 0;
 
     /*
      * 创建根目录：
      *  1. 分配磁盘Inode节点，位于第1个Inode（2#扇区的第1块）（每个扇区的Inode从0~7，物理上是第二块）
-     *  2. DiskInode要指向一个内存空间，内存空间里面是目录，一个扇区可以存 512/32=16个目录，一开始只占用前两项。
+     *  2. DiskInode要指向一个内存空间，内存空间里面是目录，一个盘块可以存 block_size/32 个目录，一开始只占用前两项。
      */
     DiskInode root_inode;
     root_inode.file_size = sizeof(DirectoryEntry) * 2;
     root_inode.file_type = FileType::DIRECTORY;
-    root_inode.block_pointers[0] = super_block.get_free_block();
+    root_inode.block_pointers[0] = block_allocator.get_free_block();
     // 将DiskInode写入磁盘
-    std::vector<char> root_inode_data(BLOCK_SIZE);
-    std::memcpy(root_inode_data.data() + sizeof(DiskInode), &root_inode, sizeof(DiskInode));
-    disk_manager.write_block(INODE_START_INDEX, root_inode_data);
+    char root_inode_data[G::BLOCK_SIZE]{};
+    auto [root_inode_block, root_inode_num] = inode_id_to_block_no(1);
+    std::memcpy(root_inode_data + sizeof(DiskInode) * root_inode_num, &root_inode, sizeof(DiskInode));
+    disk_manager.write_block(root_inode_block, root_inode_data, 1);
     super_block.inode_bitmap.set(1);
 
     // 初始化根目录
@@ -97,197 +106,435 @@ void FileSystem::format() {
     root_dir[1].inode_id = 1;
     std::strcpy(root_dir[1].name, "..");
     // 将根目录写入磁盘
-    std::vector<char> root_dir_data(BLOCK_SIZE);
-    std::memcpy(root_dir_data.data(), root_dir, sizeof(root_dir));
-    disk_manager.write_block(root_inode.block_pointers[0], root_dir_data);
+    char root_dir_data[G::BLOCK_SIZE]{};
+    std::memcpy(root_dir_data, root_dir, sizeof(root_dir));
+    disk_manager.write_block(root_inode.block_pointers[0], root_dir_data, 1);
 
-    // 把superblock写回磁盘，superblock大小是2个block，可以直接写回
-    std::vector<char> super_block_data(sizeof(SuperBlock));
-    std::memcpy(super_block_data.data(), &super_block, sizeof(super_block));
-    disk_manager.write_block(0, super_block_data);
+    // 把superblock写回磁盘，superblock大小是整数个block，可以直接写回
+    disk_manager.write_block(0, reinterpret_cast<const char *>(&super_block), G::SUPER_BLOCK_BLOCKS);
 
     current_inode_id = 1;
 }
 
-const uint32_t &FileSystem::get_block_pointer(Inode *pInode, uint32_t i) {
-    static const uint32_t PTRS_PER_BLOCK = BLOCK_SIZE / sizeof(uint32_t); // 每个块可以包含的指针数量
+template<typename G>
+uint32_t BasicFileSystem<G>::get_block_pointer(Inode *pInode, uint32_t i) {
+    constexpr uint32_t PTRS_PER_BLOCK = G::PTRS_PER_BLOCK; // 每个块可以包含的指针数量
+    constexpr auto &LEVEL_END = G::INDEX_LEVEL_END;         // 各级索引的分界点
+    constexpr auto &POINTER_BEGIN = G::INDEX_POINTER_BEGIN; // 各级索引在block_pointers中的起始下标
 
     // 5个直接索引，2个一次间接索引，2个二次间接索引和1个三次间接索引。
-    if (i < 5) {
+    if (i < LEVEL_END[0]) {
         // 直接索引
         return pInode->block_pointers[i];
-    } else if (i < 5 + 2 * PTRS_PER_BLOCK) {
+    } else if (i < LEVEL_END[1]) {
         // 一次间接索引
-        uint32_t block_no = pInode->block_pointers[5 + (i - 5) / PTRS_PER_BLOCK];
+        i -= LEVEL_END[0];
+        uint32_t block_no = pInode->block_pointers[POINTER_BEGIN[1] + i / PTRS_PER_BLOCK];
         auto buffer = allocate_buffer_cache(block_no);
-        return *buffer->read<uint32_t>((i - 5) % PTRS_PER_BLOCK);
-    } else if (i < 5 + 2 * PTRS_PER_BLOCK + 2 * PTRS_PER_BLOCK * PTRS_PER_BLOCK) {
+        return *buffer->template read<uint32_t>(i % PTRS_PER_BLOCK);
+    } else if (i < LEVEL_END[2]) {
         // 二次间接索引
-        i -= 5 + 2 * PTRS_PER_BLOCK;
-        uint32_t block_no = pInode->block_pointers[7 + i / (PTRS_PER_BLOCK * PTRS_PER_BLOCK)];
+        i -= LEVEL_END[1];
+        uint32_t block_no = pInode->block_pointers[POINTER_BEGIN[2] + i / (PTRS_PER_BLOCK * PTRS_PER_BLOCK)];
         auto first_level_buffer = allocate_buffer_cache(block_no);
-        block_no = *first_level_buffer->read<uint32_t>((i / PTRS_PER_BLOCK) % PTRS_PER_BLOCK);
+        block_no = *first_level_buffer->template read<uint32_t>((i / PTRS_PER_BLOCK) % PTRS_PER_BLOCK);
         auto second_level_buffer = allocate_buffer_cache(block_no);
-        return *second_level_buffer->read<uint32_t>(i % PTRS_PER_BLOCK);
+        return *second_level_buffer->template read<uint32_t>(i % PTRS_PER_BLOCK);
     } else {
         // 三次间接索引
-        i -= 5 + 2 * PTRS_PER_BLOCK + 2 * PTRS_PER_BLOCK * PTRS_PER_BLOCK;
-        uint32_t block_no = pInode->block_pointers[9];
+        i -= LEVEL_END[2];
+        uint32_t block_no = pInode->block_pointers[POINTER_BEGIN[3]];
         auto first_level_buffer =  allocate_buffer_cache(block_no);
-        block_no = *first_level_buffer->read<uint32_t>((i / (PTRS_PER_BLOCK * PTRS_PER_BLOCK)) % PTRS_PER_BLOCK);
+        block_no = *first_level_buffer->template read<uint32_t>((i / (PTRS_PER_BLOCK * PTRS_PER_BLOCK)) % PTRS_PER_BLOCK);
         auto second_level_buffer = allocate_buffer_cache(block_no);
-        block_no = *second_level_buffer->read<uint32_t>((i / PTRS_PER_BLOCK) % PTRS_PER_BLOCK);
+        block_no = *second_level_buffer->template read<uint32_t>((i / PTRS_PER_BLOCK) % PTRS_PER_BLOCK);
         auto third_level_buffer = allocate_buffer_cache(block_no);
-        return *third_level_buffer->read<uint32_t>(i % PTRS_PER_BLOCK);
+        return *third_level_buffer->template read<uint32_t>(i % PTRS_PER_BLOCK);
     }
 }
 
-const DirectoryEntry *FileSystem::get_directory_entry(Inode *pInode, uint32_t i) {
-    auto block_no = get_block_pointer(pInode, i / 16);
-    if (block_no < BLOCK_START_INDEX) {
+template<typename G>
+const DirectoryEntry *BasicFileSystem<G>::get_directory_entry(Inode *pInode, uint32_t i, BufferHandle &block) {
+    Guard guard(*this);
+    constexpr uint32_t ENTRIES_PER_BLOCK = G::ENTRIES_PER_BLOCK;
+    auto block_no = get_block_pointer(pInode, i / ENTRIES_PER_BLOCK);
+    if (block_no < G::BLOCK_START_INDEX) {
         // 未分配的内存空间
         throw std::runtime_error("Block not allocated: " + std::to_string(block_no));
     }
-    auto buffer = allocate_buffer_cache(block_no);
+    // 句柄已经钉住这个盘块时直接使用，不再查找缓存
+    if (!block || block->block_no != block_no) {
+        block = pin_buffer_cache(block_no);
+    }
     // auto dir_entry = reinterpret_cast<DirectoryEntry *>(buffer->data + sizeof(DirectoryEntry) * (i % 16));
-    auto dir_entry = buffer->read<DirectoryEntry>(i % 16);
+    auto dir_entry = block->template read<DirectoryEntry>(i % ENTRIES_PER_BLOCK);
     return dir_entry;
 }
 
-FileSystem::~FileSystem() {
+template<typename G>
+BasicFileSystem<G>::~BasicFileSystem() {
+    stop_periodic_commit();
+    stop_writeback();
+    // 缓存块释放之前，内核不能还在向它们读入
+    wait_for_reads();
     save();
-
-    // 把缓存块和哈希表释放了
-    buffer_cache_map.clear();
 }
 
-void FileSystem::write_back_inode(Inode *pInode) {
+template<typename G>
+void BasicFileSystem<G>::write_back_inode(Inode *pInode) {
     auto disk_inode = Inode::to_disk_inode(*pInode);
     auto [block_no, _num] = inode_id_to_block_no(pInode->inode_id);
     auto buffer = allocate_buffer_cache(block_no);
     // std::memcpy(buffer->data + sizeof(DiskInode) * _num, &disk_inode, sizeof(DiskInode));
     // buffer->dirty = true;
-    // buffer->write<DiskInode>(&disk_inode, _num);
+    // buffer->template write<DiskInode>(&disk_inode, _num);
     write_buffer(buffer, &disk_inode, _num);
+    pInode->dirty = false;
 }
 
-void FileSystem::alloc_new_block(Inode *inode) {
-    static const uint32_t PTRS_PER_BLOCK = BLOCK_SIZE / sizeof(uint32_t); // 每个块可以包含的指针数量
+template<typename G>
+void BasicFileSystem<G>::alloc_new_block(Inode *inode) {
+    // 根据文件大小，可以算出下一块是第几块，0是第0块，1~B是第1块，B+1~2B是第2块...（B为块大小），要分配的就是下一块
+    alloc_new_blocks(inode, (inode->file_size + G::BLOCK_SIZE - 1) / G::BLOCK_SIZE, 1);
+}
 
+template<typename G>
+uint32_t BasicFileSystem<G>::new_index_blocks(const uint32_t &first, const uint32_t &count) {
+    constexpr uint32_t PTRS_PER_BLOCK = G::PTRS_PER_BLOCK; // 每个块可以包含的指针数量
+    constexpr auto &LEVEL_END = G::INDEX_LEVEL_END;         // 各级索引的分界点
+
+    // 文件块b是某个索引块覆盖的第一块时，写b之前先分配这个索引块
+    uint32_t total = 0;
+    for (uint32_t b = std::max<uint32_t>(first, LEVEL_END[0]); b < first + count; b++) {
+        if (b < LEVEL_END[1]) {
+            total += (b - LEVEL_END[0]) % PTRS_PER_BLOCK == 0;
+        } else if (b < LEVEL_END[2]) {
+            const uint32_t i = b - LEVEL_END[1];
+            total += (i % (PTRS_PER_BLOCK * PTRS_PER_BLOCK) == 0) + (i % PTRS_PER_BLOCK == 0);
+        } else {
+            const uint32_t i = b - LEVEL_END[2];
+            total += (i == 0) + (i % (PTRS_PER_BLOCK * PTRS_PER_BLOCK) == 0) + (i % PTRS_PER_BLOCK == 0);
+        }
+    }
+    return total;
+}
 
-    const uint32_t file_size = inode->file_size;
-    // 根据文件大小，可以算出下一块是第几块，0是第0块，1-512是第1块，513-1024是第2块...，要分配的就是下一块
-    const uint32_t new_block_num = (file_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+template<typename G>
+void BasicFileSystem<G>::alloc_new_blocks(Inode *inode, const uint32_t &first, const uint32_t &count,
+                                          std::vector<uint32_t> *block_nos) {
+    constexpr uint32_t PTRS_PER_BLOCK = G::PTRS_PER_BLOCK; // 每个块可以包含的指针数量
+    constexpr auto &LEVEL_END = G::INDEX_LEVEL_END;         // 各级索引的分界点
+    constexpr auto &POINTER_BEGIN = G::INDEX_POINTER_BEGIN; // 各级索引在block_pointers中的起始下标
 
-    // 0-4
-    if (new_block_num < 5) {
-        inode->block_pointers[new_block_num] = super_block.get_free_block();
+    if (count == 0) {
         return;
     }
+    if ((uint64_t) first + count > LEVEL_END[3]) {
+        throw std::runtime_error("File too large");
+    }
+    const uint32_t end = first + count;
+
+    // 1. 数据块和途中要新建的索引块一次向分配器申请
+    const uint32_t total = count + new_index_blocks(first, count);
+
+    // 2. 一次预留所有盘块，空闲空间不够连续时分成几段，空间不足时全部退还
+    std::vector<std::pair<uint32_t, uint32_t>> runs;
+    try {
+        for (uint32_t reserved = 0; reserved < total;) {
+            runs.push_back(block_allocator.get_free_run(total - reserved));
+            reserved += runs.back().second;
+        }
+    } catch (...) {
+        for (auto [block_no, length]: runs) {
+            block_allocator.free_blocks(block_no, length);
+        }
+        throw;
+    }
+    size_t run_index = 0;
+    uint32_t run_used = 0;
+    auto next_block = [&]() {
+        if (run_used == runs[run_index].second) {
+            run_index++;
+            run_used = 0;
+        }
+        return runs[run_index].first + run_used++;
+    };
+
+    // 这些文件块号将对应新的盘块，缓存中原来的逻辑页作废
+    for (uint32_t b = first; b < end; b++) {
+        buffer_pool.forget_page(inode->inode_id, b);
+    }
+
+    // 3. 按文件顺序填写指针，新建的索引块不从磁盘读取
+    inode->dirty = true;
+    // 取得父索引块第slot项指向的索引块，create为真时先分配它
+    auto child_index_block = [&](BufferHandle &parent, const uint32_t &slot, const bool &create) {
+        if (!create) {
+            return pin_buffer_cache(*parent->template read<uint32_t>(slot));
+        }
+        auto id = next_block();
+        write_buffer(parent.get(), &id, slot);
+        return BufferHandle(buffer_pool, new_buffer_cache(id));
+    };
+    // 取得Inode中的索引指针指向的索引块，create为真时先分配它
+    auto top_index_block = [&](uint32_t &pointer, const bool &create) {
+        if (!create) {
+            return pin_buffer_cache(pointer);
+        }
+        pointer = next_block();
+        return BufferHandle(buffer_pool, new_buffer_cache(pointer));
+    };
+
+    uint32_t b = first;
+    // 0-4，直接索引
+    for (; b < end && b < LEVEL_END[0]; b++) {
+        inode->block_pointers[b] = next_block();
+        if (block_nos != nullptr) {
+            block_nos->push_back(inode->block_pointers[b]);
+        }
+    }
+
+    std::vector<uint32_t> pointers(PTRS_PER_BLOCK);
+    while (b < end) {
+        // 找到b所在的最底层索引块，需要时逐级新建
+        BufferHandle leaf;
+        if (b < LEVEL_END[1]) {
+            // 5-6，一次间接索引
+            const uint32_t i = b - LEVEL_END[0];
+            leaf = top_index_block(inode->block_pointers[POINTER_BEGIN[1] + i / PTRS_PER_BLOCK],
+                                   i % PTRS_PER_BLOCK == 0);
+        } else if (b < LEVEL_END[2]) {
+            // 7-8，二次间接索引
+            const uint32_t i = b - LEVEL_END[1];
+            auto first_level = top_index_block(
+                    inode->block_pointers[POINTER_BEGIN[2] + i / (PTRS_PER_BLOCK * PTRS_PER_BLOCK)],
+                    i % (PTRS_PER_BLOCK * PTRS_PER_BLOCK) == 0);
+            leaf = child_index_block(first_level, i / PTRS_PER_BLOCK % PTRS_PER_BLOCK, i % PTRS_PER_BLOCK == 0);
+        } else {
+            // 9，三次间接索引
+            const uint32_t i = b - LEVEL_END[2];
+            auto first_level = top_index_block(inode->block_pointers[POINTER_BEGIN[3]], i == 0);
+            auto second_level = child_index_block(first_level, i / (PTRS_PER_BLOCK * PTRS_PER_BLOCK) % PTRS_PER_BLOCK,
+                                                  i % (PTRS_PER_BLOCK * PTRS_PER_BLOCK) == 0);
+            leaf = child_index_block(second_level, i / PTRS_PER_BLOCK % PTRS_PER_BLOCK, i % PTRS_PER_BLOCK == 0);
+        }
 
-    // 5-6
-    if (new_block_num < 5 + PTRS_PER_BLOCK * 2) {
-        // 计算出new_block_num是第几个一级索引、第几个数据块
-        uint32_t first_level_index = (new_block_num - 5) / PTRS_PER_BLOCK;
-        uint32_t second_level_index = (new_block_num - 5) % PTRS_PER_BLOCK;
+        // 一次写入这个索引块中属于 [b, end) 的所有指针，各级索引的分界点都是索引块的边界
+        const uint32_t slot = (b - LEVEL_END[b < LEVEL_END[1] ? 0 : b < LEVEL_END[2] ? 1 : 2]) % PTRS_PER_BLOCK;
+        const uint32_t n = std::min(end - b, PTRS_PER_BLOCK - slot);
+        for (uint32_t k = 0; k < n; k++) {
+            pointers[k] = next_block();
+        }
+        if (block_nos != nullptr) {
+            block_nos->insert(block_nos->end(), pointers.begin(), pointers.begin() + n);
+        }
+        write_buffer(leaf.get(), pointers.data(), slot * sizeof(uint32_t), n * sizeof(uint32_t), true);
+        b += n;
+    }
+}
 
+template<typename G>
+uint32_t BasicFileSystem<G>::allocate_for_write(Inode *inode, const uint32_t &offset, const uint32_t &size) {
+    // 已分配或延迟分配的块数，fallocate预先分配的块、前一次写入中途失败时延迟的块可能超出文件大小
+    const uint32_t file_blocks = std::max(allocated_blocks(inode), inode->delayed_first + inode->delayed_blocks);
+    const uint64_t needed = ((uint64_t) offset + size + G::BLOCK_SIZE - 1) / G::BLOCK_SIZE;
+    if (needed > G::INDEX_LEVEL_END[3]) {
+        throw std::runtime_error("File too large");
+    }
+    const uint32_t new_blocks = needed > file_blocks ? needed - file_blocks : 0;
+
+    // 可能绕过缓存的大段写入需要盘块，一次的新块超过硬阈值时延迟也没有意义，都立即分配
+    const uint32_t delay_limit = buffer_pool.capacity() * dirty_hard_percent / 100;
+    const bool direct = direct_io_min_blocks != 0 && size / G::BLOCK_SIZE >= direct_io_min_blocks;
+    if (delay_allocation && !direct && new_blocks <= delay_limit) {
+        if (buffer_pool.delayed_count() + new_blocks > delay_limit) {
+            allocate_delayed_blocks();
+        }
+        delay_new_blocks(inode, file_blocks, new_blocks);
+    } else {
+        allocate_delayed_blocks(inode);
+        alloc_new_blocks(inode, file_blocks, new_blocks);
+    }
+    // 文件末尾之后的块（新分配的、预先分配的盘块或延迟分配的页）原来的内容没有意义，不需要从磁盘读取
+    const uint32_t allocated = (inode->file_size + G::BLOCK_SIZE - 1) / G::BLOCK_SIZE;
+
+    // 文件末尾到写入位置之间补0
+    static const char zeros[G::BLOCK_SIZE]{};
+    for (uint32_t ptr = inode->file_size; ptr < offset;) {
+        const uint32_t block_index = ptr / G::BLOCK_SIZE;
+        auto buffer = allocate_file_block(inode, block_index, block_index >= allocated);
+        uint32_t zero_size = std::min(G::BLOCK_SIZE - ptr % G::BLOCK_SIZE, offset - ptr);
+        write_buffer(buffer, zeros, ptr % G::BLOCK_SIZE, zero_size, true);
+        ptr += zero_size;
+        inode->file_size = ptr;
+        inode->dirty = true;
+    }
+    return allocated;
+}
 
-        if (second_level_index == 0) {
-            inode->block_pointers[5 + first_level_index] = super_block.get_free_block();
-            auto buffer = allocate_buffer_cache(inode->block_pointers[5 + first_level_index]);
-            buffer->clear_data();
+template<typename G>
+void BasicFileSystem<G>::delay_new_blocks(Inode *inode, const uint32_t &first, const uint32_t &count) {
+    if (inode->delayed_blocks == 0) {
+        inode->delayed_first = first;
+    }
+    for (uint32_t b = first; b < first + count; b++) {
+        // 逐块预留并登记，中途失败时已登记的页仍然一致
+        block_allocator.reserve(1 + new_index_blocks(b, 1));
+        BufferCache *cache_block;
+        try {
+            cache_block = take_buffer_cache(0);
+        } catch (...) {
+            block_allocator.unreserve(1 + new_index_blocks(b, 1));
+            throw;
         }
-        auto buffer = allocate_buffer_cache(inode->block_pointers[5 + first_level_index]);
-        auto id = super_block.get_free_block();
-        write_buffer(buffer, &id, second_level_index);
+        cache_block->clear_data();
+        cache_block->set_dirty(true);
+        buffer_pool.insert_delayed(cache_block, inode->inode_id, b);
+        inode->delayed_blocks++;
+    }
+}
+
+template<typename G>
+void BasicFileSystem<G>::allocate_delayed_blocks(Inode *inode) {
+    const uint32_t first = inode->delayed_first, count = inode->delayed_blocks;
+    if (count == 0) {
         return;
     }
+    std::vector<BufferCache *> pages(count);
+    for (uint32_t i = 0; i < count; i++) {
+        pages[i] = buffer_pool.lookup_page(inode->inode_id, first + i);
+        if (pages[i] == nullptr || !pages[i]->is_delayed()) {
+            throw std::logic_error("Delayed page missing: " + std::to_string(first + i));
+        }
+    }
 
-    // 二次间接索引
-    if (new_block_num < 5 + 2 * PTRS_PER_BLOCK + 2 * PTRS_PER_BLOCK * PTRS_PER_BLOCK) {
-        // 计算出new_block_num是第几个一级索引、第几个二级索引、第几个数据块
-        uint32_t first_level_index = (new_block_num - 5 - 2 * PTRS_PER_BLOCK) / (PTRS_PER_BLOCK * PTRS_PER_BLOCK);
-        uint32_t second_level_index = (new_block_num - 5 - 2 * PTRS_PER_BLOCK) / PTRS_PER_BLOCK % PTRS_PER_BLOCK;
-        uint32_t third_level_index = (new_block_num - 5 - 2 * PTRS_PER_BLOCK) % PTRS_PER_BLOCK;
-
-        if (second_level_index == 0 && third_level_index == 0) {
-            inode->block_pointers[7 + first_level_index] = super_block.get_free_block();
-            auto buffer = allocate_buffer_cache(inode->block_pointers[7 + first_level_index]);
-            buffer->clear_data();
-        }
-        auto first_level_buffer = allocate_buffer_cache(inode->block_pointers[7 + first_level_index]);
-        if (third_level_index == 0) {
-            auto id = super_block.get_free_block();
-            write_buffer(first_level_buffer, &id, second_level_index);
-            auto buffer = allocate_buffer_cache(id);
-            buffer->clear_data();
-        }
-        auto second_level_buffer = allocate_buffer_cache(*first_level_buffer->read<uint32_t>(second_level_index));
-        auto id = super_block.get_free_block();
-        write_buffer(second_level_buffer, &id, third_level_index);
+    // 归还预留的块数后立即分配，整个范围一次申请，尽量物理连续
+    block_allocator.unreserve(count + new_index_blocks(first, count));
+    inode->delayed_blocks = 0;
+    inode->delayed_first = 0;
+    std::vector<uint32_t> block_nos;
+    block_nos.reserve(count);
+    alloc_new_blocks(inode, first, count, &block_nos);
+    // 前一次写入中途失败时延迟的块可能超出文件大小，只有这部分记为预先分配的块，之后的分配从它们之后开始；
+    // 普通写入的块都在文件大小之内，不占用fallocate的记录
+    if (first + count > (inode->file_size + G::BLOCK_SIZE - 1) / G::BLOCK_SIZE) {
+        inode->preallocated_blocks = std::max(inode->preallocated_blocks, first + count);
+    }
 
+    // 缓存页登记到新的盘块上，成为普通的脏块；盘块原来的缓存是释放前的旧数据，丢弃
+    for (uint32_t i = 0; i < count; i++) {
+        invalidate_buffer_cache(block_nos[i]);
+        buffer_pool.assign(pages[i], block_nos[i]);
+        buffer_pool.attach_page(pages[i], inode->inode_id, first + i);
+        dirty_blocks++;
+    }
+}
+
+template<typename G>
+void BasicFileSystem<G>::allocate_delayed_blocks(bool only_expired) {
+    if (buffer_pool.delayed_count() == 0) {
         return;
     }
+    const auto expired_before = std::chrono::steady_clock::now() - dirty_expire;
+    for (auto &m_inode: m_inodes) {
+        if (m_inode.delayed_blocks == 0) {
+            continue;
+        }
+        // 延迟的页按文件顺序创建，第一页最早
+        if (only_expired) {
+            auto oldest = buffer_pool.lookup_page(m_inode.inode_id, m_inode.delayed_first);
+            if (oldest != nullptr && oldest->get_dirty_since() > expired_before) {
+                continue;
+            }
+        }
+        allocate_delayed_blocks(&m_inode);
+    }
+}
 
-    if (new_block_num < 5 + 2 * PTRS_PER_BLOCK + 2 * PTRS_PER_BLOCK * PTRS_PER_BLOCK +
-                        PTRS_PER_BLOCK * PTRS_PER_BLOCK * PTRS_PER_BLOCK) {
-        // 计算出new_block_num对应的一级索引、二级索引、三级索引和数据块位置
-        uint32_t first_level_index = (new_block_num - 5 - 2 * PTRS_PER_BLOCK - 2 * PTRS_PER_BLOCK * PTRS_PER_BLOCK) /
-                                     (PTRS_PER_BLOCK * PTRS_PER_BLOCK * PTRS_PER_BLOCK);
-        if (first_level_index > 0) {
-            throw std::runtime_error("File too large");
+template<typename G>
+void BasicFileSystem<G>::discard_delayed_blocks(Inode *inode) {
+    const uint32_t first = inode->delayed_first, count = inode->delayed_blocks;
+    for (uint32_t b = first; b < first + count; b++) {
+        auto cache_block = buffer_pool.lookup_page(inode->inode_id, b);
+        if (cache_block != nullptr && cache_block->is_delayed()) {
+            buffer_pool.discard_delayed(cache_block);
         }
-        uint32_t second_level_index = (new_block_num - 5 - 2 * PTRS_PER_BLOCK - 2 * PTRS_PER_BLOCK * PTRS_PER_BLOCK) /
-                                      (PTRS_PER_BLOCK * PTRS_PER_BLOCK) % PTRS_PER_BLOCK;
-        uint32_t third_level_index = (new_block_num - 5 - 2 * PTRS_PER_BLOCK - 2 * PTRS_PER_BLOCK * PTRS_PER_BLOCK) /
-                                     PTRS_PER_BLOCK % PTRS_PER_BLOCK;
-        uint32_t fourth_level_index = (new_block_num - 5 - 2 * PTRS_PER_BLOCK - 2 * PTRS_PER_BLOCK * PTRS_PER_BLOCK) %
-                                      PTRS_PER_BLOCK;
-
-        // 检查一级索引块是否已分配
-        if (second_level_index == 0 && third_level_index == 0 && fourth_level_index == 0) {
-            inode->block_pointers[9] = super_block.get_free_block();
-            auto buffer = allocate_buffer_cache(inode->block_pointers[9]);
-            buffer->clear_data();
-        }
-        auto first_level_buffer = allocate_buffer_cache(inode->block_pointers[9]);
-
-        // 检查二级索引块是否已分配
-        if (third_level_index == 0 && fourth_level_index == 0) {
-            auto id = super_block.get_free_block();
-            write_buffer(first_level_buffer, &id, second_level_index);
-            auto buffer = allocate_buffer_cache(id);
-            buffer->clear_data();
-        }
-        auto second_level_buffer = allocate_buffer_cache(*first_level_buffer->read<uint32_t>(second_level_index));
-
-        // 检查三级索引块是否已分配
-        if (fourth_level_index == 0) {
-            auto id = super_block.get_free_block();
-            write_buffer(second_level_buffer, &id, third_level_index);
-            auto buffer = allocate_buffer_cache(id);
-            buffer->clear_data();
-        }
-        auto third_level_buffer = allocate_buffer_cache(*second_level_buffer->read<uint32_t>(third_level_index));
-
-        // 在三级索引块中分配数据块
-        auto id = super_block.get_free_block();
-        write_buffer(third_level_buffer, &id, fourth_level_index);
+    }
+    if (count != 0) {
+        block_allocator.unreserve(count + new_index_blocks(first, count));
+    }
+    inode->delayed_blocks = 0;
+    inode->delayed_first = 0;
+}
+
+template<typename G>
+void BasicFileSystem<G>::zero_file_range(Inode *inode, const uint32_t &from, const uint32_t &to) {
+    if (from >= to) {
         return;
     }
+    // 整块从一个对齐的全0缓冲区直接写入，物理相邻的块合并为一次写入
+    const uint32_t chunk_blocks = DIRECT_IO_BOUNCE_BYTES / G::BLOCK_SIZE;
+    std::unique_ptr<char, decltype(&std::free)> buffer(
+            static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, DIRECT_IO_BOUNCE_BYTES)), &std::free);
+    if (!buffer) {
+        throw std::bad_alloc();
+    }
+    std::memset(buffer.get(), 0, DIRECT_IO_BOUNCE_BYTES);
+
+    const uint32_t first_block = from / G::BLOCK_SIZE;
+    const uint32_t end_block = ((uint64_t) to + G::BLOCK_SIZE - 1) / G::BLOCK_SIZE;
+    auto block_no_of = [&](const uint32_t &b) {
+        auto block_no = get_block_pointer(inode, b);
+        if (block_no < G::BLOCK_START_INDEX) {
+            throw std::runtime_error("Block not allocated: " + std::to_string(block_no));
+        }
+        return block_no;
+    };
+
+    // from所在的不完整的块：读出原来的内容（缓存中的可能更新），清零其中的一段，作为第一块一起直接写入
+    const uint32_t head = from % G::BLOCK_SIZE;
+    if (head != 0) {
+        const uint32_t block_no = block_no_of(first_block);
+        wait_for_writeback(block_no);
+        wait_for_read(block_no);
+        auto cache_block = buffer_pool.find(block_no);
+        if (cache_block != nullptr) {
+            std::memcpy(buffer.get(), cache_block->block_data(), G::BLOCK_SIZE);
+        } else {
+            disk_manager.read_block(block_no, 1, buffer.get());
+        }
+        std::memset(buffer.get() + head, 0, std::min(G::BLOCK_SIZE - head, to - from));
+    }
 
-    throw std::runtime_error("File too large");
+    std::vector<uint32_t> block_nos;
+    for (uint32_t b = first_block; b < end_block; b += chunk_blocks) {
+        block_nos.clear();
+        for (uint32_t i = b; i < std::min(b + chunk_blocks, end_block); i++) {
+            auto block_no = block_no_of(i);
+            invalidate_buffer_cache(block_no);
+            block_nos.push_back(block_no);
+        }
+        transfer_direct(true, block_nos, buffer.get());
+        // 之后都是整块的0
+        std::memset(buffer.get(), 0, G::BLOCK_SIZE);
+    }
 }
 
-void FileSystem::free_all_data_block(Inode *inode) {
-    static const uint32_t PTRS_PER_BLOCK = BLOCK_SIZE / sizeof(uint32_t); // 每个块可以包含的指针数量
+template<typename G>
+void BasicFileSystem<G>::free_all_data_block(Inode *inode) {
+    constexpr uint32_t PTRS_PER_BLOCK = G::PTRS_PER_BLOCK; // 每个块可以包含的指针数量
+
+    // 还没有盘块的数据直接丢弃
+    discard_delayed_blocks(inode);
+    // 数据块释放后可能分配给其他文件，这个文件的逻辑页全部作废
+    buffer_pool.forget_inode(inode->inode_id, allocated_blocks(inode));
 
     // Inode 有一个 uint32_t block_pointers[10]
     // 直接索引
     for (int i = 0; i < 5; i++) {
         if (inode->block_pointers[i] != 0) {
             // inode->block_pointers[i] = super_block.get_free_block();
-            super_block.block_bitmap.reset(inode->block_pointers[i] - BLOCK_START_INDEX);
+            free_block(inode->block_pointers[i]);
         } else {
             return;
         }
@@ -298,19 +545,19 @@ void FileSystem::free_all_data_block(Inode *inode) {
         if (inode->block_pointers[i] == 0) {
             return;
         } else {
-            auto buffer = *allocate_buffer_cache(inode->block_pointers[i]);
-            auto ptr = buffer.read<uint32_t>(0);
+            auto buffer = pin_buffer_cache(inode->block_pointers[i]);
+            auto ptr = buffer->template read<uint32_t>(0);
             for (int j = 0; j < PTRS_PER_BLOCK; j++) {
                 if (ptr[j] == 0) {
                     // auto id = super_block.get_free_block();
                     // write_buffer(buffer, &id, j);
-                    super_block.block_bitmap.reset(inode->block_pointers[i] - BLOCK_START_INDEX);
+                    free_block(inode->block_pointers[i]);
                     return;
                 } else {
-                    super_block.block_bitmap.reset(ptr[j] - BLOCK_START_INDEX);
+                    free_block(ptr[j]);
                 }
             }
-            super_block.block_bitmap.reset(inode->block_pointers[i] - BLOCK_START_INDEX);
+            free_block(inode->block_pointers[i]);
         }
     }
 
@@ -320,35 +567,38 @@ void FileSystem::free_all_data_block(Inode *inode) {
             // inode->block_pointers[i] = super_block.get_free_block();
             return;
         }
-        auto first_level_buffer = *allocate_buffer_cache(inode->block_pointers[i]);
-        auto first_level_ptr = first_level_buffer.read<uint32_t>(0);
+        auto first_level_buffer = pin_buffer_cache(inode->block_pointers[i]);
+        auto first_level_ptr = first_level_buffer->template read<uint32_t>(0);
         for (int j = 0; j < PTRS_PER_BLOCK; j++) {
+            if (j % G::PREFETCH_BLOCK_NUM == 0) { // 批量读入接下来的二级索引块
+                prefetch_buffer_cache(first_level_ptr + j, std::min<uint32_t>(G::PREFETCH_BLOCK_NUM, PTRS_PER_BLOCK - j));
+            }
             if (first_level_ptr[j] == 0) { // 如果一级间接索引块中的指针未分配
                 // auto id = super_block.get_free_block();
-                // write_buffer(first_level_buffer, &id, j);
+                // write_buffer(first_level_buffer.get(), &id, j);
                 // auto second_level_buffer = allocate_buffer_cache(first_level_ptr[j]);
                 // auto id2 = super_block.get_free_block();
                 // write_buffer(second_level_buffer, &id2, 0);
-                super_block.block_bitmap.reset(inode->block_pointers[i] - BLOCK_START_INDEX);
+                free_block(inode->block_pointers[i]);
                 return;
             } else {
-                auto second_level_buffer = *allocate_buffer_cache(first_level_ptr[j]);
-                auto second_level_ptr = second_level_buffer.read<uint32_t>(0);
+                auto second_level_buffer = pin_buffer_cache(first_level_ptr[j]);
+                auto second_level_ptr = second_level_buffer->template read<uint32_t>(0);
                 for (int k = 0; k < PTRS_PER_BLOCK; k++) {
                     if (second_level_ptr[k] == 0) { // 如果二级间接索引块中的指针未分配
                         // auto id = super_block.get_free_block();
                         // write_buffer(second_level_buffer, &id, k);
-                        super_block.block_bitmap.reset(first_level_ptr[j] - BLOCK_START_INDEX);
-                        super_block.block_bitmap.reset(inode->block_pointers[i] - BLOCK_START_INDEX);
+                        free_block(first_level_ptr[j]);
+                        free_block(inode->block_pointers[i]);
                         return;
                     } else {
-                        super_block.block_bitmap.reset(second_level_ptr[k] - BLOCK_START_INDEX);
+                        free_block(second_level_ptr[k]);
                     }
                 }
-                super_block.block_bitmap.reset(first_level_ptr[j] - BLOCK_START_INDEX);
+                free_block(first_level_ptr[j]);
             }
         }
-        super_block.block_bitmap.reset(inode->block_pointers[i] - BLOCK_START_INDEX);
+        free_block(inode->block_pointers[i]);
     }
 
     // 三次间接索引
@@ -356,18 +606,24 @@ void FileSystem::free_all_data_block(Inode *inode) {
         // inode->block_pointers[9] = super_block.get_free_block();
         return;
     }
-    auto first_level_buffer = *allocate_buffer_cache(inode->block_pointers[9]);
-    auto first_level_ptr = first_level_buffer.read<uint32_t>(0);
+    auto first_level_buffer = pin_buffer_cache(inode->block_pointers[9]);
+    auto first_level_ptr = first_level_buffer->template read<uint32_t>(0);
     for (int i = 0; i < PTRS_PER_BLOCK; i++) {
+        if (i % G::PREFETCH_BLOCK_NUM == 0) { // 批量读入接下来的二级索引块
+            prefetch_buffer_cache(first_level_ptr + i, std::min<uint32_t>(G::PREFETCH_BLOCK_NUM, PTRS_PER_BLOCK - i));
+        }
         if (first_level_ptr[i] == 0) {
             // auto id = super_block.get_free_block();
-            // write_buffer(first_level_buffer, &id, i);
-            super_block.block_bitmap.reset(inode->block_pointers[9] - BLOCK_START_INDEX);
+            // write_buffer(first_level_buffer.get(), &id, i);
+            free_block(inode->block_pointers[9]);
             return;
         }
-        auto second_level_buffer = *allocate_buffer_cache(first_level_ptr[i]);
-        auto second_level_ptr = second_level_buffer.read<uint32_t>(0);
+        auto second_level_buffer = pin_buffer_cache(first_level_ptr[i]);
+        auto second_level_ptr = second_level_buffer->template read<uint32_t>(0);
         for (int j = 0; j < PTRS_PER_BLOCK; j++) {
+            if (j % G::PREFETCH_BLOCK_NUM == 0) { // 批量读入接下来的三级索引块
+                prefetch_buffer_cache(second_level_ptr + j, std::min<uint32_t>(G::PREFETCH_BLOCK_NUM, PTRS_PER_BLOCK - j));
+            }
             if (second_level_ptr[j] == 0) {
                 // auto id = super_block.get_free_block();
                 // write_buffer(second_level_buffer, &id, j);
@@ -375,50 +631,88 @@ void FileSystem::free_all_data_block(Inode *inode) {
                 // auto id2 = super_block.get_free_block();
                 // write_buffer(third_level_buffer, &id2, 0);
                 // return;
-                super_block.block_bitmap.reset(first_level_ptr[i] - BLOCK_START_INDEX);
-                super_block.block_bitmap.reset(inode->block_pointers[9] - BLOCK_START_INDEX);
+                free_block(first_level_ptr[i]);
+                free_block(inode->block_pointers[9]);
                 return;
             } else {
-                auto third_level_buffer = *allocate_buffer_cache(second_level_ptr[j]);
-                auto third_level_ptr = third_level_buffer.read<uint32_t>(0);
+                auto third_level_buffer = pin_buffer_cache(second_level_ptr[j]);
+                auto third_level_ptr = third_level_buffer->template read<uint32_t>(0);
                 for (int k = 0; k < PTRS_PER_BLOCK; k++) {
                     if (third_level_ptr[k] == 0) {
                         // auto id = super_block.get_free_block();
                         // write_buffer(third_level_buffer, &id, k);
-                        super_block.block_bitmap.reset(first_level_ptr[i] - BLOCK_START_INDEX);
-                        super_block.block_bitmap.reset(second_level_ptr[j] - BLOCK_START_INDEX);
-                        super_block.block_bitmap.reset(inode->block_pointers[9] - BLOCK_START_INDEX);
+                        free_block(first_level_ptr[i]);
+                        free_block(second_level_ptr[j]);
+                        free_block(inode->block_pointers[9]);
                         return;
                     } else {
-                        super_block.block_bitmap.reset(third_level_ptr[k] - BLOCK_START_INDEX);
+                        free_block(third_level_ptr[k]);
                     }
                 }
-                super_block.block_bitmap.reset(second_level_ptr[j] - BLOCK_START_INDEX);
+                free_block(second_level_ptr[j]);
             }
         }
-        super_block.block_bitmap.reset(first_level_ptr[i] - BLOCK_START_INDEX);
+        free_block(first_level_ptr[i]);
     }
-    super_block.block_bitmap.reset(inode->block_pointers[9] - BLOCK_START_INDEX);
+    free_block(inode->block_pointers[9]);
 }
 
-void FileSystem::write_back_cache_block(BufferCache *pCache) {
-    auto p_start = pCache->read<char>(0);
-    std::vector<char> data = std::vector<char>(p_start, p_start + BLOCK_SIZE);
-    disk_manager.write_block(pCache->block_no, data);
-    pCache->set_dirty(false);
+template<typename G>
+void BasicFileSystem<G>::free_block(const uint32_t &block_no) {
+    block_allocator.free_block(block_no);
+    freed_blocks.push_back(block_no);
 }
 
-void FileSystem::set_directory_entry(Inode *pInode, uint32_t num, uint32_t id, const std::string &basicString) {
-    auto block_no = get_block_pointer(pInode, num / 16);
-    if (block_no < BLOCK_START_INDEX) {
+template<typename G>
+void BasicFileSystem<G>::discard_freed_blocks() {
+    if (freed_blocks.empty()) {
+        return;
+    }
+    auto blocks = std::move(freed_blocks);
+    freed_blocks.clear();
+    wait_for_writeback();
+    std::sort(blocks.begin(), blocks.end());
+    blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+
+    // 把连续的空闲盘块合并为一次打洞
+    uint32_t run_start = 0, run_length = 0;
+    for (auto block_no: blocks) {
+        // 释放后又被重新分配的盘块已经存有新数据，不能打洞
+        if (super_block.check_block_bit(block_no)) {
+            continue;
+        }
+        // 缓存中这个盘块的数据已经没有意义，不再写回
+        auto cache_block = buffer_pool.find(block_no);
+        if (cache_block != nullptr) {
+            mark_clean(cache_block);
+        }
+        if (run_length > 0 && run_start + run_length == block_no) {
+            run_length++;
+            continue;
+        }
+        disk_manager.discard(run_start, run_length);
+        run_start = block_no;
+        run_length = 1;
+    }
+    disk_manager.discard(run_start, run_length);
+}
+
+template<typename G>
+void BasicFileSystem<G>::set_directory_entry(Inode *pInode, uint32_t num, uint32_t id, const std::string &basicString) {
+    Guard guard(*this);
+    constexpr uint32_t ENTRIES_PER_BLOCK = G::ENTRIES_PER_BLOCK;
+    auto block_no = get_block_pointer(pInode, num / ENTRIES_PER_BLOCK);
+    if (block_no < G::BLOCK_START_INDEX) {
         throw std::runtime_error("Block not allocated: " + std::to_string(block_no));
     }
     auto buffer = allocate_buffer_cache(block_no);
     DirectoryEntry entry(id, basicString.c_str());
-    write_buffer(buffer, &entry, num % 16);
+    write_buffer(buffer, &entry, num % ENTRIES_PER_BLOCK);
 }
 
-std::string FileSystem::get_current_dir() {
+template<typename G>
+std::string BasicFileSystem<G>::get_current_dir() {
+    Guard guard(*this);
     std::string current_path = pwd();
     // 解析路径最后一个 / 后的内容
     if (current_path == "/") {
@@ -431,81 +725,109 @@ std::string FileSystem::get_current_dir() {
     return current_path.substr(pos + 1);
 }
 
-std::vector<std::string> FileSystem::ls() {
+template<typename G>
+std::vector<std::string> BasicFileSystem<G>::ls() {
+    Guard guard(*this);
     auto inode = allocate_memory_inode(current_inode_id);
     std::vector<std::string> entries;
+    BufferHandle block;
     for (uint32_t i = 0; i < inode->get_directory_num(); i++) {
-        auto dir_entry = get_directory_entry(inode, i);
+        auto dir_entry = get_directory_entry(inode, i, block);
         if (dir_entry->inode_id != 0)
             entries.emplace_back(dir_entry->name);
     }
     return entries;
 }
 
-void FileSystem::mkdir(const std::string &dir_name) {
-    // 目录名最长28字节
-    if (dir_name.size() > 28) {
-        throw std::runtime_error("Directory name too long: " + dir_name);
-    }
-
-    auto dir_inode = allocate_memory_inode(current_inode_id);
-    auto entries = ls();
-    // if (std::find(entries.begin(), entries.end(), dir_name) != entries.end()) {
-    //     throw std::runtime_error("Directory already exists: " + dir_name);
-    // }
-    for (const auto &entry: entries) {
-        if (entry == dir_name) {
-            throw std::runtime_error("Directory already exists: " + dir_name);
+template<typename G>
+void BasicFileSystem<G>::mkdir(const std::string &dir_name) {
+    bool outermost;
+    {
+        Guard guard(*this);
+        outermost = guard.outermost();
+        // 目录名最长28字节
+        if (dir_name.size() > 28) {
+            throw std::runtime_error("Directory name too long: " + dir_name);
         }
-    }
 
-    // 创建新的目录文件
-    auto new_dir_inode = allocate_memory_inode(super_block.get_free_inode());
-    new_dir_inode->file_type = FileType::DIRECTORY;
-    new_dir_inode->file_size = 2 * sizeof(DirectoryEntry);
-    new_dir_inode->block_pointers[0] = super_block.get_free_block();
-
-
-    // 更新当前目录
-    auto buffer = allocate_buffer_cache(new_dir_inode->block_pointers[0]);
-    DirectoryEntry entry1(new_dir_inode->inode_id, ".");
-    DirectoryEntry entry2(dir_inode->inode_id, "..");
-    write_buffer(buffer, &entry1, 0);
-    write_buffer(buffer, &entry2, 1);
+        auto dir_inode = allocate_memory_inode(current_inode_id);
+        auto entries = ls();
+        // if (std::find(entries.begin(), entries.end(), dir_name) != entries.end()) {
+        //     throw std::runtime_error("Directory already exists: " + dir_name);
+        // }
+        for (const auto &entry: entries) {
+            if (entry == dir_name) {
+                throw std::runtime_error("Directory already exists: " + dir_name);
+            }
+        }
 
-    /*
-     * 更新父目录
-     * 首先找有没有被删除的文件, 他的inode_id = 0，这个位置可以放子目录
-     * 如果找不到，在后面开辟一项
-     */
-    for (uint32_t i = 0; i < dir_inode->get_directory_num(); i++) {
-        auto entry = get_directory_entry(dir_inode, i);
-        if (entry->inode_id == 0) {
-            set_directory_entry(dir_inode, i, new_dir_inode->inode_id, dir_name);
-            return;
+        // 创建新的目录文件
+        // 编号可能属于已删除的文件，整个Inode重新初始化
+        const uint32_t new_inode_id = super_block.get_free_inode();
+        auto new_dir_inode = allocate_memory_inode(new_inode_id);
+        new_dir_inode->clear();
+        new_dir_inode->inode_id = new_inode_id;
+        new_dir_inode->file_type = FileType::DIRECTORY;
+        new_dir_inode->file_size = 2 * sizeof(DirectoryEntry);
+        new_dir_inode->block_pointers[0] = block_allocator.get_free_block();
+        new_dir_inode->dirty = true;
+
+
+        // 更新当前目录
+        auto buffer = allocate_buffer_cache(new_dir_inode->block_pointers[0]);
+        DirectoryEntry entry1(new_dir_inode->inode_id, ".");
+        DirectoryEntry entry2(dir_inode->inode_id, "..");
+        write_buffer(buffer, &entry1, 0);
+        write_buffer(buffer, &entry2, 1);
+
+        /*
+         * 更新父目录
+         * 首先找有没有被删除的文件, 他的inode_id = 0，这个位置可以放子目录
+         * 如果找不到，在后面开辟一项
+         */
+        BufferHandle block;
+        bool placed = false;
+        for (uint32_t i = 0; i < dir_inode->get_directory_num(); i++) {
+            auto entry = get_directory_entry(dir_inode, i, block);
+            if (entry->inode_id == 0) {
+                set_directory_entry(dir_inode, i, new_dir_inode->inode_id, dir_name);
+                placed = true;
+                break;
+            }
+        }
+        if (!placed) {
+            // 需要开辟新的内存空间
+            /*
+             * 分两种情况：1.当前盘块还没满，直接在后面添加
+             * 2. 当前盘块已经满了，增加一块，再添加在这个新的块里
+             */
+            if (dir_inode->get_directory_num() % G::ENTRIES_PER_BLOCK == 0) {
+                alloc_new_block(dir_inode);
+            }
+            set_directory_entry(dir_inode, dir_inode->get_directory_num(), new_dir_inode->inode_id, dir_name);
+            dir_inode->file_size += sizeof(DirectoryEntry);
+            dir_inode->dirty = true;
         }
+        operation_done();
     }
-    // 需要开辟新的内存空间
-    /*
-     * 分两种情况：1.当前盘块还没满，直接在后面添加
-     * 2. 当前盘块已经满了，增加一块，再添加在这个新的块里
-     */
-    if (dir_inode->get_directory_num() % 16 == 0) {
-        alloc_new_block(dir_inode);
+    // 释放锁之后等待这次修改的提交持久化，嵌套在其他public方法中时由最外层等待
+    if (outermost) {
+        sync_commits();
     }
-    set_directory_entry(dir_inode, dir_inode->get_directory_num(), new_dir_inode->inode_id, dir_name);
-    dir_inode->file_size += sizeof(DirectoryEntry);
 }
 
-std::string FileSystem::pwd() {
+template<typename G>
+std::string BasicFileSystem<G>::pwd() {
+    Guard guard(*this);
     // 从当前目录开始，一直通过 .. 找到父目录，直到到根目录
     std::string path;
     auto inode = allocate_memory_inode(current_inode_id);
 
     while (inode->inode_id != 1) {
         auto parent_inode = allocate_memory_inode(get_parent_inode_id(inode));
+        BufferHandle block;
         for (uint32_t i = 0; i < parent_inode->get_directory_num(); i++) {
-            auto dir_entry = get_directory_entry(parent_inode, i);
+            auto dir_entry = get_directory_entry(parent_inode, i, block);
             if (dir_entry->inode_id == inode->inode_id) {
                 std::stringstream ss;
                 ss << "/" << dir_entry->name << path;
@@ -522,39 +844,49 @@ std::string FileSystem::pwd() {
     return path;
 }
 
-void FileSystem::read_from_disk_to_cache(const uint32_t &block_no, BufferCache *cache_block) {
-    auto data = disk_manager.read_block(block_no, 1);
+template<typename G>
+void BasicFileSystem<G>::read_from_disk_to_cache(const uint32_t &block_no, BufferCache *cache_block) {
+    wait_for_writeback(block_no);
+    disk_manager.read_block(block_no, 1, cache_block->block_data());
     cache_block->block_no = block_no;
-    (void) cache_block->write<char>(data.data(), 0, data.size());
+    mark_clean(cache_block);
 }
 
-void FileSystem::write_cache_to_disk(BufferCache *cache_block) {
-    auto ptr = cache_block->read<char>(0);
-    auto data = std::vector<char>(ptr, ptr + BLOCK_SIZE);
+template<typename G>
+void BasicFileSystem<G>::write_cache_to_disk(BufferCache *cache_block) {
+    // 返回缓存中盘块号为block_no的脏块，不存在或不脏时返回nullptr
+    auto dirty_cache = [this](const uint32_t &block_no) -> BufferCache * {
+        auto cache_block = buffer_pool.find(block_no);
+        if (cache_block == nullptr || !cache_block->is_dirty()) {
+            return nullptr;
+        }
+        return cache_block;
+    };
 
-    disk_manager.write_block(cache_block->block_no, data);
-    cache_block->set_dirty(false);
+    // 向前、向后收集物理相邻的脏块，由DiskManager合并为一次写入
+    std::vector<BufferCache *> run{cache_block};
+    for (uint32_t block_no = cache_block->block_no - 1; block_no >= G::INODE_START_INDEX; block_no--) {
+        auto neighbour = dirty_cache(block_no);
+        if (neighbour == nullptr) break;
+        run.push_back(neighbour);
+    }
+    for (uint32_t block_no = cache_block->block_no + 1; ; block_no++) {
+        auto neighbour = dirty_cache(block_no);
+        if (neighbour == nullptr) break;
+        run.push_back(neighbour);
+    }
 
-    // if (std::find(device_buffer_cache.begin(), device_buffer_cache.end(), cache_block) != device_buffer_cache.end()) {
-    //     device_buffer_cache.remove(cache_block);
-    //     device_buffer_cache.push_front(cache_block);
-    // }
-    // for (auto it = device_buffer_cache.begin(); it != device_buffer_cache.end(); it++) {
-    //     if (*it == cache_block) {
-    //         device_buffer_cache.erase(it);
-    //         device_buffer_cache.push_front(cache_block);
-    //         break;
-    //     }
-    // }
-    // if (buffer_cache_map.find(cache_block->block_no) != buffer_cache_map.end()) {
-    //     auto it = *buffer_cache_map[cache_block->block_no];
-    //     device_buffer_cache.erase(buffer_cache_map[cache_block->block_no]);
-    //     device_buffer_cache.push_front(it);
-    //     buffer_cache_map[cache_block->block_no] = device_buffer_cache.begin();
-    // }
+    for (auto block: run) {
+        // 后台线程可能正在写这个块的旧内容，等它写完再写新内容
+        wait_for_writeback(block->block_no);
+        disk_manager.queue_write(block->block_no, block->block_data(), 1);
+        mark_clean(block);
+    }
+    disk_manager.submit();
 }
 
-Inode *FileSystem::allocate_memory_inode(const uint32_t &inode_id) {
+template<typename G>
+Inode *BasicFileSystem<G>::allocate_memory_inode(const uint32_t &inode_id) {
     // 如果inode_id对应的Inode已经在内存Inode中了，直接返回
     for (auto &m_inode: m_inodes) {
         if (m_inode.inode_id == inode_id) {
@@ -574,78 +906,616 @@ Inode *FileSystem::allocate_memory_inode(const uint32_t &inode_id) {
         // 从高速缓存块中读取相应的数据，写进来
         auto [block_no, _num] = inode_id_to_block_no(inode_id);
         auto buffer = allocate_buffer_cache(block_no);
-        DiskInode disk_inode = *buffer->read<DiskInode>(_num);
+        DiskInode disk_inode = *buffer->template read<DiskInode>(_num);
         *m_inode = Inode::to_inode(disk_inode, inode_id);
         return m_inode;
     }
 
     auto m_inode = device_m_inodes.front();
     device_m_inodes.pop_front();
-    // 将这个被换出的m_inode写入对应的缓存块
-    {
-        auto [block_no, _num] = inode_id_to_block_no(m_inode->inode_id);
-        auto buffer = allocate_buffer_cache(block_no);
-        DiskInode disk_inode = Inode::to_disk_inode(*m_inode);
-        write_buffer(buffer, &disk_inode, _num);
+    // 有修改的m_inode被换出时写入对应的缓存块，延迟分配的块先分配盘块
+    allocate_delayed_blocks(m_inode);
+    if (m_inode->dirty) {
+        write_back_inode(m_inode);
     }
     // 从高速缓存块中读取相应的数据，写进来
     auto [block_no, _num] = inode_id_to_block_no(inode_id);
     auto buffer = allocate_buffer_cache(block_no);
-    DiskInode disk_inode = *buffer->read<DiskInode>(_num);
+    DiskInode disk_inode = *buffer->template read<DiskInode>(_num);
     *m_inode = Inode::to_inode(disk_inode, inode_id);
     device_m_inodes.push_back(m_inode);
     return m_inode;
 }
 
-BufferCache *FileSystem::allocate_buffer_cache(const uint32_t &block_no) {
-    // 如果盘块号已经在高速缓存中，直接返回
-    if (buffer_cache_map.find(block_no) != buffer_cache_map.end()) {
-        auto cache_block = *buffer_cache_map[block_no];
-        auto it = buffer_cache_map[block_no];
-        // 将这个块插回队列的末尾
-        device_buffer_cache.erase(it);
-        device_buffer_cache.push_back(cache_block);
-        buffer_cache_map[block_no] = --device_buffer_cache.end();
+template<typename G>
+typename BasicFileSystem<G>::BufferCache *BasicFileSystem<G>::allocate_buffer_cache(const uint32_t &block_no) {
+    // 如果盘块号已经在高速缓存中，移到LRU队尾后直接返回；正在预读的块等它读完
+    wait_for_read(block_no);
+    auto cache_block = buffer_pool.lookup(block_no);
+    if (cache_block != nullptr) {
         return cache_block;
     }
-    // for (auto &cache_block: buffer_cache) {
-    //     if (cache_block.block_no == block_no) {
-    //         // 将这个块插回队列的末尾
-    //         device_buffer_cache.remove(&cache_block);
-    //         device_buffer_cache.push_back(&cache_block);
-    //         return &cache_block;
-    //     }
-    // }
-
-    // 如果有空闲缓存块，直接分配
-    if (!free_buffer_cache.empty()) {
-        auto cache_block = free_buffer_cache.front();
-        free_buffer_cache.pop_front();
 
-        device_buffer_cache.push_back(cache_block);
-        buffer_cache_map[block_no] = --device_buffer_cache.end();
+    cache_block = take_buffer_cache(block_no);
+    try {
         read_from_disk_to_cache(block_no, cache_block);
+    } catch (...) {
+        // 读取失败的缓存块放回空闲链表
+        buffer_pool.release(cache_block);
+        throw;
+    }
+    buffer_pool.insert(cache_block, block_no);
+    return cache_block;
+}
+
+template<typename G>
+typename BasicFileSystem<G>::BufferHandle BasicFileSystem<G>::pin_buffer_cache(const uint32_t &block_no) {
+    return BufferHandle(buffer_pool, allocate_buffer_cache(block_no));
+}
+
+template<typename G>
+typename BasicFileSystem<G>::BufferCache *BasicFileSystem<G>::new_buffer_cache(const uint32_t &block_no) {
+    // 释放前发起的预读不能在清零之后才写入
+    wait_for_read(block_no);
+    auto cache_block = buffer_pool.lookup(block_no);
+    if (cache_block == nullptr) {
+        cache_block = take_buffer_cache(block_no);
+        buffer_pool.insert(cache_block, block_no);
+    }
+    cache_block->clear_data();
+    return cache_block;
+}
 
+template<typename G>
+typename BasicFileSystem<G>::BufferCache *BasicFileSystem<G>::allocate_file_block(Inode *inode,
+                                                                                 const uint32_t &block_index,
+                                                                                 const bool &fresh) {
+    auto cache_block = buffer_pool.lookup_page(inode->inode_id, block_index);
+    if (cache_block != nullptr) {
         return cache_block;
     }
+    auto block_no = get_block_pointer(inode, block_index);
+    if (block_no < G::BLOCK_START_INDEX) {
+        throw std::runtime_error("Block not allocated: " + std::to_string(block_no));
+    }
+    cache_block = fresh ? new_buffer_cache(block_no) : allocate_buffer_cache(block_no);
+    buffer_pool.attach_page(cache_block, inode->inode_id, block_index);
+    return cache_block;
+}
 
-    // 如果没有空闲缓存块，需要替换
-    auto cache_block = device_buffer_cache.front();
-    buffer_cache_map.erase(cache_block->block_no);
-    device_buffer_cache.pop_front();
+template<typename G>
+typename BasicFileSystem<G>::BufferCache *BasicFileSystem<G>::take_buffer_cache(const uint32_t &block_no) {
+    auto cache_block = buffer_pool.take(block_no);
     if (cache_block->is_dirty()) {
         write_cache_to_disk(cache_block);
     }
-    read_from_disk_to_cache(block_no, cache_block);
-    device_buffer_cache.push_back(cache_block);
-    buffer_cache_map[block_no] = --device_buffer_cache.end();
     return cache_block;
 }
 
-FileSystem::FileSystem() : disk_manager(DISK_PATH, DISK_SIZE), open_files() {
+template<typename G>
+void BasicFileSystem<G>::prefetch_buffer_cache(const uint32_t *block_nos, const uint32_t &count,
+                                               const bool &async) {
+    // 1. 为缺失的盘块取得缓存块，被换出的脏块先写回
+    // 装入的块不能多到把本批次刚装入的块又换出去
+    // 被钉住的块不能换出，不计入可用容量
+    const uint32_t max_loads = std::max<uint32_t>(1, (buffer_pool.capacity() - buffer_pool.pinned_count()) / 2);
+    std::vector<BufferCache *> loads;
+    for (uint32_t i = 0; i < count && loads.size() < max_loads; i++) {
+        auto block_no = block_nos[i];
+        if (block_no < G::BLOCK_START_INDEX || buffer_pool.find(block_no) != nullptr) {
+            continue;
+        }
+        auto cache_block = take_buffer_cache(block_no);
+        buffer_pool.insert(cache_block, block_no);
+        loads.push_back(cache_block);
+    }
+    if (loads.empty()) {
+        return;
+    }
+
+    // 2. 一次提交所有读请求，完成后数据直接位于缓存块中
+    uint64_t batch;
+    try {
+        for (auto cache_block: loads) {
+            wait_for_writeback(cache_block->block_no);
+            disk_manager.queue_read(cache_block->block_no, 1, cache_block->block_data());
+        }
+        if (!async) {
+            disk_manager.submit();
+            return;
+        }
+        batch = disk_manager.submit_async();
+    } catch (...) {
+        // 读取失败的缓存块不能留在哈希表中
+        for (auto cache_block: loads) {
+            buffer_pool.erase(cache_block);
+        }
+        throw;
+    }
+    // 3. 异步时钉住这些缓存块，读完之前不会被换出或使用
+    for (auto cache_block: loads) {
+        buffer_pool.pin(cache_block);
+        reads_in_flight[cache_block->block_no] = batch;
+    }
+    read_batches[batch] = std::move(loads);
+}
+
+template<typename G>
+void BasicFileSystem<G>::finish_read_batch(const uint64_t &batch) {
+    auto it = read_batches.find(batch);
+    bool failed = false;
+    try {
+        disk_manager.wait(batch);
+    } catch (const std::runtime_error &) {
+        failed = true;
+    }
+    for (auto cache_block: it->second) {
+        reads_in_flight.erase(cache_block->block_no);
+        buffer_pool.unpin(cache_block);
+        if (failed) {
+            buffer_pool.erase(cache_block);
+        }
+    }
+    read_batches.erase(it);
+}
+
+template<typename G>
+void BasicFileSystem<G>::reap_reads() {
+    if (read_batches.empty()) {
+        return;
+    }
+    disk_manager.poll();
+    std::vector<uint64_t> finished;
+    for (const auto &[batch, blocks]: read_batches) {
+        if (disk_manager.is_complete(batch)) {
+            finished.push_back(batch);
+        }
+    }
+    for (auto batch: finished) {
+        finish_read_batch(batch);
+    }
+}
+
+template<typename G>
+void BasicFileSystem<G>::wait_for_read(const uint32_t &block_no) {
+    if (reads_in_flight.empty()) {
+        return;
+    }
+    auto it = reads_in_flight.find(block_no);
+    if (it != reads_in_flight.end()) {
+        finish_read_batch(it->second);
+    }
+}
+
+template<typename G>
+void BasicFileSystem<G>::wait_for_reads() {
+    while (!read_batches.empty()) {
+        finish_read_batch(read_batches.begin()->first);
+    }
+}
+
+template<typename G>
+void BasicFileSystem<G>::readahead(File &file, Inode *inode, const uint32_t &block_index) {
+    // 之前窗口中已经读完的块放开，可以被换出
+    reap_reads();
+    if (block_index + 1 == file.readahead_next) {
+        // 仍在读上一次的块
+        return;
+    }
+    if (block_index != file.readahead_next) {
+        // 跳读，重新开始检测
+        file.readahead_next = block_index + 1;
+        file.readahead_window = 0;
+        file.readahead_end = 0;
+        return;
+    }
+    file.readahead_next = block_index + 1;
+
+    // 窗口不超过缓存的1/4，预读的块在被读到之前不会被换出
+    const uint32_t max_window = std::max<uint32_t>(
+            1, std::min<uint32_t>(G::READAHEAD_MAX_BLOCKS, buffer_pool.capacity() / 4));
+    if (file.readahead_window == 0) {
+        file.readahead_window = std::min(G::PREFETCH_BLOCK_NUM, max_window);
+        file.readahead_end = block_index;
+    }
+    // 还没有读到上一个窗口的中点
+    if (block_index + file.readahead_window / 2 < file.readahead_end) {
+        return;
+    }
+
+    // 延迟分配的块一直在缓存中，只预读有盘块的部分
+    const uint32_t file_blocks = allocated_blocks(inode);
+    const uint32_t start = std::max(file.readahead_end, block_index);
+    const uint32_t end = std::min(file_blocks, start + file.readahead_window);
+    if (start < end) {
+        std::vector<uint32_t> block_nos;
+        block_nos.reserve(end - start);
+        for (uint32_t i = start; i < end; i++) {
+            block_nos.push_back(get_block_pointer(inode, i));
+        }
+        prefetch_buffer_cache(block_nos.data(), block_nos.size(), true);
+    }
+    file.readahead_end = std::max(end, start);
+    file.readahead_window = std::min(file.readahead_window * 2, max_window);
+}
+
+template<typename G>
+uint32_t BasicFileSystem<G>::direct_io_blocks(const uint32_t &ptr, const uint32_t &remaining) const {
+    if (direct_io_min_blocks == 0 || ptr % G::BLOCK_SIZE != 0) {
+        return 0;
+    }
+    uint32_t blocks = remaining / G::BLOCK_SIZE;
+    return blocks >= direct_io_min_blocks ? blocks : 0;
+}
+
+template<typename G>
+void BasicFileSystem<G>::direct_read(Inode *inode, const uint32_t &ptr, char *data, const uint32_t &block_num) {
+    // 延迟分配的块没有盘块，从缓存页中复制
+    const uint32_t first = ptr / G::BLOCK_SIZE;
+    const uint32_t on_disk = std::min(block_num, std::max(allocated_blocks(inode), first) - first);
+    for (uint32_t i = on_disk; i < block_num; i++) {
+        auto page = buffer_pool.lookup_page(inode->inode_id, first + i);
+        if (page == nullptr) {
+            throw std::runtime_error("Block not allocated: " + std::to_string(first + i));
+        }
+        std::memcpy(data + (size_t) i * G::BLOCK_SIZE, page->block_data(), G::BLOCK_SIZE);
+    }
+
+    std::vector<uint32_t> block_nos;
+    block_nos.reserve(on_disk);
+    for (uint32_t i = 0; i < on_disk; i++) {
+        auto block_no = get_block_pointer(inode, ptr / G::BLOCK_SIZE + i);
+        if (block_no < G::BLOCK_START_INDEX) {
+            throw std::runtime_error("Block not allocated: " + std::to_string(block_no));
+        }
+        // 正在被后台线程写回的块，等它写到磁盘上再读
+        wait_for_writeback(block_no);
+        block_nos.push_back(block_no);
+    }
+    transfer_direct(false, block_nos, data);
+
+    // 缓存中的块可能是尚未写回的脏块，以缓存为准
+    for (uint32_t i = 0; i < on_disk; i++) {
+        wait_for_read(block_nos[i]);
+        auto cache_block = buffer_pool.find(block_nos[i]);
+        if (cache_block != nullptr) {
+            std::memcpy(data + (size_t) i * G::BLOCK_SIZE, cache_block->block_data(), G::BLOCK_SIZE);
+        }
+    }
+}
+
+template<typename G>
+void BasicFileSystem<G>::direct_write(Inode *inode, const uint32_t &ptr, const char *data, const uint32_t &block_num) {
+    std::vector<uint32_t> block_nos;
+    block_nos.reserve(block_num);
+    for (uint32_t i = 0; i < block_num; i++) {
+        const uint32_t block_index = ptr / G::BLOCK_SIZE + i;
+        auto block_no = get_block_pointer(inode, block_index);
+        invalidate_buffer_cache(block_no);
+        block_nos.push_back(block_no);
+    }
+    transfer_direct(true, block_nos, const_cast<char *>(data));
+    // 写入成功之后才扩展文件，失败时文件不会包含没有写入的旧数据
+    inode->file_size = std::max(inode->file_size, (ptr / G::BLOCK_SIZE + block_num) * G::BLOCK_SIZE);
+    inode->dirty = true;
+}
+
+template<typename G>
+void BasicFileSystem<G>::transfer_direct(bool write, const std::vector<uint32_t> &block_nos, char *data) {
+    const bool aligned = reinterpret_cast<uintptr_t>(data) % DIRECT_IO_ALIGNMENT == 0;
+    std::unique_ptr<char, decltype(&std::free)> bounce(nullptr, &std::free);
+    if (!aligned) {
+        bounce.reset(static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, DIRECT_IO_BOUNCE_BYTES)));
+        if (!bounce) {
+            throw std::bad_alloc();
+        }
+    }
+    // 经过中转缓冲区时，一次最多传输缓冲区大小
+    const uint32_t max_run = aligned ? UINT32_MAX : DIRECT_IO_BOUNCE_BYTES / G::BLOCK_SIZE;
+
+    size_t i = 0;
+    while (i < block_nos.size()) {
+        size_t j = i + 1;
+        while (j < block_nos.size() && block_nos[j] == block_nos[j - 1] + 1 && j - i < max_run) {
+            j++;
+        }
+        auto count = static_cast<uint32_t>(j - i);
+        char *user = data + i * G::BLOCK_SIZE;
+        const size_t length = (size_t) count * G::BLOCK_SIZE;
+        if (write) {
+            if (aligned) {
+                disk_manager.write_direct(block_nos[i], user, count);
+            } else {
+                std::memcpy(bounce.get(), user, length);
+                disk_manager.write_direct(block_nos[i], bounce.get(), count);
+            }
+        } else {
+            if (aligned) {
+                disk_manager.read_direct(block_nos[i], count, user);
+            } else {
+                disk_manager.read_direct(block_nos[i], count, bounce.get());
+                std::memcpy(user, bounce.get(), length);
+            }
+        }
+        i = j;
+    }
+}
+
+template<typename G>
+void BasicFileSystem<G>::invalidate_buffer_cache(const uint32_t &block_no) {
+    // 后台线程正在写这个块时，等它写完，否则旧数据可能在直接写入之后才落盘
+    wait_for_writeback(block_no);
+    wait_for_read(block_no);
+    auto cache_block = buffer_pool.find(block_no);
+    if (cache_block != nullptr) {
+        mark_clean(cache_block);
+        buffer_pool.erase(cache_block);
+    }
+}
+
+template<typename G>
+void BasicFileSystem<G>::flush_buffer_cache() {
+    allocate_delayed_blocks();
+    wait_for_writeback();
+    for (auto &cache_block: buffer_pool) {
+        if (cache_block.is_dirty()) {
+            disk_manager.queue_write(cache_block.block_no, cache_block.block_data(), 1);
+            mark_clean(&cache_block);
+        }
+    }
+    disk_manager.submit();
+}
+
+template<typename G>
+void BasicFileSystem<G>::mark_clean(BufferCache *cache_block) {
+    if (cache_block->is_dirty()) {
+        cache_block->set_dirty(false);
+        dirty_blocks--;
+    }
+}
+
+template<typename G>
+std::vector<typename BasicFileSystem<G>::BufferCache *> BasicFileSystem<G>::pick_dirty_blocks(bool only_expired) {
+    const auto expired_before = std::chrono::steady_clock::now() - dirty_expire;
+    std::vector<BufferCache *> blocks;
+    for (auto &cache_block: buffer_pool) {
+        // 延迟分配的页还没有盘块，不计入dirty_blocks，由allocate_delayed_blocks()变为普通脏块
+        if (cache_block.is_dirty() && !cache_block.is_delayed() &&
+            (!only_expired || cache_block.get_dirty_since() <= expired_before)) {
+            blocks.push_back(&cache_block);
+        }
+    }
+    if (blocks.size() > WRITEBACK_BATCH_BLOCKS) {
+        std::nth_element(blocks.begin(), blocks.begin() + WRITEBACK_BATCH_BLOCKS, blocks.end(),
+                         [](const BufferCache *a, const BufferCache *b) {
+                             return a->get_dirty_since() < b->get_dirty_since();
+                         });
+        blocks.resize(WRITEBACK_BATCH_BLOCKS);
+    }
+    // 按盘块号排序，物理相邻的块合并为一次写入
+    std::sort(blocks.begin(), blocks.end(), [](const BufferCache *a, const BufferCache *b) {
+        return a->block_no < b->block_no;
+    });
+    return blocks;
+}
+
+template<typename G>
+void BasicFileSystem<G>::start_writeback(uint32_t background_percent, uint32_t hard_percent,
+                                         std::chrono::milliseconds expire) {
+    if (hard_percent > 100 || background_percent > hard_percent) {
+        throw std::runtime_error("Invalid dirty thresholds: " + std::to_string(background_percent) + "% / " +
+                                 std::to_string(hard_percent) + "%");
+    }
+    // 重新启动以使用新的参数，不能在持有锁时等待后台线程
+    stop_writeback();
+
+    Guard guard(*this);
+    if (disk_manager.mode() == DiskMode::STREAM) {
+        throw std::runtime_error("Background writeback is not supported in STREAM mode");
+    }
+    dirty_background_percent = background_percent;
+    dirty_hard_percent = hard_percent;
+    dirty_expire = expire;
+    writeback_disk = std::make_unique<DiskManager>(disk_paths, G::DISK_SIZE, disk_manager.mode(), G::BLOCK_SIZE,
+                                                   stripe_blocks);
+    writeback_stop = false;
+    writeback_thread = std::thread(&BasicFileSystem::writeback_loop, this);
+}
+
+template<typename G>
+void BasicFileSystem<G>::stop_writeback() {
+    if (!writeback_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(writeback_mutex);
+        writeback_stop = true;
+    }
+    writeback_wakeup.notify_all();
+    writeback_thread.join();
+    writeback_disk.reset();
+}
+
+template<typename G>
+uint32_t BasicFileSystem<G>::dirty_block_count() {
+    Guard guard(*this);
+    return dirty_blocks;
+}
+
+template<typename G>
+void BasicFileSystem<G>::set_direct_io_threshold(const uint32_t &min_blocks) {
+    Guard guard(*this);
+    direct_io_min_blocks = min_blocks;
+}
+
+template<typename G>
+void BasicFileSystem<G>::set_delayed_allocation(const bool &enabled) {
+    Guard guard(*this);
+    if (!enabled) {
+        allocate_delayed_blocks();
+    }
+    delay_allocation = enabled;
+}
+
+template<typename G>
+void BasicFileSystem<G>::writeback_loop() {
+    std::vector<char> staging;
+    std::vector<uint32_t> block_nos;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(writeback_mutex);
+            writeback_wakeup.wait_for(lock, std::chrono::milliseconds(WRITEBACK_INTERVAL_MS),
+                                      [this]() { return writeback_stop; });
+            if (writeback_stop) {
+                return;
+            }
+        }
+
+        // 超过背景阈值时持续写回最久的脏块，否则只写回停留过久的脏块
+        bool over_background = true;
+        while (over_background) {
+            {
+                Guard guard(*this);
+                const uint32_t background_limit = buffer_pool.capacity() * dirty_background_percent / 100;
+                // 延迟分配的页停留过久（或连同脏块超过背景阈值）时分配盘块，与其他脏块一起写回
+                allocate_delayed_blocks(dirty_blocks + buffer_pool.delayed_count() <= background_limit);
+                auto blocks = pick_dirty_blocks(dirty_blocks <= background_limit);
+                if (blocks.empty()) {
+                    break;
+                }
+                // 复制出缓存后就可以放开锁，前台可以继续修改这些块
+                staging.resize(blocks.size() * G::BLOCK_SIZE);
+                block_nos.clear();
+                for (size_t i = 0; i < blocks.size(); i++) {
+                    std::memcpy(staging.data() + i * G::BLOCK_SIZE, blocks[i]->block_data(), G::BLOCK_SIZE);
+                    block_nos.push_back(blocks[i]->block_no);
+                    mark_clean(blocks[i]);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(writeback_mutex);
+                    writeback_in_flight = block_nos;
+                    writeback_busy = true;
+                }
+                over_background = dirty_blocks > background_limit;
+            }
+
+            std::exception_ptr error;
+            try {
+                for (size_t i = 0; i < block_nos.size(); i++) {
+                    writeback_disk->queue_write(block_nos[i], staging.data() + i * G::BLOCK_SIZE, 1);
+                }
+                writeback_disk->submit();
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            // 前台可能持有锁在等待这一批，先通知完成，再加锁
+            {
+                std::lock_guard<std::mutex> lock(writeback_mutex);
+                writeback_in_flight.clear();
+                writeback_busy = false;
+            }
+            writeback_finished.notify_all();
+
+            if (error) {
+                // 还在缓存中且没有被再次修改的块恢复为脏块，之后由前台写回；错误在下次save()时抛出
+                Guard guard(*this);
+                for (size_t i = 0; i < block_nos.size(); i++) {
+                    auto cache_block = buffer_pool.find(block_nos[i]);
+                    if (cache_block != nullptr && !cache_block->is_dirty()) {
+                        std::memcpy(cache_block->block_data(), staging.data() + i * G::BLOCK_SIZE, G::BLOCK_SIZE);
+                        cache_block->set_dirty(true);
+                        dirty_blocks++;
+                    }
+                }
+                writeback_error = error;
+                return;
+            }
+        }
+    }
+}
+
+template<typename G>
+void BasicFileSystem<G>::wait_for_writeback() {
+    if (!writeback_busy) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(writeback_mutex);
+    writeback_finished.wait(lock, [this]() { return writeback_in_flight.empty(); });
+}
+
+template<typename G>
+void BasicFileSystem<G>::wait_for_writeback(const uint32_t &block_no) {
+    if (!writeback_busy) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(writeback_mutex);
+    writeback_finished.wait(lock, [this, &block_no]() {
+        return !std::binary_search(writeback_in_flight.begin(), writeback_in_flight.end(), block_no);
+    });
+}
+
+template<typename G>
+void BasicFileSystem<G>::throttle_dirty_blocks() {
+    const uint32_t hard_limit = buffer_pool.capacity() * dirty_hard_percent / 100;
+    while (dirty_blocks > hard_limit) {
+        wait_for_writeback();
+        for (auto cache_block: pick_dirty_blocks(false)) {
+            disk_manager.queue_write(cache_block->block_no, cache_block->block_data(), 1);
+            mark_clean(cache_block);
+        }
+        disk_manager.submit();
+    }
+}
+
+template<typename G>
+void BasicFileSystem<G>::set_cache_capacity(const uint32_t &capacity) {
+    Guard guard(*this);
+    if (capacity < G::MIN_CACHE_BLOCK_NUM) {
+        throw std::runtime_error("Buffer cache needs at least " + std::to_string(G::MIN_CACHE_BLOCK_NUM) + " blocks");
+    }
+    // 写回所有脏块，之后的缓存内容全部丢弃
+    flush_buffer_cache();
+    wait_for_reads();
+    buffer_pool.resize(capacity);
+}
+
+template<typename G>
+void BasicFileSystem<G>::set_cache_policy(CachePolicy policy) {
+    Guard guard(*this);
+    flush_buffer_cache();
+    wait_for_reads();
+    buffer_pool.set_policy(policy);
+}
+
+template<typename G>
+BasicFileSystem<G>::BasicFileSystem(DiskMode disk_mode, const std::string &disk_path)
+        : BasicFileSystem(disk_mode, std::vector<std::string>{disk_path}) {
+}
+
+template<typename G>
+BasicFileSystem<G>::BasicFileSystem(DiskMode disk_mode, const std::vector<std::string> &disk_paths,
+                                    const uint32_t &stripe_blocks)
+        : disk_manager(disk_paths, G::DISK_SIZE, disk_mode, G::BLOCK_SIZE, stripe_blocks),
+          open_files(), buffer_pool(G::CACHE_BLOCK_NUM), disk_paths(disk_paths), stripe_blocks(stripe_blocks) {
     // 读取磁盘文件的SuperBlock
-    auto super_block_data = disk_manager.read_block(0, SUPER_BLOCK_SIZE);
-    super_block = *reinterpret_cast<SuperBlock *>(super_block_data.data());
+    disk_manager.read_block(0, G::SUPER_BLOCK_BLOCKS, reinterpret_cast<char *>(&super_block));
+    const auto *header = reinterpret_cast<const char *>(&super_block);
+    if (std::all_of(header, header + G::SUPER_BLOCK_HEADER_SIZE, [](char c) { return c == 0; })) {
+        // 头部全为0，尚未格式化的磁盘，需要format()
+        super_block = SuperBlock();
+    } else if (!is_known_block_size(super_block.block_size)) {
+        // 旧版本（头部没有块大小）格式化的磁盘或者不是文件系统的磁盘，不能挂载，也不能覆盖
+        throw std::runtime_error("Disk " + disk_paths.front() +
+                                 " has no recognizable superblock (formatted by an older version?), "
+                                 "it must be reformatted");
+    } else if (!super_block.matches_geometry()) {
+        // 用其他几何参数格式化的磁盘，不能挂载，也不能覆盖
+        throw std::runtime_error("Disk " + disk_paths.front() + " was formatted with " +
+                                 std::to_string(super_block.block_size) + "-byte blocks, expected " +
+                                 std::to_string(G::BLOCK_SIZE));
+    }
+    block_allocator.rebuild();
 
     // 初始化打开文件表, 全部置空
     for (auto &open_file: open_files) {
@@ -659,14 +1529,6 @@ FileSystem::FileSystem() : disk_manager(DISK_PATH, DISK_SIZE), open_files() {
     }
     device_m_inodes.clear();
 
-    // 清除高速缓存
-    for (auto &cache_block: buffer_cache) {
-        cache_block.clear();
-        free_buffer_cache.push_back(&cache_block);
-    }
-    device_buffer_cache.clear();
-    buffer_cache_map.clear();
-
     // 打开根目录
     current_inode_id = 1;
 
@@ -675,22 +1537,31 @@ FileSystem::FileSystem() : disk_manager(DISK_PATH, DISK_SIZE), open_files() {
     }
 }
 
-std::pair<uint32_t, uint32_t> FileSystem::inode_id_to_block_no(const uint32_t &inode_id) {
-    uint32_t block_no = inode_id / 8 + INODE_START_INDEX;
-    uint32_t offset = inode_id % 8;
-    return std::make_pair(block_no, offset);
-}
-
+template<typename G>
 template<typename T>
-void FileSystem::write_buffer(BufferCache *pCache, const T *value, const uint32_t &index, uint32_t size,
+void BasicFileSystem<G>::write_buffer(BufferCache *pCache, const T *value, const uint32_t &index, uint32_t size,
                               bool index_by_char) {
-    bool write_to_bottom = pCache->write<T>(value, index, size, index_by_char);
-    if (write_to_bottom) {
-        write_cache_to_disk(pCache);
+    // 写满的块不再立即写回，而是保持为脏块，
+    // 在被换出、后台写回或save()时与物理相邻的脏块合并为一次写入
+    const bool was_dirty = pCache->is_dirty();
+    (void) pCache->template write<T>(value, index, size, index_by_char);
+    if (was_dirty) {
+        return;
+    }
+    dirty_blocks++;
+    if (writeback_running()) {
+        const uint32_t capacity = buffer_pool.capacity();
+        if (dirty_blocks > capacity * dirty_hard_percent / 100) {
+            throttle_dirty_blocks();
+        } else if (dirty_blocks == capacity * dirty_background_percent / 100 + 1) {
+            writeback_wakeup.notify_one();
+        }
     }
 }
 
-void FileSystem::cd(const std::string &path) {
+template<typename G>
+void BasicFileSystem<G>::cd(const std::string &path) {
+    Guard guard(*this);
     if (path.empty()) {
         return;
     }
@@ -702,8 +1573,9 @@ void FileSystem::cd(const std::string &path) {
     for (const auto &dir: dirs) {
         // 如果当前目录中找不到dir，抛出异常
         bool found = false;
+        BufferHandle block;
         for (uint32_t i = 0; i < current_inode->get_directory_num(); i++) {
-            auto dir_entry = get_directory_entry(current_inode, i);
+            auto dir_entry = get_directory_entry(current_inode, i, block);
             if (dir_entry->inode_id != 0 && dir_entry->name == dir) {
                 current_inode = allocate_memory_inode(dir_entry->inode_id);
                 found = true;
@@ -725,9 +1597,11 @@ void FileSystem::cd(const std::string &path) {
     current_inode_id = current_inode->inode_id;
 }
 
-const uint32_t &FileSystem::get_parent_inode_id(Inode *pInode) {
+template<typename G>
+uint32_t BasicFileSystem<G>::get_parent_inode_id(Inode *pInode) {
+    BufferHandle block;
     for (uint32_t i = 0; i < pInode->get_directory_num(); i++) {
-        auto dir_entry = get_directory_entry(pInode, i);
+        auto dir_entry = get_directory_entry(pInode, i, block);
         if (dir_entry->inode_id != 0 && std::string(dir_entry->name) == "..") {
             return dir_entry->inode_id;
         }
@@ -735,42 +1609,71 @@ const uint32_t &FileSystem::get_parent_inode_id(Inode *pInode) {
     throw std::runtime_error("Parent directory not found");
 }
 
-void FileSystem::rm(const std::string &dir_name) {
-    auto dir_inode = allocate_memory_inode(current_inode_id);
-    for (uint32_t i = 0; i < dir_inode->get_directory_num(); i++) {
-        auto entry = get_directory_entry(dir_inode, i);
-        if (entry->inode_id != 0 && std::string(entry->name) == dir_name) {
-            auto inode = allocate_memory_inode(entry->inode_id);
-            if (inode->is_directory() && inode->get_directory_num() > 2) {
-                throw std::runtime_error("Directory not empty: " + dir_name);
+template<typename G>
+void BasicFileSystem<G>::rm(const std::string &dir_name) {
+    bool outermost;
+    {
+        Guard guard(*this);
+        outermost = guard.outermost();
+        auto dir_inode = allocate_memory_inode(current_inode_id);
+        BufferHandle block;
+        uint32_t i = 0;
+        uint32_t inode_id = 0;
+        for (; i < dir_inode->get_directory_num(); i++) {
+            auto entry = get_directory_entry(dir_inode, i, block);
+            if (entry->inode_id != 0 && std::string(entry->name) == dir_name) {
+                inode_id = entry->inode_id;
+                break;
             }
-
-            // set_directory_entry(dir_inode, i, 0, "");
-            // 把当前文件夹下的最后一个目录覆盖到这个位置
-            auto last_entry = get_directory_entry(dir_inode, dir_inode->get_directory_num() - 1);
-            set_directory_entry(dir_inode, i, last_entry->inode_id, last_entry->name);
-            set_directory_entry(dir_inode, dir_inode->get_directory_num() - 1, 0, ""); // TODO 可以删去这一行，保留为了测试的时候好看
-            dir_inode->file_size -= sizeof(DirectoryEntry);
-            free_memory_inode(inode);
-
-            return;
         }
+        if (inode_id == 0) {
+            throw std::runtime_error("Directory not found: " + dir_name);
+        }
+        auto inode = allocate_memory_inode(inode_id);
+        if (inode->is_directory() && inode->get_directory_num() > 2) {
+            throw std::runtime_error("Directory not empty: " + dir_name);
+        }
+
+        // set_directory_entry(dir_inode, i, 0, "");
+        // 把当前文件夹下的最后一个目录覆盖到这个位置
+        BufferHandle last_block;
+        auto last_entry = get_directory_entry(dir_inode, dir_inode->get_directory_num() - 1, last_block);
+        set_directory_entry(dir_inode, i, last_entry->inode_id, last_entry->name);
+        set_directory_entry(dir_inode, dir_inode->get_directory_num() - 1, 0, ""); // TODO 可以删去这一行，保留为了测试的时候好看
+        dir_inode->file_size -= sizeof(DirectoryEntry);
+        dir_inode->dirty = true;
+        free_memory_inode(inode);
+        operation_done();
+    }
+    if (outermost) {
+        sync_commits();
     }
-    throw std::runtime_error("Directory not found: " + dir_name);
 }
 
-void FileSystem::init() {
-    format();
-    mkdir("root");
-    mkdir("home");
-    mkdir("etc");
-    mkdir("bin");
-    mkdir("usr");
-    mkdir("dev");
-    cd("/root");
+template<typename G>
+void BasicFileSystem<G>::init() {
+    bool outermost;
+    {
+        Guard guard(*this);
+        outermost = guard.outermost();
+        format();
+        mkdir("root");
+        mkdir("home");
+        mkdir("etc");
+        mkdir("bin");
+        mkdir("usr");
+        mkdir("dev");
+        cd("/root");
+    }
+    // 嵌套的mkdir不等待持久化，在这里一起等待
+    if (outermost) {
+        sync_commits();
+    }
 }
 
-bool FileSystem::exist(const std::string &path) {
+template<typename G>
+bool BasicFileSystem<G>::exist(const std::string &path) {
+    Guard guard(*this);
     try {
         get_inode_by_path(path);
         return true;
@@ -779,49 +1682,79 @@ bool FileSystem::exist(const std::string &path) {
     }
 }
 
-void FileSystem::touch(const std::string &file_name) {
-    auto dir_inode = allocate_memory_inode(current_inode_id);
-    auto entries = ls();
-    // if (std::find(entries.begin(), entries.end(), file_name) != entries.end()) {
-    //     throw std::runtime_error("File already exists: " + file_name);
-    // }
-    // 不使用find，手动实现上面的功能
-    for (const auto &entry: entries) {
-        if (entry == file_name) {
-            throw std::runtime_error("File already exists: " + file_name);
+template<typename G>
+void BasicFileSystem<G>::touch(const std::string &file_name) {
+    bool outermost;
+    {
+        Guard guard(*this);
+        outermost = guard.outermost();
+        auto dir_inode = allocate_memory_inode(current_inode_id);
+        auto entries = ls();
+        // if (std::find(entries.begin(), entries.end(), file_name) != entries.end()) {
+        //     throw std::runtime_error("File already exists: " + file_name);
+        // }
+        // 不使用find，手动实现上面的功能
+        for (const auto &entry: entries) {
+            if (entry == file_name) {
+                throw std::runtime_error("File already exists: " + file_name);
+            }
         }
-    }
-
 
-    auto new_file_inode = allocate_memory_inode(super_block.get_free_inode());
-    new_file_inode->file_type = FileType::FILE;
-    new_file_inode->file_size = 0;
 
-    for (uint32_t i = 0; i < dir_inode->get_directory_num(); i++) {
-        auto entry = get_directory_entry(dir_inode, i);
-        if (entry->inode_id == 0) {
-            set_directory_entry(dir_inode, i, new_file_inode->inode_id, file_name);
-            return;
+        // 编号可能属于已删除的文件，整个Inode重新初始化
+        const uint32_t new_inode_id = super_block.get_free_inode();
+        auto new_file_inode = allocate_memory_inode(new_inode_id);
+        new_file_inode->clear();
+        new_file_inode->inode_id = new_inode_id;
+        new_file_inode->file_type = FileType::FILE;
+        new_file_inode->file_size = 0;
+        new_file_inode->dirty = true;
+
+        BufferHandle block;
+        bool placed = false;
+        for (uint32_t i = 0; i < dir_inode->get_directory_num(); i++) {
+            auto entry = get_directory_entry(dir_inode, i, block);
+            if (entry->inode_id == 0) {
+                set_directory_entry(dir_inode, i, new_file_inode->inode_id, file_name);
+                placed = true;
+                break;
+            }
         }
+        if (!placed) {
+            if (dir_inode->get_directory_num() % G::ENTRIES_PER_BLOCK == 0) {
+                alloc_new_block(dir_inode);
+            }
+            set_directory_entry(dir_inode, dir_inode->get_directory_num(), new_file_inode->inode_id, file_name);
+            dir_inode->file_size += sizeof(DirectoryEntry);
+            dir_inode->dirty = true;
+        }
+        operation_done();
     }
-    if (dir_inode->get_directory_num() % 16 == 0) {
-        alloc_new_block(dir_inode);
+    if (outermost) {
+        sync_commits();
     }
-    set_directory_entry(dir_inode, dir_inode->get_directory_num(), new_file_inode->inode_id, file_name);
-    dir_inode->file_size += sizeof(DirectoryEntry);
 }
 
-void FileSystem::free_memory_inode(Inode *pInode) {
+template<typename G>
+void BasicFileSystem<G>::free_memory_inode(Inode *pInode) {
     // free_m_inodes.push_back(pInode);
     // device_m_inodes.remove(pInode);
 
 
     // 释放Inode
     super_block.inode_bitmap.reset(pInode->inode_id);
+    super_block.dirty_flag = 1;
     // 释放Inode指向的所有数据块
     free_all_data_block(pInode);
+    // 清空后写回它自己在磁盘上的位置，之后复用这个编号的文件不会读到旧的指针
+    const uint32_t inode_id = pInode->inode_id;
     pInode->clear();
+    pInode->inode_id = inode_id;
     write_back_inode(pInode);
+    pInode->inode_id = 0;
+    if (freed_blocks.size() >= DISCARD_BATCH_BLOCKS) {
+        discard_freed_blocks();
+    }
     // for (int i = 0; i < (pInode->file_size / BLOCK_SIZE) + 1; i++) {
     //     auto block_no = get_block_pointer(pInode, i);
     //     if (block_no >= BLOCK_START_INDEX) {
@@ -830,26 +1763,163 @@ void FileSystem::free_memory_inode(Inode *pInode) {
     // }
 }
 
-void FileSystem::save() {
-    // 将superblock写回
-    std::vector<char> super_block_data(sizeof(super_block));
-    std::memcpy(super_block_data.data(), &super_block, sizeof(super_block));
-    disk_manager.write_block(0, super_block_data);
+template<typename G>
+void BasicFileSystem<G>::flush_metadata() {
+    // 延迟分配的块先分配盘块，Inode中的指针随之确定
+    allocate_delayed_blocks();
+    // 有修改的内存Inode写回高速缓存
+    for (auto &m_inode: m_inodes) {
+        if (m_inode.dirty) {
+            write_back_inode(&m_inode);
+        }
+    }
+
+    // 先打洞，已释放盘块的脏缓存不再写回
+    discard_freed_blocks();
+
+    // 有修改的superblock和所有脏缓存块作为一批提交
+    if (super_block.dirty_flag) {
+        disk_manager.queue_write(0, reinterpret_cast<const char *>(&super_block), G::SUPER_BLOCK_BLOCKS);
+    }
+    flush_buffer_cache();
     super_block.dirty_flag = 0;
+}
 
-    // 将内存Inode和高速缓存写回磁盘
-    for (auto &m_inode: m_inodes) {
-        write_back_inode(&m_inode);
+template<typename G>
+void BasicFileSystem<G>::save() {
+    Guard guard(*this);
+    flush_metadata();
+
+    // 写入只到达了操作系统缓存，在这里统一持久化，之前写入的提交随之持久化
+    disk_manager.sync();
+    {
+        std::lock_guard<std::mutex> lock(commit_mutex);
+        commit_synced = commit_written;
     }
+    if (writeback_error) {
+        auto error = writeback_error;
+        writeback_error = nullptr;
+        std::rethrow_exception(error);
+    }
+    uncommitted_ops = 0;
+}
 
-    for (auto &cache_block: buffer_cache) {
-        if (cache_block.is_dirty()) {
-            write_back_cache_block(&cache_block);
+template<typename G>
+void BasicFileSystem<G>::set_durability(Durability policy, std::chrono::milliseconds interval) {
+    // 定时提交线程需要加锁，不能在持有锁时等待它
+    stop_periodic_commit();
+
+    Guard guard(*this);
+    if (disk_manager.mode() == DiskMode::STREAM && policy != Durability::NONE) {
+        throw std::runtime_error("Durability policies are not supported in STREAM mode");
+    }
+    durability = policy;
+    commit_interval = interval;
+    if (policy == Durability::PERIODIC) {
+        commit_stop = false;
+        commit_thread = std::thread(&BasicFileSystem::commit_loop, this);
+    }
+}
+
+template<typename G>
+void BasicFileSystem<G>::commit() {
+    {
+        Guard guard(*this);
+        flush_commit();
+    }
+    sync_commits();
+}
+
+template<typename G>
+void BasicFileSystem<G>::flush_commit() {
+    // 上次提交之后没有修改，不需要再sync
+    if (uncommitted_ops == 0) {
+        return;
+    }
+    if (commit_disk == nullptr) {
+        commit_disk = std::make_unique<DiskManager>(disk_paths, G::DISK_SIZE, disk_manager.mode(), G::BLOCK_SIZE,
+                                                    stripe_blocks);
+    }
+    flush_metadata();
+    uncommitted_ops = 0;
+    std::lock_guard<std::mutex> lock(commit_mutex);
+    commit_written++;
+}
+
+template<typename G>
+void BasicFileSystem<G>::sync_commits() {
+    std::unique_lock<std::mutex> lock(commit_mutex);
+    // 只等待此刻之前的提交，之后到达的由它们自己等待
+    const uint64_t target = commit_written;
+    while (commit_synced < target) {
+        if (commit_syncing) {
+            commit_finished.wait(lock);
+            continue;
+        }
+        // 这次sync覆盖开始之前写入的所有提交
+        const uint64_t covered = commit_written;
+        commit_syncing = true;
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            commit_disk->sync();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        lock.lock();
+        commit_syncing = false;
+        commit_syncs++;
+        if (!error) {
+            commit_synced = std::max(commit_synced, covered);
+        }
+        commit_finished.notify_all();
+        if (error) {
+            std::rethrow_exception(error);
         }
     }
 }
 
-uint32_t FileSystem::fopen(const std::string &file_path) {
+template<typename G>
+void BasicFileSystem<G>::commit_loop() {
+    std::unique_lock<std::mutex> lock(commit_mutex);
+    while (!commit_wakeup.wait_for(lock, commit_interval, [this]() { return commit_stop; })) {
+        lock.unlock();
+        try {
+            commit();
+        } catch (...) {
+            // 与后台写回的错误一样，下次save()时抛出
+            Guard guard(*this);
+            writeback_error = std::current_exception();
+        }
+        lock.lock();
+    }
+}
+
+template<typename G>
+void BasicFileSystem<G>::stop_periodic_commit() {
+    if (!commit_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(commit_mutex);
+        commit_stop = true;
+    }
+    commit_wakeup.notify_all();
+    commit_thread.join();
+}
+
+template<typename G>
+void BasicFileSystem<G>::operation_done() {
+    uncommitted_ops++;
+    if (durability == Durability::PER_OP) {
+        // 在锁内写入操作系统，调用者在释放锁之后等待sync
+        flush_commit();
+    }
+}
+
+template<typename G>
+uint32_t BasicFileSystem<G>::fopen(const std::string &file_path) {
+    Guard guard(*this);
     auto dir_inode = get_inode_by_path(file_path);
     if (dir_inode->is_directory()) {
         throw std::runtime_error("Is a directory instead of file: " + file_path);
@@ -877,89 +1947,137 @@ uint32_t FileSystem::fopen(const std::string &file_path) {
     throw std::runtime_error("Exceeded maximum number of open files");
 }
 
-void FileSystem::fclose(const uint32_t &file_id) {
-    auto &open_file = open_files[file_id];
-    if (open_file.is_busy()) {
-        open_file.reference_count--;
-        if (open_file.reference_count == 0) {
-            open_file.clear();
-            return;
+template<typename G>
+void BasicFileSystem<G>::fclose(const uint32_t &file_id) {
+    bool outermost;
+    {
+        Guard guard(*this);
+        outermost = guard.outermost();
+        auto &open_file = open_files[file_id];
+        bool closed = false;
+        if (open_file.is_busy()) {
+            open_file.reference_count--;
+            if (open_file.reference_count == 0) {
+                open_file.clear();
+                if (durability == Durability::ON_CLOSE) {
+                    flush_commit();
+                }
+                closed = true;
+            }
+        }
+        if (!closed) {
+            // 抛异常，没有打开的文件编号是[fd]
+            throw std::runtime_error("No open file, fd=[" + std::to_string(file_id) + "]");
         }
     }
-    // 抛异常，没有打开的文件编号是[fd]
-    throw std::runtime_error("No open file, fd=[" + std::to_string(file_id) + "]");
-}
-
-void FileSystem::fwrite(const uint32_t &file_id, const char *data, const uint32_t &size) {
-    auto &open_file = open_files[file_id];
-    if (!open_file.is_busy()) {
-        throw std::runtime_error("File not opened: " + std::to_string(file_id));
+    if (outermost) {
+        sync_commits();
     }
-    auto inode = allocate_memory_inode(open_file.inode_id);
-
-    uint32_t offset = open_file.offset;
-    uint32_t ptr = offset;
-
+}
 
-    while (ptr - offset < size) {
-        // 获取、分配数据块
-        if (inode->file_size % BLOCK_SIZE == 0) {
-            alloc_new_block(inode);
+template<typename G>
+void BasicFileSystem<G>::fwrite(const uint32_t &file_id, const char *data, const uint32_t &size) {
+    bool outermost;
+    {
+        Guard guard(*this);
+        outermost = guard.outermost();
+        auto &open_file = open_files[file_id];
+        if (!open_file.is_busy()) {
+            throw std::runtime_error("File not opened: " + std::to_string(file_id));
         }
-        auto block_no = get_block_pointer(inode, ptr / BLOCK_SIZE);
+        auto inode = allocate_memory_inode(open_file.inode_id);
+
+        uint32_t offset = open_file.offset;
+        uint32_t ptr = offset;
+        // 一次分配这次写入需要的所有数据块
+        const uint32_t allocated = allocate_for_write(inode, offset, size);
+
+        while (ptr - offset < size) {
+            // 块对齐的大段数据绕过高速缓存，直接写入磁盘
+            if (auto blocks = direct_io_blocks(ptr, size - (ptr - offset)); blocks != 0) {
+                direct_write(inode, ptr, data + (ptr - offset), blocks);
+                ptr += blocks * G::BLOCK_SIZE;
+                open_file.offset = ptr;
+                continue;
+            }
 
-        // 写入数据块
-        auto buffer = allocate_buffer_cache(block_no);
-        uint32_t write_size = std::min(BLOCK_SIZE - ptr % BLOCK_SIZE, size - (ptr - offset));
-        write_buffer(buffer, data + (ptr - offset), ptr % BLOCK_SIZE, write_size, true);
-        ptr += write_size;
+            // 写入数据块，新分配的块不必从磁盘读取
+            auto buffer = allocate_file_block(inode, ptr / G::BLOCK_SIZE, ptr / G::BLOCK_SIZE >= allocated);
+            uint32_t write_size = std::min(G::BLOCK_SIZE - ptr % G::BLOCK_SIZE, size - (ptr - offset));
+            write_buffer(buffer, data + (ptr - offset), ptr % G::BLOCK_SIZE, write_size, true);
+            ptr += write_size;
 
-        // 更新数据
-        inode->file_size = std::max(inode->file_size, ptr);
-        open_file.offset = ptr;
+            // 更新数据
+            inode->file_size = std::max(inode->file_size, ptr);
+            inode->dirty = true;
+            open_file.offset = ptr;
+        }
+        operation_done();
     }
-}
-
-void
-FileSystem::fwrite(const uint32_t &file_id, const char *data, const uint32_t &size, const ProgressCallback &callback) {
-    auto &open_file = open_files[file_id];
-    if (!open_file.is_busy()) {
-        throw std::runtime_error("File not opened: " + std::to_string(file_id));
+    if (outermost) {
+        sync_commits();
     }
-    auto inode = allocate_memory_inode(open_file.inode_id);
-
-    uint32_t offset = open_file.offset;
-    uint32_t ptr = offset;
-    uint32_t total_written = 0; // 已写入的总字节数
-
-    uint32_t times = 0;
+}
 
-    while (ptr - offset < size) {
-        if (inode->file_size % BLOCK_SIZE == 0) {
-            alloc_new_block(inode);
+template<typename G>
+void BasicFileSystem<G>::fwrite(const uint32_t &file_id, const char *data, const uint32_t &size, const ProgressCallback &callback) {
+    bool outermost;
+    {
+        Guard guard(*this);
+        outermost = guard.outermost();
+        auto &open_file = open_files[file_id];
+        if (!open_file.is_busy()) {
+            throw std::runtime_error("File not opened: " + std::to_string(file_id));
         }
-        auto block_no = get_block_pointer(inode, ptr / BLOCK_SIZE);
-
-        auto buffer = allocate_buffer_cache(block_no);
-        uint32_t write_size = std::min(BLOCK_SIZE - ptr % BLOCK_SIZE, size - (ptr - offset));
-        write_buffer(buffer, data + (ptr - offset), ptr % BLOCK_SIZE, write_size, true);
-        ptr += write_size;
-        total_written += write_size;
-
-        // 更新inode和文件的偏移量
-        inode->file_size = std::max(inode->file_size, ptr);
-        open_file.offset = ptr;
+        auto inode = allocate_memory_inode(open_file.inode_id);
+
+        uint32_t offset = open_file.offset;
+        uint32_t ptr = offset;
+        uint32_t total_written = 0; // 已写入的总字节数
+        // 一次分配这次写入需要的所有数据块
+        const uint32_t allocated = allocate_for_write(inode, offset, size);
+
+        uint32_t times = 0;
+
+        while (ptr - offset < size) {
+            // 块对齐的大段数据绕过高速缓存，直接写入磁盘
+            if (auto blocks = direct_io_blocks(ptr, size - (ptr - offset)); blocks != 0) {
+                direct_write(inode, ptr, data + (ptr - offset), blocks);
+                ptr += blocks * G::BLOCK_SIZE;
+                total_written += blocks * G::BLOCK_SIZE;
+                open_file.offset = ptr;
+                callback(total_written, size);
+                continue;
+            }
 
-        // 检查是否已写入至少1%的数据，并且自上次调用以来进度有更新
-        if (times++ == 5000) {
-            callback(total_written, size); // 调用回调函数
-            times = 0;
+            auto buffer = allocate_file_block(inode, ptr / G::BLOCK_SIZE, ptr / G::BLOCK_SIZE >= allocated);
+            uint32_t write_size = std::min(G::BLOCK_SIZE - ptr % G::BLOCK_SIZE, size - (ptr - offset));
+            write_buffer(buffer, data + (ptr - offset), ptr % G::BLOCK_SIZE, write_size, true);
+            ptr += write_size;
+            total_written += write_size;
+
+            // 更新inode和文件的偏移量
+            inode->file_size = std::max(inode->file_size, ptr);
+            inode->dirty = true;
+            open_file.offset = ptr;
+
+            // 检查是否已写入至少1%的数据，并且自上次调用以来进度有更新
+            if (times++ == 5000) {
+                callback(total_written, size); // 调用回调函数
+                times = 0;
+            }
         }
+        callback(total_written, size);
+        operation_done();
+    }
+    if (outermost) {
+        sync_commits();
     }
-    callback(total_written, size);
 }
 
-void FileSystem::fread(const uint32_t &file_id, char *data, const uint32_t &size) {
+template<typename G>
+void BasicFileSystem<G>::fread(const uint32_t &file_id, char *data, const uint32_t &size) {
+    Guard guard(*this);
     auto &open_file = open_files[file_id];
     if (!open_file.is_busy()) {
         throw std::runtime_error("File not opened: " + std::to_string(file_id));
@@ -969,18 +2087,24 @@ void FileSystem::fread(const uint32_t &file_id, char *data, const uint32_t &size
     uint32_t offset = open_file.offset;
     uint32_t ptr = offset;
     while (ptr - offset < size && ptr < inode->file_size) {
-        // 获取数据块
-        auto block_no = get_block_pointer(inode, ptr / BLOCK_SIZE);
-        if (block_no < BLOCK_START_INDEX) {
-            throw std::runtime_error("Block not allocated: " + std::to_string(block_no));
+        // 块对齐的大段数据绕过高速缓存，直接读入用户缓冲区
+        if (auto blocks = direct_io_blocks(ptr, std::min(size - (ptr - offset), inode->file_size - ptr));
+                blocks != 0) {
+            direct_read(inode, ptr, data + (ptr - offset), blocks);
+            ptr += blocks * G::BLOCK_SIZE;
+            open_file.offset = ptr;
+            continue;
         }
 
+        // 获取数据块，顺序读时预读之后的块
+        readahead(open_file, inode, ptr / G::BLOCK_SIZE);
+
         // 读取数据块
-        auto buffer = allocate_buffer_cache(block_no);
-        uint32_t read_size = std::min(BLOCK_SIZE - ptr % BLOCK_SIZE, size - (ptr - offset));
+        auto buffer = allocate_file_block(inode, ptr / G::BLOCK_SIZE);
+        uint32_t read_size = std::min(G::BLOCK_SIZE - ptr % G::BLOCK_SIZE, size - (ptr - offset));
         read_size = std::min(read_size, inode->file_size - ptr);
 
-        auto ptr_data = buffer->read<char>(ptr % BLOCK_SIZE);
+        auto ptr_data = buffer->template read<char>(ptr % G::BLOCK_SIZE);
         std::memcpy(data + (ptr - offset), ptr_data, read_size);
         ptr += read_size;
 
@@ -989,7 +2113,9 @@ void FileSystem::fread(const uint32_t &file_id, char *data, const uint32_t &size
     }
 }
 
-void FileSystem::fread(const uint32_t &file_id, char *data, const uint32_t &size, const ProgressCallback &callback) {
+template<typename G>
+void BasicFileSystem<G>::fread(const uint32_t &file_id, char *data, const uint32_t &size, const ProgressCallback &callback) {
+    Guard guard(*this);
     auto &open_file = open_files[file_id];
     if (!open_file.is_busy()) {
         throw std::runtime_error("File not opened: " + std::to_string(file_id));
@@ -1000,18 +2126,24 @@ void FileSystem::fread(const uint32_t &file_id, char *data, const uint32_t &size
     uint32_t ptr = offset;
     uint32_t times = 0;
     while (ptr - offset < size && ptr < inode->file_size) {
-        // 获取数据块
-        auto block_no = get_block_pointer(inode, ptr / BLOCK_SIZE);
-        if (block_no < BLOCK_START_INDEX) {
-            throw std::runtime_error("Block not allocated: " + std::to_string(block_no));
+        // 块对齐的大段数据绕过高速缓存，直接读入用户缓冲区
+        if (auto blocks = direct_io_blocks(ptr, std::min(size - (ptr - offset), inode->file_size - ptr));
+                blocks != 0) {
+            direct_read(inode, ptr, data + (ptr - offset), blocks);
+            ptr += blocks * G::BLOCK_SIZE;
+            open_file.offset = ptr;
+            continue;
         }
 
+        // 获取数据块，顺序读时预读之后的块
+        readahead(open_file, inode, ptr / G::BLOCK_SIZE);
+
         // 读取数据块
-        auto buffer = allocate_buffer_cache(block_no);
-        uint32_t read_size = std::min(BLOCK_SIZE - ptr % BLOCK_SIZE, size - (ptr - offset));
+        auto buffer = allocate_file_block(inode, ptr / G::BLOCK_SIZE);
+        uint32_t read_size = std::min(G::BLOCK_SIZE - ptr % G::BLOCK_SIZE, size - (ptr - offset));
         read_size = std::min(read_size, inode->file_size - ptr);
 
-        auto ptr_data = buffer->read<char>(ptr % BLOCK_SIZE);
+        auto ptr_data = buffer->template read<char>(ptr % G::BLOCK_SIZE);
         std::memcpy(data + (ptr - offset), ptr_data, read_size);
         ptr += read_size;
 
@@ -1026,7 +2158,50 @@ void FileSystem::fread(const uint32_t &file_id, char *data, const uint32_t &size
     callback((ptr - offset), size);
 }
 
-void FileSystem::fseek(const uint32_t &file_id, const uint32_t &offset) {
+template<typename G>
+void BasicFileSystem<G>::fallocate(const uint32_t &file_id, const uint32_t &offset, const uint32_t &len,
+                                   const bool &zero) {
+    bool outermost;
+    {
+        Guard guard(*this);
+        outermost = guard.outermost();
+        auto &open_file = open_files[file_id];
+        if (!open_file.is_busy()) {
+            throw std::runtime_error("File not opened: " + std::to_string(file_id));
+        }
+        if (len == 0) {
+            throw std::runtime_error("Invalid fallocate length: 0");
+        }
+        const uint64_t end = (uint64_t) offset + len;
+        const uint64_t needed = (end + G::BLOCK_SIZE - 1) / G::BLOCK_SIZE;
+        if (needed > G::INDEX_LEVEL_END[3]) {
+            throw std::runtime_error("File too large");
+        }
+        auto inode = allocate_memory_inode(open_file.inode_id);
+
+        // 延迟分配的块先分配盘块，新的块紧接在它们之后
+        allocate_delayed_blocks(inode);
+        const uint32_t allocated = allocated_blocks(inode);
+        if (needed > allocated) {
+            alloc_new_blocks(inode, allocated, needed - allocated);
+            inode->preallocated_blocks = needed;
+            inode->dirty = true;
+        }
+        if (zero && end > inode->file_size) {
+            zero_file_range(inode, inode->file_size, end);
+            inode->file_size = end;
+            inode->dirty = true;
+        }
+        operation_done();
+    }
+    if (outermost) {
+        sync_commits();
+    }
+}
+
+template<typename G>
+void BasicFileSystem<G>::fseek(const uint32_t &file_id, const uint32_t &offset) {
+    Guard guard(*this);
     auto &open_file = open_files[file_id];
     if (!open_file.is_busy()) {
         throw std::runtime_error("File not opened: " + std::to_string(file_id));
@@ -1034,30 +2209,44 @@ void FileSystem::fseek(const uint32_t &file_id, const uint32_t &offset) {
     open_file.offset = offset;
 }
 
-std::string FileSystem::cat(const std::string &file_name) {
-    auto inode = get_inode_by_path(file_name);
-    if (inode->is_directory()) {
-        throw std::runtime_error("Is a directory instead of file: " + file_name);
-    }
-    auto file_id = fopen(file_name);
-    auto offset = open_files[file_id].offset;
-    fseek(file_id, 0);
+template<typename G>
+std::string BasicFileSystem<G>::cat(const std::string &file_name) {
+    bool outermost;
+    std::string content;
+    {
+        Guard guard(*this);
+        outermost = guard.outermost();
+        auto inode = get_inode_by_path(file_name);
+        if (inode->is_directory()) {
+            throw std::runtime_error("Is a directory instead of file: " + file_name);
+        }
+        auto file_id = fopen(file_name);
+        auto offset = open_files[file_id].offset;
+        fseek(file_id, 0);
 
-    char buffer[inode->file_size];
-    fread(file_id, buffer, inode->file_size);
+        char buffer[inode->file_size];
+        fread(file_id, buffer, inode->file_size);
 
-    fseek(file_id, offset);
-    fclose(file_id);
-    return {buffer, inode->file_size};
+        fseek(file_id, offset);
+        fclose(file_id);
+        content.assign(buffer, inode->file_size);
+    }
+    // 嵌套的fclose不等待持久化，在这里等待
+    if (outermost) {
+        sync_commits();
+    }
+    return content;
 }
 
-std::string FileSystem::get_pwd_by_inode(const uint32_t &inode_id) {
+template<typename G>
+std::string BasicFileSystem<G>::get_pwd_by_inode(const uint32_t &inode_id) {
     std::string path;
     auto inode = allocate_memory_inode(inode_id);
     while (inode->inode_id != 1) {
         auto parent_inode = allocate_memory_inode(get_parent_inode_id(inode));
+        BufferHandle block;
         for (uint32_t i = 0; i < parent_inode->get_directory_num(); i++) {
-            auto dir_entry = get_directory_entry(parent_inode, i);
+            auto dir_entry = get_directory_entry(parent_inode, i, block);
             if (dir_entry->inode_id == inode->inode_id) {
                 std::stringstream ss;
                 ss << "/" << dir_entry->name << path;
@@ -1073,7 +2262,9 @@ std::string FileSystem::get_pwd_by_inode(const uint32_t &inode_id) {
     return path;
 }
 
-std::vector<std::pair<uint32_t, std::string>> FileSystem::flist() {
+template<typename G>
+std::vector<std::pair<uint32_t, std::string>> BasicFileSystem<G>::flist() {
+    Guard guard(*this);
     // 获取所有打开文件
     std::vector<std::pair<uint32_t, std::string>> files;
     for (int i = 0; i < OPEN_FILE_NUM; i++) {
@@ -1085,7 +2276,9 @@ std::vector<std::pair<uint32_t, std::string>> FileSystem::flist() {
     return files;
 }
 
-uint32_t FileSystem::get_file_size(uint32_t i) {
+template<typename G>
+uint32_t BasicFileSystem<G>::get_file_size(uint32_t i) {
+    Guard guard(*this);
     auto &open_file = open_files[i];
     if (!open_file.is_busy()) {
         throw std::runtime_error("File not opened: " + std::to_string(i));
@@ -1094,3 +2287,46 @@ uint32_t FileSystem::get_file_size(uint32_t i) {
     return inode->file_size;
 }
 
+template<typename G>
+std::vector<std::pair<uint32_t, uint32_t>> BasicFileSystem<G>::file_extents(uint32_t i) {
+    Guard guard(*this);
+    auto &open_file = open_files[i];
+    if (!open_file.is_busy()) {
+        throw std::runtime_error("File not opened: " + std::to_string(i));
+    }
+    auto inode = allocate_memory_inode(open_file.inode_id);
+    std::vector<std::pair<uint32_t, uint32_t>> extents;
+    const uint32_t block_num = allocated_blocks(inode);
+    for (uint32_t b = 0; b < block_num; b++) {
+        auto block_no = get_block_pointer(inode, b);
+        if (!extents.empty() && extents.back().first + extents.back().second == block_no) {
+            extents.back().second++;
+        } else {
+            extents.emplace_back(block_no, 1);
+        }
+    }
+    return extents;
+}
+
+uint32_t probe_block_size(const std::string &disk_path) {
+    // SuperBlock头部的布局与几何参数无关，块大小是第5个字段
+    uint32_t header[Geometry512::SUPER_BLOCK_HEADER_SIZE / sizeof(uint32_t)] = {};
+    std::ifstream disk(disk_path, std::ios::binary);
+    if (!disk.read(reinterpret_cast<char *>(header), sizeof(header))) {
+        return 0;
+    }
+    // 头部全为0时尚未格式化；否则返回记录的值，旧版本的磁盘在这里是位图的内容
+    for (auto word: header) {
+        if (word != 0) {
+            return header[4];
+        }
+    }
+    return 0;
+}
+
+bool is_known_block_size(const uint32_t &block_size) {
+    return block_size == Geometry512::BLOCK_SIZE || block_size == Geometry4K::BLOCK_SIZE;
+}
+
+template class BasicFileSystem<Geometry512>;
+template class BasicFileSystem<Geometry4K>;
@@ -1,11 +1,45 @@
 #include "shell/Shell.hpp"
 
 
+// 运行一个几何参数为G的Shell，返回format要求切换到的块大小，正常退出时为0
+template<typename G>
+uint32_t run_shell(std::vector<std::string> &format_args) {
+    BasicShell<G> shell;
+    if (!format_args.empty()) {
+        shell.format(format_args);
+    }
+    shell.run();
+    format_args = shell.reformat_args;
+    return shell.reformat_block_size;
+}
+
 int main() {
     // 增加一个功能，如果程序被异常中断，接住异常并打印异常信息
     try {
-        Shell shell;
-        shell.run();
+        // 挂载前读取磁盘上记录的块大小，选择对应的几何参数，未格式化的磁盘默认512字节
+        uint32_t block_size = probe_block_size(DISK_PATH);
+        if (block_size != 0 && !is_known_block_size(block_size)) {
+            // 旧版本格式化的磁盘无法挂载，清空后作为未格式化的磁盘启动，之后可以format
+            std::cout << "Disk " << DISK_PATH << " has no recognizable superblock "
+                      << "(formatted by an older version?). Erase it and start unformatted? [y/N] ";
+            std::string answer;
+            std::getline(std::cin, answer);
+            if (answer != "y" && answer != "Y") {
+                return 0;
+            }
+            DiskManager(DISK_PATH, Geometry512::DISK_SIZE).format();
+            block_size = 0;
+        }
+        std::vector<std::string> format_args;
+        while (true) {
+            block_size = block_size == Geometry4K::BLOCK_SIZE ? run_shell<Geometry4K>(format_args)
+                                                              : run_shell<Geometry512>(format_args);
+            if (block_size == 0) {
+                break;
+            }
+            // 换用另一种几何参数前清空磁盘，使其按未格式化的磁盘挂载
+            DiskManager(DISK_PATH, Geometry512::DISK_SIZE).format();
+        }
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
     } catch (...) {
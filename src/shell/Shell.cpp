@@ -5,7 +5,8 @@
 #include "shell/Shell.hpp"
 #include "common/common.hpp"
 
-Shell::Shell() {
+template<typename G>
+BasicShell<G>::BasicShell() {
     callback = [](size_t current, size_t total) {
         const int barWidth = 50; // 进度条的宽度
         float progress = static_cast<float>(current) / (float) total; // 计算当前进度（0.0 - 1.0）
@@ -32,16 +33,16 @@ Shell::Shell() {
     commands["exit"] = {[this](const std::vector<std::string> &args = {}) { this->exit_shell(); },
                         "Exit the shell",
                         "exit"};
-    commands["format"] = {[this](const std::vector<std::string> &args = {}) { this->format(); },
-                          "Format the disk",
-                          "format"};
+    commands["format"] = {[this](const std::vector<std::string> &args = {}) { this->format(args); },
+                          "Format the disk with 512 or 4096-byte blocks (prealloc reserves the whole image on the host)",
+                          "format [block_size] [sparse|prealloc]"};
     commands["ls"] = {[this](const std::vector<std::string> &args = {}) { this->ls(); },
                       "List directory contents",
                       "ls"};
     commands["pwd"] = {[this](const std::vector<std::string> &args = {}) { std::cout << fs.pwd() << std::endl; },
                        "Print working directory",
                        "pwd"};
-    commands["echo"] = {[](const std::vector<std::string> &args) { Shell::echo(args); },
+    commands["echo"] = {[](const std::vector<std::string> &args) { BasicShell::echo(args); },
                         "Print the message to the console",
                         "echo <message> [count]"};
     commands["mkdir"] = {[this](const std::vector<std::string> &args) { this->mkdir(args); },
@@ -62,6 +63,21 @@ Shell::Shell() {
     commands["save"] = {[this](const std::vector<std::string> &args = {}) { fs.save(); },
                         "Save the file system to disk",
                         "save"};
+    commands["durability"] = {[this](const std::vector<std::string> &args) { this->durability(args); },
+                              "Set when changes are synced to disk",
+                              "durability <none|periodic|close|op> [interval_ms]"};
+    commands["writeback"] = {[this](const std::vector<std::string> &args) { this->writeback(args); },
+                             "Start or stop background writeback of dirty blocks",
+                             "writeback <on|off> [background_percent] [hard_percent] [expire_ms]"};
+    commands["directio"] = {[this](const std::vector<std::string> &args) { this->directio(args); },
+                            "Show or set the minimum aligned transfer that bypasses the buffer cache",
+                            "directio [off|blocks]"};
+    commands["delalloc"] = {[this](const std::vector<std::string> &args) { this->delalloc(args); },
+                            "Show or set delayed allocation of file data blocks until writeback",
+                            "delalloc [on|off]"};
+    commands["cache"] = {[this](const std::vector<std::string> &args) { this->cache(args); },
+                         "Show or set the buffer cache size and replacement policy",
+                         "cache [blocks] [lru|clock|2q|arc]"};
     commands["fopen"] = {[this](const std::vector<std::string> &args) { this->fopen(args); },
                          "Open a file",
                          "fopen <file_name>"};
@@ -71,6 +87,9 @@ Shell::Shell() {
     commands["fseek"] = {[this](const std::vector<std::string> &args) { this->fseek(args); },
                          "Move the file pointer",
                          "fseek <file_id> <offset>"};
+    commands["fallocate"] = {[this](const std::vector<std::string> &args) { this->fallocate(args); },
+                             "Preallocate contiguous blocks for a file, zero to also extend and zero it",
+                             "fallocate <file_id> <offset> <length> [zero]"};
     commands["fwrite"] = {[this](const std::vector<std::string> &args) { this->fwrite(args); },
                           "Write something to a file multiple times",
                           "fwrite <file_id> <data> [times]"};
@@ -89,7 +108,8 @@ Shell::Shell() {
 
 }
 
-void Shell::run() {
+template<typename G>
+void BasicShell<G>::run() {
     std::string input;
     while (is_active) {
         std::string current_dir = fs.get_current_dir();
@@ -100,7 +120,8 @@ void Shell::run() {
     }
 }
 
-void Shell::process_command(const std::string &input) {
+template<typename G>
+void BasicShell<G>::process_command(const std::string &input) {
     std::istringstream iss(input);
     std::string command;
     std::vector<std::string> args;
@@ -124,7 +145,8 @@ void Shell::process_command(const std::string &input) {
     }
 }
 
-void Shell::help() {
+template<typename G>
+void BasicShell<G>::help() {
     std::cout << "Available commands:\n";
     for (const auto &cmd: commands) {
         // 命令名以蓝色显示
@@ -137,17 +159,40 @@ void Shell::help() {
 }
 
 
-void Shell::exit_shell() {
+template<typename G>
+void BasicShell<G>::exit_shell() {
     is_active = false;
 }
 
-void Shell::format() {
+template<typename G>
+void BasicShell<G>::format(const std::vector<std::string> &args) {
+    auto allocation = ImageAllocation::SPARSE;
+    uint32_t block_size = G::BLOCK_SIZE;
+    for (const auto &arg: args) {
+        if (arg == "prealloc") {
+            allocation = ImageAllocation::PREALLOCATE;
+        } else if (arg == "sparse") {
+            allocation = ImageAllocation::SPARSE;
+        } else if (arg == std::to_string(Geometry512::BLOCK_SIZE) || arg == std::to_string(Geometry4K::BLOCK_SIZE)) {
+            block_size = std::stoul(arg);
+        } else {
+            throw std::runtime_error("Unknown format mode or block size: " + arg);
+        }
+    }
+    if (block_size != G::BLOCK_SIZE) {
+        // 几何参数是编译期的，交给main换用另一种Shell格式化
+        reformat_block_size = block_size;
+        reformat_args = args;
+        is_active = false;
+        return;
+    }
     std::cout << "Formatting disk..." << std::endl;
-    fs.format();
-    std::cout << "Disk formatted." << std::endl;
+    fs.format(allocation);
+    std::cout << "Disk formatted, block size " << G::BLOCK_SIZE << " bytes." << std::endl;
 }
 
-void Shell::ls() {
+template<typename G>
+void BasicShell<G>::ls() {
     auto entries = fs.ls();
     size_t terminal_width, terminal_height;
     COMMON::get_terminal_size(&terminal_width, &terminal_height);
@@ -175,7 +220,8 @@ void Shell::ls() {
         std::cout << std::endl;
 }
 
-void Shell::echo(const std::vector<std::string> &args) {
+template<typename G>
+void BasicShell<G>::echo(const std::vector<std::string> &args) {
     // std::string message, int count
     std::string message;
     int count;
@@ -195,7 +241,8 @@ void Shell::echo(const std::vector<std::string> &args) {
     }
 }
 
-void Shell::mkdir(const std::vector<std::string> &args) {
+template<typename G>
+void BasicShell<G>::mkdir(const std::vector<std::string> &args) {
     if (args.empty()) {
         std::cout << "Usage: mkdir <dir_name>" << std::endl;
         return;
@@ -203,7 +250,8 @@ void Shell::mkdir(const std::vector<std::string> &args) {
     fs.mkdir(args[0]);
 }
 
-void Shell::cd(const std::vector<std::string> &vector) {
+template<typename G>
+void BasicShell<G>::cd(const std::vector<std::string> &vector) {
     if (vector.empty()) {
         std::cout << "Usage: cd <dir>" << std::endl;
         return;
@@ -211,11 +259,13 @@ void Shell::cd(const std::vector<std::string> &vector) {
     fs.cd(vector[0]);
 }
 
-void Shell::init() {
+template<typename G>
+void BasicShell<G>::init() {
     fs.init();
 }
 
-void Shell::touch(const std::vector<std::string> &vector) {
+template<typename G>
+void BasicShell<G>::touch(const std::vector<std::string> &vector) {
     if (vector.empty()) {
         std::cout << "Usage: touch <file_name>" << std::endl;
         return;
@@ -223,7 +273,8 @@ void Shell::touch(const std::vector<std::string> &vector) {
     fs.touch(vector[0]);
 }
 
-void Shell::rm(const std::vector<std::string> &vector) {
+template<typename G>
+void BasicShell<G>::rm(const std::vector<std::string> &vector) {
     if (vector.empty()) {
         std::cout << "Usage: rm <file_name>" << std::endl;
         return;
@@ -231,7 +282,8 @@ void Shell::rm(const std::vector<std::string> &vector) {
     fs.rm(vector[0]);
 }
 
-void Shell::fopen(const std::vector<std::string> &vector) {
+template<typename G>
+void BasicShell<G>::fopen(const std::vector<std::string> &vector) {
     if (vector.empty()) {
         std::cout << "Usage: fopen <file_name>" << std::endl;
         return;
@@ -240,7 +292,8 @@ void Shell::fopen(const std::vector<std::string> &vector) {
     std::cout << "[" << blue << fd << reset << "]" << std::endl;
 }
 
-void Shell::fclose(const std::vector<std::string> &vector) {
+template<typename G>
+void BasicShell<G>::fclose(const std::vector<std::string> &vector) {
     if (vector.empty()) {
         std::cout << "Usage: fclose <file_id>" << std::endl;
         return;
@@ -254,7 +307,8 @@ void Shell::fclose(const std::vector<std::string> &vector) {
     fs.fclose(fd);
 }
 
-void Shell::fseek(const std::vector<std::string> &vector) {
+template<typename G>
+void BasicShell<G>::fseek(const std::vector<std::string> &vector) {
     if (vector.size() < 2) {
         std::cout << "Usage: fseek <file_id> <offset>" << std::endl;
         return;
@@ -269,7 +323,25 @@ void Shell::fseek(const std::vector<std::string> &vector) {
     fs.fseek(fd, offset);
 }
 
-void Shell::fwrite(const std::vector<std::string> &vector) {
+template<typename G>
+void BasicShell<G>::fallocate(const std::vector<std::string> &vector) {
+    if (vector.size() < 3 || (vector.size() > 3 && vector[3] != "zero")) {
+        std::cout << "Usage: fallocate <file_id> <offset> <length> [zero]" << std::endl;
+        return;
+    }
+    uint32_t fd, offset, length;
+    try {
+        fd = std::stoi(vector[0]);
+        offset = std::stoul(vector[1]);
+        length = std::stoul(vector[2]);
+    } catch (...) {
+        throw std::runtime_error("Invalid file id, offset or length");
+    }
+    fs.fallocate(fd, offset, length, vector.size() > 3);
+}
+
+template<typename G>
+void BasicShell<G>::fwrite(const std::vector<std::string> &vector) {
     if (vector.size() < 2) {
         std::cout << "Usage: fwrite <file_id> <data> [times]" << std::endl;
         return;
@@ -290,7 +362,8 @@ void Shell::fwrite(const std::vector<std::string> &vector) {
     fs.fwrite(fd, ss.str().c_str(), ss.str().size());
 }
 
-void Shell::cat(const std::vector<std::string> &vector) {
+template<typename G>
+void BasicShell<G>::cat(const std::vector<std::string> &vector) {
     if (vector.empty()) {
         std::cout << "Usage: cat <file_name>" << std::endl;
         return;
@@ -299,14 +372,102 @@ void Shell::cat(const std::vector<std::string> &vector) {
     std::cout << content << std::endl;
 }
 
-void Shell::flist() {
+template<typename G>
+void BasicShell<G>::flist() {
     auto files = fs.flist();
     for (const auto &file: files) {
         std::cout << "[" << blue << file.first << reset << "] " << file.second << std::endl;
     }
 }
 
-void Shell::upload(const std::vector<std::string> &vector) {
+template<typename G>
+void BasicShell<G>::durability(const std::vector<std::string> &vector) {
+    if (vector.empty()) {
+        std::cout << "Usage: durability <none|periodic|close|op> [interval_ms]" << std::endl;
+        return;
+    }
+    const std::map<std::string, Durability> policies = {
+            {"none",     Durability::NONE},
+            {"periodic", Durability::PERIODIC},
+            {"close",    Durability::ON_CLOSE},
+            {"op",       Durability::PER_OP},
+    };
+    auto it = policies.find(vector[0]);
+    if (it == policies.end()) {
+        throw std::runtime_error("Unknown durability policy: " + vector[0]);
+    }
+    auto interval = vector.size() > 1 ? std::stoi(vector[1]) : DEFAULT_COMMIT_INTERVAL_MS;
+    fs.set_durability(it->second, std::chrono::milliseconds(interval));
+}
+
+template<typename G>
+void BasicShell<G>::writeback(const std::vector<std::string> &vector) {
+    if (vector.empty() || (vector[0] != "on" && vector[0] != "off")) {
+        std::cout << "Usage: writeback <on|off> [background_percent] [hard_percent] [expire_ms]" << std::endl;
+        return;
+    }
+    if (vector[0] == "off") {
+        fs.stop_writeback();
+        return;
+    }
+    auto background = vector.size() > 1 ? std::stoul(vector[1]) : DIRTY_BACKGROUND_PERCENT;
+    auto hard = vector.size() > 2 ? std::stoul(vector[2]) : DIRTY_HARD_PERCENT;
+    auto expire = vector.size() > 3 ? std::stoi(vector[3]) : DIRTY_EXPIRE_MS;
+    fs.start_writeback(background, hard, std::chrono::milliseconds(expire));
+}
+
+template<typename G>
+void BasicShell<G>::directio(const std::vector<std::string> &vector) {
+    if (!vector.empty()) {
+        fs.set_direct_io_threshold(vector[0] == "off" ? 0 : std::stoul(vector[0]));
+    }
+    if (fs.direct_io_threshold() == 0) {
+        std::cout << "off" << std::endl;
+        return;
+    }
+    std::cout << fs.direct_io_threshold() << " blocks, "
+              << COMMON::formatBytes((size_t) fs.direct_io_threshold() * BasicFileSystem<G>::block_size()) << std::endl;
+}
+
+template<typename G>
+void BasicShell<G>::delalloc(const std::vector<std::string> &vector) {
+    if (!vector.empty()) {
+        if (vector[0] != "on" && vector[0] != "off") {
+            std::cout << "Usage: delalloc [on|off]" << std::endl;
+            return;
+        }
+        fs.set_delayed_allocation(vector[0] == "on");
+    }
+    std::cout << (fs.delayed_allocation() ? "on" : "off") << std::endl;
+}
+
+template<typename G>
+void BasicShell<G>::cache(const std::vector<std::string> &vector) {
+    const std::map<std::string, CachePolicy> policies = {
+            {"lru",   CachePolicy::LRU},
+            {"clock", CachePolicy::CLOCK},
+            {"2q",    CachePolicy::TWO_Q},
+            {"arc",   CachePolicy::ARC},
+    };
+    for (const auto &arg: vector) {
+        auto it = policies.find(arg);
+        if (it != policies.end()) {
+            fs.set_cache_policy(it->second);
+        } else {
+            fs.set_cache_capacity(std::stoul(arg));
+        }
+    }
+    std::string policy_name;
+    for (const auto &[name, policy]: policies) {
+        if (policy == fs.cache_policy()) policy_name = name;
+    }
+    std::cout << fs.cache_capacity() << " blocks, "
+              << COMMON::formatBytes((size_t) fs.cache_capacity() * BasicFileSystem<G>::block_size()) << ", "
+              << policy_name << std::endl;
+}
+
+template<typename G>
+void BasicShell<G>::upload(const std::vector<std::string> &vector) {
     if (vector.size() < 2) {
         std::cout << "Usage: upload <path_in_system> <real_file_path>" << std::endl;
         return;
@@ -334,7 +495,8 @@ void Shell::upload(const std::vector<std::string> &vector) {
     fs.fclose(fd);
 }
 
-void Shell::download(const std::vector<std::string> &vector) {
+template<typename G>
+void BasicShell<G>::download(const std::vector<std::string> &vector) {
     if (vector.size() < 2) {
         std::cout << "Usage: download <path_in_system> <real_file_path>" << std::endl;
         return;
@@ -356,3 +518,6 @@ void Shell::download(const std::vector<std::string> &vector) {
     file.write(buffer.data(), size);
     fs.fclose(fd);
 }
+
+template class BasicShell<Geometry512>;
+template class BasicShell<Geometry4K>;
@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include "fs/BlockAllocator.hpp"
+
+// 位图填充到不同比例时，分配一个Block（或一段连续Block、一个Inode）再释放的平均耗时
+// random: 随机填充，分配游标last_i一直向后移动，是正常使用时的情况
+// front: 位图前一部分全部占满，每次都从头开始找（last_i为0），是一次分配最坏要扫过的位数
+// SuperBlock直接扫描位图，BlockAllocator先查空闲空间摘要，两者分别测量
+// fragmented: 空闲空间是长度1~16的零碎空洞，连续分配一批8块而不释放，比较位图扫描与空闲区间的最佳、下次适配
+// 每项重复3次取最快的一次
+// 用法: Bench_Bitmap [random的次数] [front的次数] [fragmented的次数]
+
+using Clock = std::chrono::steady_clock;
+
+static double best_ns(const uint32_t &ops, const std::function<void()> &op) {
+    double best = 0;
+    for (int repeat = 0; repeat < 3; repeat++) {
+        auto start = Clock::now();
+        for (uint32_t i = 0; i < ops; i++) {
+            op();
+        }
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops;
+        best = repeat == 0 ? ns : std::min(best, ns);
+    }
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t random_ops = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    uint32_t front_ops = argc > 2 ? std::stoul(argv[2]) : 2000;
+    uint32_t fragmented_ops = argc > 3 ? std::stoul(argv[3]) : 500;
+    const uint32_t start_index = Geometry512::BLOCK_START_INDEX;
+
+    std::cout << std::setw(6) << "fill" << std::setw(14) << "random(ns)" << std::setw(14) << "front(ns)"
+              << std::setw(14) << "run of 8(ns)" << std::setw(14) << "inode(ns)" << std::setw(16) << "alloc random"
+              << std::setw(14) << "alloc front" << std::setw(14) << "alloc run 8" << std::endl;
+    for (int fill: {0, 50, 90, 99}) {
+        auto sb = std::make_unique<SuperBlock>();
+        std::mt19937 rng(fill);
+        for (uint32_t i = 1; i < sb->block_count; i++) {
+            if (rng() % 100 < (uint32_t) fill) {
+                sb->block_bitmap.set(i);
+            }
+        }
+        double random = best_ns(random_ops, [&] {
+            sb->block_bitmap.reset(sb->get_free_block() - start_index);
+        });
+        BasicBlockAllocator<Geometry512> random_allocator(*sb);
+        double alloc_random = best_ns(random_ops, [&] {
+            random_allocator.free_block(random_allocator.get_free_block());
+        });
+
+        sb = std::make_unique<SuperBlock>();
+        const uint32_t full_blocks = (uint64_t) sb->block_count * fill / 100;
+        for (uint32_t i = 1; i < full_blocks; i++) {
+            sb->block_bitmap.set(i);
+        }
+        const uint32_t full_inodes = (uint64_t) sb->inode_count * fill / 100;
+        for (uint32_t i = 1; i < full_inodes; i++) {
+            sb->inode_bitmap.set(i);
+        }
+        double front = best_ns(front_ops, [&] {
+            sb->last_i = 0;
+            sb->block_bitmap.reset(sb->get_free_block() - start_index);
+        });
+        double run = best_ns(front_ops, [&] {
+            auto first = sb->get_free_blocks(8) - start_index;
+            for (uint32_t i = first; i < first + 8; i++) {
+                sb->block_bitmap.reset(i);
+            }
+        });
+        double inode = best_ns(random_ops, [&] {
+            sb->inode_bitmap.reset(sb->get_free_inode());
+        });
+        BasicBlockAllocator<Geometry512> front_allocator(*sb);
+        double alloc_front = best_ns(random_ops, [&] {
+            sb->last_i = 0;
+            front_allocator.free_block(front_allocator.get_free_block());
+        });
+        double alloc_run = best_ns(random_ops, [&] {
+            auto first = front_allocator.get_free_blocks(8);
+            for (uint32_t i = first; i < first + 8; i++) {
+                front_allocator.free_block(i);
+            }
+        });
+
+        std::cout << std::fixed << std::setprecision(1) << std::setw(5) << fill << "%" << std::setw(14) << random
+                  << std::setw(14) << front << std::setw(14) << run << std::setw(14) << inode
+                  << std::setw(16) << alloc_random << std::setw(14) << alloc_front << std::setw(14) << alloc_run
+                  << std::endl;
+    }
+
+    std::cout << std::endl << std::setw(6) << "fill" << std::setw(14) << "extents" << std::setw(14) << "scan(ns)"
+              << std::setw(14) << "best(ns)" << std::setw(14) << "next(ns)" << std::endl;
+    for (int fill: {50, 90, 99}) {
+        // 空洞长度1~16，平均8.5，已分配的段按占用率取平均长度
+        auto fragmented = std::make_unique<SuperBlock>();
+        std::mt19937 rng(fill);
+        const uint32_t used_mean = 17 * fill / (100 - fill);
+        uint32_t i = 1;
+        while (i < fragmented->block_count) {
+            uint32_t used = 1 + rng() % (2 * used_mean), hole = 1 + rng() % 16;
+            for (uint32_t j = i; j < std::min(i + used, fragmented->block_count); j++) {
+                fragmented->block_bitmap.set(j);
+            }
+            i += used + hole;
+        }
+        size_t extents = BasicBlockAllocator<Geometry512>(*fragmented).free_extents().size();
+
+        // 每次从同一个初始状态开始，连续分配fragmented_ops次，分配器的构造（重建索引）不计入
+        auto batch = [&](const bool &scan, const Fit &fit) {
+            double best = 0;
+            for (int repeat = 0; repeat < 3; repeat++) {
+                auto sb = std::make_unique<SuperBlock>(*fragmented);
+                BasicBlockAllocator<Geometry512> allocator(*sb);
+                auto start = Clock::now();
+                for (uint32_t op = 0; op < fragmented_ops; op++) {
+                    scan ? sb->get_free_blocks(8) : allocator.get_free_blocks(8, fit);
+                }
+                double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / fragmented_ops;
+                best = repeat == 0 ? ns : std::min(best, ns);
+            }
+            return best;
+        };
+        double scan = batch(true, Fit::BEST);
+        double best = batch(false, Fit::BEST);
+        double next = batch(false, Fit::NEXT);
+
+        std::cout << std::fixed << std::setprecision(1) << std::setw(5) << fill << "%" << std::setw(14) << extents
+                  << std::setw(14) << scan << std::setw(14) << best << std::setw(14) << next << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "fs/BufferPool.hpp"
+
+// 用访问序列（盘块号）回放不同的负载，比较各替换策略的命中率
+// 用法: Bench_CachePolicy [缓存块数量]
+
+using BufferPool = BasicBufferPool<Geometry512>;
+
+// 元数据（目录、Inode、索引块）：访问集中在少数块上，按Zipf分布
+class MetadataTrace {
+public:
+    MetadataTrace(const uint32_t &blocks, const double &skew, const uint32_t &seed)
+            : _rng(seed) {
+        std::vector<double> weights;
+        for (uint32_t i = 1; i <= blocks; i++) {
+            weights.push_back(1.0 / std::pow(i, skew));
+        }
+        _distribution = std::discrete_distribution<uint32_t>(weights.begin(), weights.end());
+    }
+
+    // 元数据块编号从1开始，和数据块分开
+    uint32_t next() {
+        return 1 + _distribution(_rng);
+    }
+
+private:
+    std::mt19937 _rng;
+    std::discrete_distribution<uint32_t> _distribution;
+};
+
+static std::vector<uint32_t> metadata_only(const uint32_t &capacity) {
+    MetadataTrace metadata(capacity * 4, 0.9, 1);
+    std::vector<uint32_t> trace;
+    for (uint32_t i = 0; i < capacity * 200; i++) {
+        trace.push_back(metadata.next());
+    }
+    return trace;
+}
+
+// 反复上传新的大文件：每个数据块只访问一次
+static std::vector<uint32_t> streaming_only(const uint32_t &capacity) {
+    std::vector<uint32_t> trace;
+    for (uint32_t i = 0; i < capacity * 200; i++) {
+        trace.push_back(1000000 + i);
+    }
+    return trace;
+}
+
+// 交互使用：cd、ls等元数据操作之间穿插大文件上传（每次上传是缓存的4倍）
+static std::vector<uint32_t> mixed(const uint32_t &capacity) {
+    MetadataTrace metadata(capacity / 2, 0.6, 2);
+    std::vector<uint32_t> trace;
+    uint32_t next_data_block = 1000000;
+    for (int round = 0; round < 50; round++) {
+        for (uint32_t i = 0; i < capacity * 2; i++) {
+            trace.push_back(metadata.next());
+        }
+        for (uint32_t i = 0; i < capacity * 4; i++) {
+            trace.push_back(next_data_block++);
+        }
+    }
+    return trace;
+}
+
+// 循环读取一个比缓存稍大的文件：LRU总是换出下一个要用的块
+static std::vector<uint32_t> looping(const uint32_t &capacity) {
+    std::vector<uint32_t> trace;
+    for (int round = 0; round < 100; round++) {
+        for (uint32_t i = 0; i < capacity + capacity / 4; i++) {
+            trace.push_back(1000000 + i);
+        }
+    }
+    return trace;
+}
+
+// 回放访问序列，返回命中率
+static double replay(BufferPool &pool, const std::vector<uint32_t> &trace) {
+    uint64_t hits = 0;
+    for (auto block_no: trace) {
+        if (pool.lookup(block_no) != nullptr) {
+            hits++;
+        } else {
+            pool.insert(pool.take(block_no), block_no);
+        }
+    }
+    return (double) hits / trace.size();
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t capacity = argc > 1 ? std::stoul(argv[1]) : Geometry512::CACHE_BLOCK_NUM;
+
+    const std::pair<CachePolicy, const char *> policies[] = {
+            {CachePolicy::LRU,   "lru"},
+            {CachePolicy::CLOCK, "clock"},
+            {CachePolicy::TWO_Q, "2q"},
+            {CachePolicy::ARC,   "arc"},
+    };
+    const std::pair<std::vector<uint32_t> (*)(const uint32_t &), const char *> workloads[] = {
+            {metadata_only,  "metadata"},
+            {streaming_only, "streaming"},
+            {mixed,          "mixed"},
+            {looping,        "looping"},
+    };
+
+    std::cout << capacity << " cache blocks, hit ratio (ns per access)" << std::endl;
+    std::cout << std::left << std::setw(12) << "";
+    for (const auto &[policy, name]: policies) {
+        std::cout << std::setw(20) << name;
+    }
+    std::cout << std::endl;
+
+    for (const auto &[generate, workload_name]: workloads) {
+        auto trace = generate(capacity);
+        std::cout << std::left << std::setw(12) << workload_name;
+        for (const auto &[policy, name]: policies) {
+            BufferPool pool(capacity, policy);
+            auto start = std::chrono::steady_clock::now();
+            double hit_ratio = replay(pool, trace);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::ostringstream cell;
+            cell << std::fixed << std::setprecision(2) << hit_ratio * 100 << "% ("
+                 << std::setprecision(0) << seconds * 1e9 / trace.size() << ")";
+            std::cout << std::setw(20) << cell.str();
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
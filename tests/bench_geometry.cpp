@@ -0,0 +1,58 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "fs/FileSystem.hpp"
+#include "common/common.hpp"
+
+// 同一个程序中的两种几何参数：512字节块与4KiB块，写入文件、删除后再写入一次，然后读出
+// 用法: Bench_Geometry [文件大小(MB)]
+
+template<typename G>
+static double run(const std::string &disk_path, const std::string &data, DiskStats &stats) {
+    auto start = std::chrono::steady_clock::now();
+    {
+        BasicFileSystem<G> fs(DiskMode::POSIX, disk_path);
+        fs.format();
+        fs.touch("a");
+
+        auto fd = fs.fopen("a");
+        fs.fwrite(fd, data.data(), data.size());
+        fs.fclose(fd);
+
+        fs.rm("a");
+
+        fs.touch("a");
+        fd = fs.fopen("a");
+        fs.fwrite(fd, data.data(), data.size());
+        fs.fseek(fd, 0);
+        std::string buffer(data.size(), '\0');
+        fs.fread(fd, buffer.data(), buffer.size());
+        fs.fclose(fd);
+        if (buffer != data) {
+            throw std::runtime_error("Read back data mismatch");
+        }
+        fs.save();
+        stats = fs.disk_stats();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+template<typename G>
+static void report(const char *name, const std::string &disk_path, const std::string &data) {
+    DiskStats stats;
+    double seconds = run<G>(disk_path, data, stats);
+    std::cout << std::left << std::setw(8) << name
+              << std::fixed << std::setprecision(2) << seconds << " s, "
+              << COMMON::formatBytes((size_t) (3 * data.size() / seconds)) << "/s, "
+              << stats.read_calls << " reads, " << stats.write_calls << " writes" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    size_t size_mb = argc > 1 ? std::stoul(argv[1]) : 256;
+    std::string data(size_mb << 20, 'a');
+
+    report<Geometry512>("512B", "disk_bench_512.img", data);
+    report<Geometry4K>("4KiB", "disk_bench_4k.img", data);
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "fs/FileSystem.hpp"
+
+// 反复读取大文件末尾（三次间接索引范围内）的一段热点数据，每次4KB，统计每次fread的平均耗时
+// 热点数据一直在缓存中，耗时主要是查找缓存块；重复5次取最快的一次
+// 用法: Bench_PageCache [文件大小(MB)] [热点大小(KB)] [轮数] [缓存块数量]
+
+int main(int argc, char *argv[]) {
+    size_t size_mb = argc > 1 ? std::stoul(argv[1]) : 24;
+    uint32_t hot_kb = argc > 2 ? std::stoul(argv[2]) : 128;
+    uint32_t rounds = argc > 3 ? std::stoul(argv[3]) : 20000;
+    uint32_t cache_blocks = argc > 4 ? std::stoul(argv[4]) : Geometry512::CACHE_BLOCK_NUM;
+    const uint32_t chunk = 4096;
+    std::string data(size_mb << 20, 'a');
+
+    FileSystem fs(DiskMode::POSIX);
+    fs.format();
+    fs.set_cache_capacity(cache_blocks);
+    fs.touch("a");
+    auto fd = fs.fopen("a");
+    fs.fwrite(fd, data.data(), data.size());
+
+    const uint32_t hot_start = data.size() - hot_kb * 1024;
+    char buffer[chunk];
+    uint64_t calls = 0;
+    double best = 0;
+    for (int repeat = 0; repeat < 5; repeat++) {
+        calls = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t round = 0; round < rounds; round++) {
+            fs.fseek(fd, hot_start);
+            for (uint32_t offset = 0; offset < hot_kb * 1024; offset += chunk) {
+                fs.fread(fd, buffer, chunk);
+                calls++;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = repeat == 0 ? seconds : std::min(best, seconds);
+    }
+    double seconds = best;
+    fs.fclose(fd);
+
+    std::cout << std::fixed << std::setprecision(2) << calls << " freads of " << chunk << " bytes, "
+              << seconds * 1e9 / calls << " ns per fread, "
+              << (double) calls * chunk / seconds / (1 << 30) << " GiB/s" << std::endl;
+    return 0;
+}
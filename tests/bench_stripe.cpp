@@ -0,0 +1,59 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "fs/FileSystem.hpp"
+#include "common/common.hpp"
+
+// 比较1、2、4个条带的顺序读写吞吐量：写入一个大文件并持久化，重新挂载后读出
+// 用法: Bench_Stripe [文件大小(MB)] [条带单元(盘块数)]
+
+static double seconds_since(const std::chrono::steady_clock::time_point &start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void run(const uint32_t &stripes, const uint32_t &stripe_blocks, const std::string &data) {
+    std::vector<std::string> paths;
+    for (uint32_t i = 0; i < stripes; i++) {
+        paths.push_back("disk_bench_stripe_" + std::to_string(i) + ".img");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        FileSystem fs(DiskMode::URING, paths, stripe_blocks);
+        fs.format();
+        fs.touch("a");
+        auto fd = fs.fopen("a");
+        fs.fwrite(fd, data.data(), data.size());
+        fs.fclose(fd);
+        fs.save();
+    }
+    double write_seconds = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    {
+        FileSystem fs(DiskMode::URING, paths, stripe_blocks);
+        std::string buffer(data.size(), '\0');
+        auto fd = fs.fopen("a");
+        fs.fread(fd, buffer.data(), buffer.size());
+        fs.fclose(fd);
+        if (buffer != data) {
+            throw std::runtime_error("Read back data mismatch");
+        }
+    }
+    double read_seconds = seconds_since(start);
+
+    std::cout << stripes << " stripe(s): write " << std::fixed << std::setprecision(2) << write_seconds << " s, "
+              << COMMON::formatBytes((size_t) (data.size() / write_seconds)) << "/s; read " << read_seconds << " s, "
+              << COMMON::formatBytes((size_t) (data.size() / read_seconds)) << "/s" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    size_t size_mb = argc > 1 ? std::stoul(argv[1]) : 256;
+    uint32_t stripe_blocks = argc > 2 ? std::stoul(argv[2]) : DEFAULT_STRIPE_BLOCKS;
+    std::string data(size_mb << 20, 'a');
+
+    for (uint32_t stripes: {1, 2, 4}) {
+        run(stripes, stripe_blocks, data);
+    }
+    return 0;
+}
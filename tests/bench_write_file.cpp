@@ -0,0 +1,53 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "fs/FileSystem.hpp"
+#include "common/common.hpp"
+
+// 与 Test_WriteFile 相同的负载：写入768MB文件，删除后再写入一次，比较不同磁盘后端的吞吐量
+// 用法: Bench_WriteFile [文件大小(MB)]
+
+static double run(DiskMode mode, const std::string &data, DiskStats &stats) {
+    auto start = std::chrono::steady_clock::now();
+    {
+        FileSystem fs(mode);
+        fs.format();
+        fs.touch("a");
+
+        auto fd = fs.fopen("a");
+        fs.fwrite(fd, data.data(), data.size());
+        fs.fclose(fd);
+
+        fs.rm("a");
+
+        fs.touch("a");
+        fd = fs.fopen("a");
+        fs.fwrite(fd, data.data(), data.size());
+        fs.fclose(fd);
+        fs.save();
+        stats = fs.disk_stats();
+    } // 析构时save()，包含最终的sync
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    size_t size_mb = argc > 1 ? std::stoul(argv[1]) : 768;
+    std::string data(size_mb << 20, 'a');
+
+    const std::pair<DiskMode, const char *> modes[] = {
+            {DiskMode::STREAM, "stream"},
+            {DiskMode::POSIX,  "posix"},
+            {DiskMode::MMAP,   "mmap"},
+            {DiskMode::URING,  "uring"},
+    };
+    for (const auto &[mode, name]: modes) {
+        DiskStats stats;
+        double seconds = run(mode, data, stats);
+        std::cout << std::left << std::setw(8) << name
+                  << std::fixed << std::setprecision(2) << seconds << " s, "
+                  << COMMON::formatBytes((size_t) (2 * data.size() / seconds)) << "/s, "
+                  << stats.read_calls << " reads, " << stats.write_calls << " writes" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "fs/FileSystem.hpp"
+#include "common/common.hpp"
+
+// 比较有无后台写回时每次fwrite的延迟分布：按64KB分块写入一个大文件
+// 用法: Bench_Writeback [文件大小(MB)] [缓存块数量]
+
+static void run(const bool &writeback, const std::string &data, const uint32_t &cache_blocks) {
+    const uint32_t chunk = 64 * 1024;
+    std::vector<double> latencies;
+    auto start = std::chrono::steady_clock::now();
+    {
+        FileSystem fs(DiskMode::POSIX);
+        fs.format();
+        fs.set_cache_capacity(cache_blocks);
+        if (writeback) {
+            fs.start_writeback();
+        }
+        fs.touch("a");
+        auto fd = fs.fopen("a");
+        for (uint32_t offset = 0; offset < data.size(); offset += chunk) {
+            auto call_start = std::chrono::steady_clock::now();
+            fs.fwrite(fd, data.data() + offset, chunk);
+            latencies.push_back(std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - call_start).count());
+        }
+        fs.fclose(fd);
+        fs.save();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](const double &p) {
+        return latencies[std::min(latencies.size() - 1, (size_t) (p * latencies.size()))];
+    };
+    std::cout << std::left << std::setw(12) << (writeback ? "writeback" : "eviction")
+              << std::fixed << std::setprecision(0)
+              << "p50 " << percentile(0.5) << " us, p99 " << percentile(0.99) << " us, max " << latencies.back()
+              << " us, " << COMMON::formatBytes((size_t) (data.size() / seconds)) << "/s" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    size_t size_mb = argc > 1 ? std::stoul(argv[1]) : 256;
+    uint32_t cache_blocks = argc > 2 ? std::stoul(argv[2]) : 16384;
+    std::string data(size_mb << 20, 'a');
+
+    run(false, data, cache_blocks);
+    run(true, data, cache_blocks);
+    return 0;
+}
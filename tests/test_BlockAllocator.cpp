@@ -0,0 +1,208 @@
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include <gtest/gtest.h>
+#include "fs/BlockAllocator.hpp"
+
+using BlockAllocator = BasicBlockAllocator<Geometry512>;
+
+static constexpr uint32_t START = Geometry512::BLOCK_START_INDEX;
+
+// 两级位图：查找跨过多个全0的字和组
+TEST(BlockAllocatorTest, SummaryBitmap) {
+    SummaryBitmap<32768> summary;
+    EXPECT_EQ(summary.find_one(0, 32768), summary.NPOS);
+    summary.set(5);
+    summary.set(20000);
+    EXPECT_EQ(summary.find_one(0, 32768), 5);
+    EXPECT_EQ(summary.find_one(6, 32768), 20000);
+    EXPECT_EQ(summary.find_one(6, 20000), summary.NPOS);
+    summary.reset(20000);
+    EXPECT_EQ(summary.find_one(6, 32768), summary.NPOS);
+    EXPECT_EQ(summary.find_zero(5, 32768), 6);
+    EXPECT_EQ(summary.count(), 1);
+}
+
+// 单块分配与SuperBlock::get_free_block的结果相同，包括回绕和不使用0号数据块
+TEST(BlockAllocatorTest, SameAsSuperBlock) {
+    auto expected = std::make_unique<SuperBlock>();
+    std::srand(21);
+    for (uint32_t i = 1; i < Geometry512::BLOCK_COUNT; i++) {
+        if (std::rand() % 100 < 95) {
+            expected->block_bitmap.set(i);
+        }
+    }
+    expected->last_i = Geometry512::BLOCK_COUNT - 5000;
+    auto actual = std::make_unique<SuperBlock>(*expected);
+    BlockAllocator allocator(*actual);
+
+    for (int round = 0; round < 1000; round++) {
+        auto block_no = expected->get_free_block();
+        ASSERT_EQ(allocator.get_free_block(), block_no);
+        ASSERT_EQ(actual->last_i, expected->last_i);
+        if (round % 3 == 0) {
+            expected->block_bitmap.reset(block_no - START);
+            allocator.free_block(block_no);
+        }
+    }
+    EXPECT_EQ(actual->block_bitmap.count(), expected->block_bitmap.count());
+}
+
+// 位图满时抛出异常，释放后又能分配到
+TEST(BlockAllocatorTest, Full) {
+    auto sb = std::make_unique<SuperBlock>();
+    sb->block_bitmap.set_range(1, Geometry512::BLOCK_COUNT - 1);
+    BlockAllocator allocator(*sb);
+    EXPECT_THROW(allocator.get_free_block(), std::runtime_error);
+    EXPECT_THROW(allocator.get_free_blocks(1), std::runtime_error);
+
+    allocator.free_block(START + 123456);
+    sb->last_i = 200000;
+    EXPECT_EQ(allocator.get_free_block(), START + 123456);
+    EXPECT_EQ(sb->last_i, 123457);
+    EXPECT_THROW(allocator.get_free_block(), std::runtime_error);
+}
+
+// 空闲区间的合并、拆分和两种适配方式
+TEST(BlockAllocatorTest, FreeExtents) {
+    FreeExtents extents;
+    extents.insert(100, 10);
+    extents.insert(200, 5);
+    extents.insert(300, 50);
+    EXPECT_EQ(extents.size(), 3);
+    EXPECT_EQ(extents.largest(), 50);
+
+    EXPECT_EQ(extents.best_fit(5), 200);
+    EXPECT_EQ(extents.best_fit(6), 100);
+    EXPECT_EQ(extents.best_fit(51), extents.NPOS);
+    EXPECT_EQ(extents.next_fit(5, 0), 100);
+    EXPECT_EQ(extents.next_fit(5, 103), 103);
+    EXPECT_EQ(extents.next_fit(8, 103), 300);
+    EXPECT_EQ(extents.next_fit(10, 320), 320);
+    EXPECT_EQ(extents.next_fit(40, 320), 300);
+    EXPECT_EQ(extents.next_fit(6, 400), 100);
+
+    // 从中间取出一段，剩下两段
+    extents.remove(320, 10);
+    EXPECT_EQ(extents.size(), 4);
+    EXPECT_EQ(extents.largest(), 20);
+    EXPECT_THROW(extents.remove(325, 1), std::logic_error);
+    EXPECT_THROW(extents.remove(105, 10), std::logic_error);
+
+    // 放回后与两边合并
+    extents.insert(320, 10);
+    EXPECT_EQ(extents.size(), 3);
+    extents.insert(110, 90);
+    EXPECT_EQ(extents.size(), 2);
+    EXPECT_EQ(extents.largest(), 105);
+    EXPECT_EQ(extents.begin()->first, 100);
+    EXPECT_EQ(extents.begin()->second, 105);
+}
+
+// 连续分配：最佳适配取能放下的最短空闲区间，下次适配从last_i向后找
+TEST(BlockAllocatorTest, Runs) {
+    auto sb = std::make_unique<SuperBlock>();
+    sb->block_bitmap.set_range(1, Geometry512::BLOCK_COUNT - 1);
+    for (uint32_t i = 1000; i < 1003; i++) {
+        sb->block_bitmap.reset(i);
+    }
+    for (uint32_t i = 70000; i < 70004; i++) {
+        sb->block_bitmap.reset(i);
+    }
+    for (uint32_t i = 500000; i < 600000; i++) {
+        sb->block_bitmap.reset(i);
+    }
+    BlockAllocator allocator(*sb);
+    EXPECT_EQ(allocator.free_extents().size(), 3);
+
+    EXPECT_EQ(allocator.get_free_blocks(4), START + 70000);
+    EXPECT_EQ(allocator.get_free_blocks(2), START + 1000);
+    EXPECT_EQ(allocator.get_free_blocks(2), START + 500000);
+    EXPECT_EQ(allocator.free_extents().size(), 2);
+
+    sb->last_i = 550000;
+    EXPECT_EQ(allocator.get_free_blocks(100, Fit::NEXT), START + 550000);
+    EXPECT_EQ(sb->last_i, 550100);
+    EXPECT_EQ(allocator.get_free_blocks(1, Fit::NEXT), START + 550100);
+    sb->last_i = 599990;
+    EXPECT_EQ(allocator.get_free_blocks(20, Fit::NEXT), START + 500002);
+    EXPECT_THROW(allocator.get_free_blocks(100000), std::runtime_error);
+
+    // 释放的块与相邻的空闲区间合并
+    for (uint32_t i = 0; i < 4; i++) {
+        allocator.free_block(START + 70000 + i);
+    }
+    allocator.free_block(START + 70000);
+    EXPECT_EQ(allocator.get_free_blocks(4), START + 70000);
+    for (uint32_t i = 0; i < 100; i++) {
+        allocator.free_block(START + 550000 + i);
+    }
+    EXPECT_EQ(allocator.free_extents().size(), 3);
+    EXPECT_EQ(allocator.free_extents().largest(), 50078);
+    EXPECT_EQ(allocator.get_free_blocks(50078), START + 500022);
+    EXPECT_FALSE(sb->block_bitmap.test(0));
+}
+
+// 随机分配、释放之后，空闲区间与位图一致
+TEST(BlockAllocatorTest, ExtentsMatchBitmap) {
+    auto sb = std::make_unique<SuperBlock>();
+    BlockAllocator allocator(*sb);
+    std::vector<uint32_t> allocated;
+    std::srand(22);
+    for (int round = 0; round < 20000; round++) {
+        int action = std::rand() % 4;
+        if (action == 0 && !allocated.empty()) {
+            auto index = std::rand() % allocated.size();
+            allocator.free_block(allocated[index]);
+            allocated[index] = allocated.back();
+            allocated.pop_back();
+        } else if (action == 1) {
+            uint32_t count = 1 + std::rand() % 40;
+            auto first = allocator.get_free_blocks(count, std::rand() % 2 ? Fit::BEST : Fit::NEXT);
+            for (uint32_t i = 0; i < count; i++) {
+                allocated.push_back(first + i);
+            }
+        } else {
+            allocated.push_back(allocator.get_free_block());
+        }
+    }
+    EXPECT_EQ(sb->block_bitmap.count(), allocated.size());
+
+    uint64_t free_blocks = 0;
+    uint32_t expected_end = 0;
+    for (auto [start, length]: allocator.free_extents()) {
+        EXPECT_GT(start, expected_end); // 相邻的区间已经合并
+        EXPECT_EQ(sb->block_bitmap.find_one(start, start + length), sb->block_bitmap.NPOS);
+        EXPECT_TRUE(start + length == Geometry512::BLOCK_COUNT || sb->block_bitmap.test(start + length));
+        free_blocks += length;
+        expected_end = start + length;
+    }
+    EXPECT_EQ(free_blocks, Geometry512::BLOCK_COUNT - 1 - allocated.size());
+}
+
+// 预留的块不能被其他分配占用，归还后才能分配
+TEST(BlockAllocatorTest, Reserve) {
+    auto sb = std::make_unique<SuperBlock>();
+    sb->block_bitmap.set_range(1, Geometry512::BLOCK_COUNT - 1);
+    for (uint32_t i = 1000; i < 1010; i++) {
+        sb->block_bitmap.reset(i);
+    }
+    BlockAllocator allocator(*sb);
+    EXPECT_EQ(allocator.free_count(), 10);
+
+    allocator.reserve(8);
+    EXPECT_EQ(allocator.free_count(), 2);
+    EXPECT_THROW(allocator.reserve(3), std::runtime_error);
+    EXPECT_THROW(allocator.get_free_blocks(3), std::runtime_error);
+    EXPECT_EQ(allocator.get_free_run(5).second, 2);
+    EXPECT_THROW(allocator.get_free_block(), std::runtime_error);
+
+    allocator.unreserve(8);
+    auto [first, length] = allocator.get_free_run(8);
+    EXPECT_EQ(first, START + 1002);
+    EXPECT_EQ(length, 8);
+    EXPECT_EQ(allocator.free_count(), 0);
+    allocator.free_blocks(first, length);
+    EXPECT_EQ(allocator.free_count(), 8);
+    EXPECT_THROW(allocator.unreserve(1), std::logic_error);
+}
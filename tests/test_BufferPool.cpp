@@ -0,0 +1,231 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <unordered_map>
+#include "fs/BufferPool.hpp"
+#include "fs/SlotList.hpp"
+
+using BufferPool = BasicBufferPool<Geometry512>;
+
+// 装满之后按最久未使用的顺序换出，命中会把缓存块移到队尾
+TEST(BufferPoolTest, LruOrder) {
+    BufferPool pool(4);
+    for (uint32_t block_no = 100; block_no < 104; block_no++) {
+        pool.insert(pool.take(block_no), block_no);
+    }
+    EXPECT_EQ(pool.size(), 4);
+    EXPECT_NE(pool.lookup(100), nullptr);
+
+    auto victim = pool.take(200);
+    EXPECT_EQ(victim->block_no, 101);
+    EXPECT_EQ(pool.find(101), nullptr);
+    pool.insert(victim, 200);
+
+    EXPECT_EQ(pool.take(300)->block_no, 102);
+    EXPECT_EQ(pool.find(200), victim);
+    EXPECT_NE(pool.find(100), nullptr);
+}
+
+// 随机插入和删除，与std::unordered_map对照，检验线性探测删除后的查找，以及各替换策略的队列维护
+TEST(BufferPoolTest, RandomAgainstMap) {
+    for (auto policy: {CachePolicy::LRU, CachePolicy::CLOCK, CachePolicy::TWO_Q, CachePolicy::ARC}) {
+        BufferPool pool(64, policy);
+        std::unordered_map<uint32_t, BufferCache *> expected;
+        std::mt19937 rng(42);
+        for (int i = 0; i < 20000; i++) {
+            // 盘块号集中在小范围内，制造大量冲突
+            uint32_t block_no = 1 + rng() % 256;
+            auto cache_block = pool.lookup(block_no);
+            auto it = expected.find(block_no);
+            ASSERT_EQ(cache_block, it == expected.end() ? nullptr : it->second);
+            if (cache_block != nullptr) {
+                if (rng() % 4 == 0) {
+                    pool.erase(cache_block);
+                    expected.erase(it);
+                }
+                continue;
+            }
+            auto taken = pool.take(block_no);
+            if (taken->block_no != 0) {
+                expected.erase(taken->block_no);
+            }
+            pool.insert(taken, block_no);
+            expected[block_no] = taken;
+            ASSERT_EQ(pool.size(), expected.size());
+        }
+        for (auto [block_no, cache_block]: expected) {
+            EXPECT_EQ(pool.find(block_no), cache_block);
+        }
+    }
+}
+
+// 热点块（如目录、Inode块）每轮访问两次，中间夹着比缓存更长的顺序扫描
+// LRU每轮都会丢失热点块；CLOCK只有一个访问位，能保住一部分；2Q和ARC在几轮之后能全部保住
+TEST(BufferPoolTest, ScanResistance) {
+    for (auto policy: {CachePolicy::LRU, CachePolicy::CLOCK, CachePolicy::TWO_Q, CachePolicy::ARC}) {
+        BufferPool pool(64, policy);
+        uint32_t next_scan_block = 1000;
+        uint32_t hot_misses = 0;
+        for (int round = 0; round < 50; round++) {
+            for (int pass = 0; pass < 2; pass++) {
+                for (uint32_t block_no = 1; block_no <= 16; block_no++) {
+                    if (pool.lookup(block_no) == nullptr) {
+                        pool.insert(pool.take(block_no), block_no);
+                        hot_misses += round >= 40;
+                    }
+                }
+            }
+            for (int i = 0; i < 60; i++, next_scan_block++) {
+                pool.insert(pool.take(next_scan_block), next_scan_block);
+            }
+        }
+        if (policy == CachePolicy::LRU) {
+            EXPECT_EQ(hot_misses, 10 * 16);
+        } else if (policy == CachePolicy::CLOCK) {
+            EXPECT_LT(hot_misses, 10 * 16);
+        } else {
+            EXPECT_EQ(hot_misses, 0) << static_cast<int>(policy);
+        }
+    }
+}
+
+// 改变容量后缓存被清空
+TEST(BufferPoolTest, Resize) {
+    BufferPool pool(16);
+    pool.insert(pool.take(10), 10);
+    pool.resize(100000);
+    EXPECT_EQ(pool.capacity(), 100000);
+    EXPECT_EQ(pool.size(), 0);
+    EXPECT_EQ(pool.find(10), nullptr);
+    for (uint32_t block_no = 1; block_no <= 100000; block_no++) {
+        pool.insert(pool.take(block_no), block_no);
+    }
+    EXPECT_EQ(pool.size(), 100000);
+    EXPECT_EQ(pool.find(54321)->block_no, 54321);
+}
+
+// 被钉住的块不会被换出，放开后回到队尾；所有块都被钉住时无法再装入
+TEST(BufferPoolTest, Pin) {
+    using BufferHandle = BasicBufferHandle<Geometry512>;
+    for (auto policy: {CachePolicy::LRU, CachePolicy::CLOCK, CachePolicy::TWO_Q, CachePolicy::ARC}) {
+        BufferPool pool(4, policy);
+        for (uint32_t block_no = 100; block_no < 104; block_no++) {
+            pool.insert(pool.take(block_no), block_no);
+        }
+        {
+            BufferHandle first(pool, pool.find(100));
+            BufferHandle again(pool, pool.find(100));
+            EXPECT_EQ(pool.pinned_count(), 1);
+            // 换出其他所有块，钉住的块一直留在缓存中
+            for (uint32_t block_no = 200; block_no < 210; block_no++) {
+                auto victim = pool.take(block_no);
+                EXPECT_NE(victim->block_no, 100);
+                pool.insert(victim, block_no);
+            }
+            EXPECT_EQ(pool.find(100), first.get());
+            EXPECT_THROW(pool.erase(first.get()), std::logic_error);
+            EXPECT_THROW(pool.resize(8), std::runtime_error);
+
+            BufferHandle moved = std::move(first);
+            EXPECT_FALSE(first);
+            EXPECT_EQ(moved->block_no, 100);
+        }
+        EXPECT_EQ(pool.pinned_count(), 0);
+        EXPECT_NE(pool.find(100), nullptr);
+
+        std::vector<BufferHandle> handles;
+        for (uint32_t block_no = 300; block_no < 304; block_no++) {
+            auto cache_block = pool.take(block_no);
+            pool.insert(cache_block, block_no);
+            handles.emplace_back(pool, cache_block);
+        }
+        EXPECT_EQ(pool.find(100), nullptr);
+        EXPECT_THROW(pool.take(400), std::runtime_error);
+        handles.pop_back();
+        EXPECT_EQ(pool.take(400)->block_no, 303);
+    }
+}
+
+// 逻辑页与盘块号是同一个缓存块的两个索引：换出、删除、作废时都要从逻辑页表中移除
+TEST(BufferPoolTest, Pages) {
+    BufferPool pool(4);
+    for (uint32_t block_no = 100; block_no < 104; block_no++) {
+        auto cache_block = pool.take(block_no);
+        pool.insert(cache_block, block_no);
+        pool.attach_page(cache_block, 7, block_no - 100);
+    }
+    EXPECT_EQ(pool.lookup_page(7, 2), pool.find(102));
+    EXPECT_EQ(pool.lookup_page(8, 2), nullptr);
+
+    // 同一个逻辑页登记到另一个盘块，原来的登记被替换
+    pool.attach_page(pool.find(103), 7, 2);
+    EXPECT_EQ(pool.lookup_page(7, 2), pool.find(103));
+    EXPECT_EQ(pool.lookup_page(7, 3), nullptr);
+    EXPECT_EQ(pool.find(102)->owner_inode, 0);
+
+    // 换出的块不再是逻辑页
+    auto victim = pool.take(200);
+    EXPECT_EQ(victim->block_no, 100);
+    EXPECT_EQ(pool.lookup_page(7, 0), nullptr);
+    pool.insert(victim, 200);
+
+    pool.forget_page(7, 1);
+    EXPECT_EQ(pool.lookup_page(7, 1), nullptr);
+    EXPECT_NE(pool.find(101), nullptr);
+
+    pool.attach_page(pool.find(200), 9, 0);
+    pool.forget_inode(7, 3);
+    EXPECT_EQ(pool.lookup_page(7, 2), nullptr);
+    EXPECT_EQ(pool.lookup_page(9, 0), pool.find(200));
+    // 文件比缓存大时遍历所有缓存块
+    pool.attach_page(pool.find(101), 7, 50);
+    pool.forget_inode(7, 100);
+    EXPECT_EQ(pool.lookup_page(7, 50), nullptr);
+    EXPECT_EQ(pool.lookup_page(9, 0), pool.find(200));
+    pool.erase(pool.find(200));
+    EXPECT_EQ(pool.lookup_page(9, 0), nullptr);
+}
+
+// 元数据与块数据分开存放：元数据按缓存行对齐，块数据连续且按块大小对齐
+TEST(BufferPoolTest, ArenaLayout) {
+    for (uint32_t capacity: {16u, 5000u}) {
+        BufferPool pool(capacity);
+        const char *first_data = pool.begin()->block_data();
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(first_data) % 4096, 0);
+        uint32_t index = 0;
+        for (auto &cache_block: pool) {
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(&cache_block) % 64, 0);
+            EXPECT_EQ(cache_block.block_data(), first_data + (size_t) index * Geometry512::BLOCK_SIZE);
+            index++;
+        }
+        EXPECT_LE(reinterpret_cast<const char *>(pool.end()), first_data);
+
+        // 数据在换出、重新装入后仍然写在同一块内存中
+        auto cache_block = pool.take(1);
+        pool.insert(cache_block, 1);
+        uint32_t value = 0xdeadbeef;
+        (void) cache_block->write<uint32_t>(&value, 3);
+        EXPECT_EQ(*pool.find(1)->read<uint32_t>(3), value);
+    }
+}
+
+TEST(SlotListTest, Order) {
+    std::array<int, 8> slots{};
+    SlotList<int, 8> list(slots.data());
+    EXPECT_EQ(list.front(), nullptr);
+    for (auto &slot: slots) {
+        list.push_back(&slot);
+    }
+    EXPECT_EQ(list.size(), 8);
+    list.remove(&slots[0]);
+    list.remove(&slots[0]);
+    list.remove(&slots[5]);
+    list.push_back(&slots[5]);
+    EXPECT_EQ(list.size(), 7);
+    std::vector<int *> order;
+    while (!list.empty()) {
+        order.push_back(list.front());
+        list.pop_front();
+    }
+    std::vector<int *> expected = {&slots[1], &slots[2], &slots[3], &slots[4], &slots[6], &slots[7], &slots[5]};
+    EXPECT_EQ(order, expected);
+}
@@ -0,0 +1,238 @@
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include "disk_manager/DiskManager.hpp"
+
+#define TEST_DISK_PATH "disk_manager_test.img"
+#define TEST_DISK_SIZE (64 * DEFAULT_BLOCK_SIZE)
+
+// 所有后端写入的数据都能被正确读出
+TEST(DiskManagerTest, ReadWriteBlock) {
+    for (auto mode: {DiskMode::STREAM, DiskMode::POSIX, DiskMode::MMAP, DiskMode::URING}) {
+        DiskManager disk_manager(TEST_DISK_PATH, TEST_DISK_SIZE, mode);
+        disk_manager.format();
+
+        std::vector<char> data(2 * DEFAULT_BLOCK_SIZE);
+        for (size_t i = 0; i < data.size(); i++) {
+            data[i] = static_cast<char>(i % 251);
+        }
+        disk_manager.write_block(3, data);
+        disk_manager.sync();
+
+        EXPECT_EQ(disk_manager.read_block(3, 2), data);
+        EXPECT_EQ(disk_manager.read_block(2, 1), std::vector<char>(DEFAULT_BLOCK_SIZE, 0));
+    }
+}
+
+// POSIX后端写入的数据，重新打开后仍然存在
+TEST(DiskManagerTest, PosixPersistsAfterReopen) {
+    std::vector<char> data(DEFAULT_BLOCK_SIZE, 'x');
+    {
+        DiskManager disk_manager(TEST_DISK_PATH, TEST_DISK_SIZE, DiskMode::POSIX);
+        disk_manager.format();
+        disk_manager.write_block(63, data);
+    }
+    DiskManager disk_manager(TEST_DISK_PATH, TEST_DISK_SIZE, DiskMode::STREAM);
+    EXPECT_EQ(disk_manager.read_block(63, 1), data);
+}
+
+TEST(DiskManagerTest, WriteBlockSizeCheck) {
+    DiskManager disk_manager(TEST_DISK_PATH, TEST_DISK_SIZE);
+    EXPECT_THROW(disk_manager.write_block(0, std::vector<char>(DEFAULT_BLOCK_SIZE + 1)), std::runtime_error);
+}
+
+// MMAP后端越界访问会抛异常
+TEST(DiskManagerTest, MmapOutOfRange) {
+    DiskManager disk_manager(TEST_DISK_PATH, TEST_DISK_SIZE, DiskMode::MMAP);
+    EXPECT_THROW(disk_manager.read_block(64, 1), std::out_of_range);
+    EXPECT_THROW(disk_manager.write_block(63, std::vector<char>(2 * DEFAULT_BLOCK_SIZE)), std::out_of_range);
+}
+
+// 直接读写调用者的缓冲区
+TEST(DiskManagerTest, ReadWriteCallerBuffer) {
+    for (auto mode: {DiskMode::STREAM, DiskMode::POSIX, DiskMode::MMAP, DiskMode::URING}) {
+        DiskManager disk_manager(TEST_DISK_PATH, TEST_DISK_SIZE, mode);
+        disk_manager.format();
+
+        char data[3 * DEFAULT_BLOCK_SIZE];
+        for (size_t i = 0; i < sizeof(data); i++) {
+            data[i] = static_cast<char>(i % 253);
+        }
+        disk_manager.write_block(10, data, 3);
+
+        char buffer[3 * DEFAULT_BLOCK_SIZE]{};
+        disk_manager.read_block(10, 3, buffer);
+        EXPECT_EQ(std::memcmp(buffer, data, sizeof(data)), 0);
+    }
+}
+
+// 批量提交的读写请求全部完成
+TEST(DiskManagerTest, QueueAndSubmit) {
+    for (auto mode: {DiskMode::STREAM, DiskMode::POSIX, DiskMode::MMAP, DiskMode::URING}) {
+        DiskManager disk_manager(TEST_DISK_PATH, TEST_DISK_SIZE, mode);
+        disk_manager.format();
+
+        // 超过一个批次能容纳的请求数
+        std::vector<std::vector<char>> blocks(60, std::vector<char>(DEFAULT_BLOCK_SIZE));
+        for (uint32_t i = 0; i < blocks.size(); i++) {
+            std::fill(blocks[i].begin(), blocks[i].end(), static_cast<char>('A' + i % 26));
+            disk_manager.queue_write(i + 2, blocks[i].data(), 1);
+        }
+        disk_manager.submit();
+
+        std::vector<std::vector<char>> buffers(blocks.size(), std::vector<char>(DEFAULT_BLOCK_SIZE));
+        for (uint32_t i = 0; i < buffers.size(); i++) {
+            disk_manager.queue_read(i + 2, 1, buffers[i].data());
+        }
+        disk_manager.submit();
+        EXPECT_EQ(buffers, blocks);
+    }
+}
+
+// 物理相邻的请求合并为一次写入，不相邻的分开
+TEST(DiskManagerTest, CoalesceAdjacentWrites) {
+    for (auto mode: {DiskMode::POSIX, DiskMode::URING}) {
+        DiskManager disk_manager(TEST_DISK_PATH, TEST_DISK_SIZE, mode);
+        disk_manager.format();
+
+        std::vector<char> data(8 * DEFAULT_BLOCK_SIZE, 'c');
+        // 乱序提交 20..27，以及不相邻的 40
+        for (uint32_t i: {3, 1, 0, 2, 7, 5, 6, 4}) {
+            disk_manager.queue_write(20 + i, data.data() + i * DEFAULT_BLOCK_SIZE, 1);
+        }
+        disk_manager.queue_write(40, data.data(), 1);
+        auto before = disk_manager.stats().write_calls;
+        disk_manager.submit();
+        EXPECT_EQ(disk_manager.stats().write_calls - before, 2);
+
+        EXPECT_EQ(disk_manager.read_block(20, 8), data);
+    }
+}
+
+// 异步提交立即返回批次号，收割后完成；多个批次可以同时在途，条带化时也一样
+TEST(DiskManagerTest, SubmitAsync) {
+    const std::vector<std::string> paths = {"disk_manager_test_0.img", "disk_manager_test_1.img"};
+    for (auto mode: {DiskMode::POSIX, DiskMode::URING}) {
+        for (bool striped: {false, true}) {
+            auto disk_manager = striped ? std::make_unique<DiskManager>(paths, TEST_DISK_SIZE, mode, DEFAULT_BLOCK_SIZE, 4)
+                                        : std::make_unique<DiskManager>(TEST_DISK_PATH, TEST_DISK_SIZE, mode);
+            disk_manager->format();
+            std::vector<char> data(40 * DEFAULT_BLOCK_SIZE);
+            for (size_t i = 0; i < data.size(); i++) {
+                data[i] = static_cast<char>(i / DEFAULT_BLOCK_SIZE + 1);
+            }
+            disk_manager->queue_write(2, data.data(), 20);
+            auto first = disk_manager->submit_async();
+            disk_manager->queue_write(22, data.data() + 20 * DEFAULT_BLOCK_SIZE, 20);
+            auto second = disk_manager->submit_async();
+            EXPECT_NE(first, second);
+            disk_manager->wait(second);
+            while (!disk_manager->is_complete(first)) {
+                disk_manager->poll();
+            }
+            disk_manager->wait(first);
+            EXPECT_THROW(disk_manager->wait(first), std::logic_error);
+
+            std::vector<char> buffer(data.size());
+            for (uint32_t i = 0; i < 40; i++) {
+                disk_manager->queue_read(2 + i, 1, buffer.data() + i * DEFAULT_BLOCK_SIZE);
+            }
+            disk_manager->wait(disk_manager->submit_async());
+            EXPECT_EQ(buffer, data);
+        }
+    }
+}
+
+// 稀疏格式化不占用宿主空间，预分配格式化预留全部空间，两者读出都是0
+TEST(DiskManagerTest, FormatAllocation) {
+    const uint32_t size = 4 << 20;
+    auto allocated = [size]() {
+        struct stat st{};
+        EXPECT_EQ(::stat(TEST_DISK_PATH, &st), 0);
+        EXPECT_EQ(st.st_size, size);
+        return (uint64_t) st.st_blocks * 512;
+    };
+
+    DiskManager disk_manager(TEST_DISK_PATH, size);
+    disk_manager.write_block(100, std::vector<char>(DEFAULT_BLOCK_SIZE, 'x'));
+    disk_manager.format(ImageAllocation::SPARSE);
+    EXPECT_LT(allocated(), size / 2);
+    EXPECT_EQ(disk_manager.read_block(100, 1), std::vector<char>(DEFAULT_BLOCK_SIZE, 0));
+
+    disk_manager.format(ImageAllocation::PREALLOCATE);
+    EXPECT_GE(allocated(), size);
+    EXPECT_EQ(disk_manager.read_block(100, 1), std::vector<char>(DEFAULT_BLOCK_SIZE, 0));
+}
+
+// 打洞后盘块读出为0，相邻的盘块不受影响
+TEST(DiskManagerTest, Discard) {
+    for (auto mode: {DiskMode::POSIX, DiskMode::MMAP}) {
+        DiskManager disk_manager(TEST_DISK_PATH, TEST_DISK_SIZE, mode);
+        disk_manager.format();
+        std::vector<char> data(16 * DEFAULT_BLOCK_SIZE, 'p');
+        disk_manager.write_block(8, data);
+        disk_manager.discard(16, 8);
+        EXPECT_EQ(disk_manager.read_block(16, 8), std::vector<char>(8 * DEFAULT_BLOCK_SIZE, 0));
+        EXPECT_EQ(disk_manager.read_block(8, 8), std::vector<char>(8 * DEFAULT_BLOCK_SIZE, 'p'));
+    }
+}
+
+// 条带化：逻辑盘块按条带单元轮流分布在各个文件上，同步读写和批量读写都能正确拆分
+TEST(DiskManagerTest, Striped) {
+    const std::vector<std::string> paths = {"disk_manager_test_0.img", "disk_manager_test_1.img",
+                                            "disk_manager_test_2.img"};
+    for (auto mode: {DiskMode::POSIX, DiskMode::MMAP, DiskMode::URING}) {
+        DiskManager disk_manager(paths, TEST_DISK_SIZE, mode, DEFAULT_BLOCK_SIZE, 4);
+        disk_manager.format();
+        EXPECT_EQ(disk_manager.stripe_count(), 3);
+
+        std::vector<char> data(40 * DEFAULT_BLOCK_SIZE);
+        for (size_t i = 0; i < data.size(); i++) {
+            data[i] = static_cast<char>(i / DEFAULT_BLOCK_SIZE);
+        }
+        disk_manager.write_block(2, data);
+        disk_manager.sync();
+        EXPECT_EQ(disk_manager.read_block(2, 40), data);
+
+        std::vector<char> buffer(data.size());
+        disk_manager.queue_read(2, 40, buffer.data());
+        disk_manager.submit();
+        EXPECT_EQ(buffer, data);
+
+        // 逻辑盘块4是第二个条带单元的开头，位于第二个文件的第0块
+        DiskManager stripe(paths[1], 0, DiskMode::POSIX);
+        EXPECT_EQ(stripe.read_block(0, 1), std::vector<char>(DEFAULT_BLOCK_SIZE, 2));
+    }
+}
+
+// 直接读写与普通读写看到相同的数据，缓冲区未对齐、条带化时也一样
+TEST(DiskManagerTest, DirectReadWrite) {
+    const std::vector<std::string> paths = {"disk_manager_test_0.img", "disk_manager_test_1.img"};
+    const uint32_t block_num = 24;
+    const size_t length = block_num * DEFAULT_BLOCK_SIZE;
+    std::unique_ptr<char, decltype(&std::free)> aligned(
+            static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, length + DIRECT_IO_ALIGNMENT)), &std::free);
+    for (auto mode: {DiskMode::STREAM, DiskMode::POSIX, DiskMode::MMAP, DiskMode::URING}) {
+        for (bool striped: {false, true}) {
+            auto disk_manager = striped ? std::make_unique<DiskManager>(paths, TEST_DISK_SIZE, mode, DEFAULT_BLOCK_SIZE, 4)
+                                        : std::make_unique<DiskManager>(TEST_DISK_PATH, TEST_DISK_SIZE, mode);
+            disk_manager->format();
+            std::vector<char> data(length);
+            for (size_t i = 0; i < data.size(); i++) {
+                data[i] = static_cast<char>(i * 7 % 253);
+            }
+            for (char *buffer: {aligned.get(), aligned.get() + 8}) {
+                std::memcpy(buffer, data.data(), length);
+                disk_manager->write_direct(5, buffer, block_num);
+                EXPECT_EQ(disk_manager->read_block(5, block_num), data);
+
+                std::memset(buffer, 0, length);
+                disk_manager->read_direct(5, block_num, buffer);
+                EXPECT_EQ(std::memcmp(buffer, data.data(), length), 0);
+                data[0]++;
+                disk_manager->write_block(5, data);
+            }
+        }
+    }
+}
@@ -1,4 +1,6 @@
 #include <gtest/gtest.h>
+#include <cstdlib>
+#include <sys/stat.h>
 #include "fs/FileSystem.hpp"
 
 
@@ -10,9 +12,9 @@ TEST(FileSystemTest, FormatFileSystem) {
 }
 
 TEST(FileSystemTest, DiskSize) {
-    std::cout << "DISK_SIZE: " << DISK_SIZE << std::endl;
-    std::cout << "SUPER_BLOCK_SIZE: " << SUPER_BLOCK_SIZE << std::endl;
-    std::cout << "INODE_SIZE: " << INODE_SIZE << std::endl;
+    std::cout << "DISK_SIZE: " << Geometry512::DISK_SIZE << std::endl;
+    std::cout << "SUPER_BLOCK_SIZE: " << Geometry512::SUPER_BLOCK_BLOCKS << std::endl;
+    std::cout << "INODE_SIZE: " << Geometry512::INODE_BLOCKS << std::endl;
     SUCCEED();
 }
 
@@ -569,4 +571,742 @@ TEST(FileSystemTest, Test_write_32MB) {
     EXPECT_EQ(count, FILE_SIZE * len);
 
     SUCCEED();
-}
\ No newline at end of file
+}
+// MMAP模式写入的数据，用POSIX模式重新打开后可以读出
+TEST(FileSystemTest, Test_mmap_mode) {
+    std::string long_text(100000, 'm');
+    {
+        FileSystem fs(DiskMode::MMAP);
+        fs.format();
+        fs.touch("test");
+        auto fd = fs.fopen("test");
+        fs.fwrite(fd, long_text.c_str(), long_text.size());
+        fs.fclose(fd);
+    }
+    FileSystem fs(DiskMode::POSIX);
+    EXPECT_EQ(fs.cat("test"), long_text);
+}
+
+// URING模式下写入大文件后删除（删除时批量预读索引块），再重新读写
+TEST(FileSystemTest, Test_uring_mode) {
+    FileSystem fs(DiskMode::URING);
+    fs.format();
+    fs.touch("test");
+    auto fd = fs.fopen("test");
+    std::string long_text(8 << 20, 'u');
+    fs.fwrite(fd, long_text.c_str(), long_text.size());
+    fs.fclose(fd);
+    fs.rm("test");
+
+    fs.touch("test");
+    fd = fs.fopen("test");
+    fs.fwrite(fd, long_text.c_str(), long_text.size());
+    fs.fseek(fd, 0);
+    std::string buffer(long_text.size(), '\0');
+    fs.fread(fd, buffer.data(), buffer.size());
+    fs.fclose(fd);
+    EXPECT_EQ(buffer, long_text);
+}
+
+// 顺序写入时，相邻脏块合并写回，写入次数远小于块数
+TEST(FileSystemTest, Test_write_coalescing) {
+    FileSystem fs;
+    fs.format();
+    fs.touch("test");
+    auto fd = fs.fopen("test");
+    std::string long_text(1 << 20, 'c');
+    auto before = fs.disk_stats().write_calls;
+    fs.fwrite(fd, long_text.c_str(), long_text.size());
+    fs.fclose(fd);
+    fs.save();
+    EXPECT_LT(fs.disk_stats().write_calls - before, long_text.size() / FileSystem::block_size() / 4);
+
+    fd = fs.fopen("test");
+    std::string buffer(long_text.size(), '\0');
+    fs.fread(fd, buffer.data(), buffer.size());
+    fs.fclose(fd);
+    EXPECT_EQ(buffer, long_text);
+}
+
+// 4KiB块的文件系统：重新挂载后目录和大文件（用到二次间接索引）都能读出
+TEST(FileSystemTest, Test_block_size_4k) {
+    using FileSystem4K = BasicFileSystem<Geometry4K>;
+    const std::string disk_path = "disk_dev_4k.img";
+    std::string long_text(12 << 20, 'k');
+    {
+        FileSystem4K fs(DiskMode::POSIX, disk_path);
+        fs.format();
+        for (int i = 0; i < 200; i++) {
+            fs.mkdir("dir" + std::to_string(i));
+        }
+        fs.touch("test");
+        auto fd = fs.fopen("test");
+        fs.fwrite(fd, long_text.c_str(), long_text.size());
+        fs.fclose(fd);
+    }
+    FileSystem4K fs(DiskMode::POSIX, disk_path);
+    EXPECT_EQ(fs.ls().size(), 2 + 200 + 1);
+    auto fd = fs.fopen("test");
+    std::string buffer(long_text.size(), '\0');
+    fs.fread(fd, buffer.data(), buffer.size());
+    fs.fclose(fd);
+    EXPECT_EQ(buffer, long_text);
+
+    fs.rm("test");
+    EXPECT_FALSE(fs.exist("/test"));
+}
+
+// 用其他几何参数挂载4K的磁盘应当失败，且不能覆盖磁盘上的数据
+TEST(FileSystemTest, Test_geometry_mismatch) {
+    using FileSystem4K = BasicFileSystem<Geometry4K>;
+    const std::string disk_path = "disk_dev_4k.img";
+    {
+        FileSystem4K fs(DiskMode::POSIX, disk_path);
+        fs.format();
+        fs.mkdir("keep");
+    }
+    EXPECT_EQ(probe_block_size(disk_path), Geometry4K::BLOCK_SIZE);
+    EXPECT_THROW(FileSystem(DiskMode::POSIX, disk_path), std::runtime_error);
+
+    EXPECT_EQ(probe_block_size(disk_path), Geometry4K::BLOCK_SIZE);
+    FileSystem4K fs(DiskMode::POSIX, disk_path);
+    EXPECT_TRUE(fs.exist("/keep"));
+}
+
+// 旧版本的磁盘头部只有16字节，块大小的位置是位图的内容，不能挂载
+TEST(FileSystemTest, Test_legacy_superblock) {
+    const std::string disk_path = "disk_dev_legacy.img";
+    {
+        const uint32_t legacy_header[4] = {Geometry512::BLOCK_COUNT, Geometry512::INODE_COUNT, 0, 0};
+        const uint64_t inode_bitmap_word = 0b11;
+        std::ofstream disk(disk_path, std::ios::binary | std::ios::trunc);
+        disk.write(reinterpret_cast<const char *>(legacy_header), sizeof(legacy_header));
+        disk.write(reinterpret_cast<const char *>(&inode_bitmap_word), sizeof(inode_bitmap_word));
+    }
+    EXPECT_FALSE(is_known_block_size(probe_block_size(disk_path)));
+    EXPECT_THROW(FileSystem(DiskMode::POSIX, disk_path), std::runtime_error);
+    std::remove(disk_path.c_str());
+    EXPECT_EQ(probe_block_size(disk_path), 0);
+}
+
+// 删除文件后，释放的盘块在save()时打洞，磁盘文件占用的宿主空间随之减少
+TEST(FileSystemTest, Test_discard_on_rm) {
+    auto allocated = []() {
+        struct stat st{};
+        EXPECT_EQ(::stat(DISK_PATH, &st), 0);
+        return (uint64_t) st.st_blocks * 512;
+    };
+
+    FileSystem fs;
+    fs.format();
+    fs.touch("test");
+    auto fd = fs.fopen("test");
+    std::string long_text(8 << 20, 'd');
+    fs.fwrite(fd, long_text.c_str(), long_text.size());
+    fs.fclose(fd);
+    fs.save();
+    auto before = allocated();
+
+    fs.rm("test");
+    fs.save();
+    EXPECT_GT(fs.disk_stats().discard_calls, 0);
+    EXPECT_LT(allocated(), before - long_text.size() / 2);
+
+    // 打过洞的盘块可以重新分配使用
+    fs.touch("test");
+    fd = fs.fopen("test");
+    fs.fwrite(fd, long_text.c_str(), long_text.size());
+    fs.fseek(fd, 0);
+    std::string buffer(long_text.size(), '\0');
+    fs.fread(fd, buffer.data(), buffer.size());
+    fs.fclose(fd);
+    EXPECT_EQ(buffer, long_text);
+}
+
+// 持久化策略：两次持久化之间的修改合并为一次sync
+TEST(FileSystemTest, Test_durability) {
+    FileSystem fs;
+    fs.format();
+    auto syncs = [&fs]() { return fs.disk_stats().sync_calls; };
+
+    // NONE：不自动sync
+    auto before = syncs();
+    fs.touch("a");
+    fs.mkdir("b");
+    EXPECT_EQ(syncs(), before);
+
+    // PER_OP：每个修改操作一次sync
+    fs.set_durability(Durability::PER_OP);
+    before = syncs();
+    fs.touch("c");
+    fs.mkdir("d");
+    fs.rm("c");
+    EXPECT_EQ(syncs(), before + 3);
+
+    // ON_CLOSE：写入时不sync，关闭时sync一次；没有修改时关闭不sync
+    fs.set_durability(Durability::ON_CLOSE);
+    before = syncs();
+    auto fd = fs.fopen("a");
+    fs.fwrite(fd, "hello", 5);
+    fs.fwrite(fd, "world", 5);
+    EXPECT_EQ(syncs(), before);
+    fs.fclose(fd);
+    EXPECT_EQ(syncs(), before + 1);
+    fd = fs.fopen("a");
+    fs.fclose(fd);
+    EXPECT_EQ(syncs(), before + 1);
+    // cat内部关闭文件时提交，由cat在释放锁之后sync一次
+    fs.touch("e");
+    EXPECT_EQ(syncs(), before + 1);
+    EXPECT_EQ(fs.cat("a"), "helloworld");
+    EXPECT_EQ(syncs(), before + 2);
+
+    // PERIODIC：间隔内的操作不sync
+    fs.set_durability(Durability::PERIODIC, std::chrono::hours(1));
+    fs.save();
+    before = syncs();
+    for (int i = 0; i < 10; i++) {
+        fs.touch("p" + std::to_string(i));
+    }
+    EXPECT_EQ(syncs(), before);
+    EXPECT_EQ(fs.cat("a"), "helloworld");
+
+    // STREAM模式的sync不会落盘，不能使用自动持久化策略
+    fs.set_durability(Durability::NONE);
+    FileSystem stream_fs(DiskMode::STREAM);
+    EXPECT_THROW(stream_fs.set_durability(Durability::PER_OP), std::runtime_error);
+    EXPECT_EQ(stream_fs.get_durability(), Durability::NONE);
+}
+
+// PERIODIC：定时提交不依赖之后的操作，一次提交间隔内的所有修改，没有修改时不sync
+TEST(FileSystemTest, Test_durability_periodic) {
+    FileSystem fs;
+    fs.format();
+    auto syncs = [&fs]() { return fs.disk_stats().sync_calls; };
+    for (int i = 0; i < 10; i++) {
+        fs.touch("p" + std::to_string(i));
+    }
+    const auto before = syncs();
+    fs.set_durability(Durability::PERIODIC, std::chrono::milliseconds(50));
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (syncs() == before && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(syncs(), before + 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(syncs(), before + 1);
+
+    // 修改已经写入磁盘文件，另一个实例挂载后可以看到
+    FileSystem other;
+    EXPECT_TRUE(other.exist("/p9"));
+}
+
+// PER_OP：并发的修改操作各自等待持久化，sync进行中到达的操作共享下一次sync
+TEST(FileSystemTest, Test_durability_group_commit) {
+    FileSystem fs;
+    fs.format();
+    fs.set_durability(Durability::PER_OP);
+    const auto before = fs.disk_stats().sync_calls;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&fs, t]() {
+            for (int i = 0; i < 25; i++) {
+                fs.touch("t" + std::to_string(t) + "_" + std::to_string(i));
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    EXPECT_LE(fs.disk_stats().sync_calls - before, 100);
+    for (int t = 0; t < 4; t++) {
+        EXPECT_TRUE(fs.exist("/t" + std::to_string(t) + "_24"));
+    }
+}
+
+// 条带化的文件系统：数据分布在多个磁盘文件上，重新挂载后仍能读出
+TEST(FileSystemTest, Test_striped) {
+    const std::vector<std::string> paths = {"disk_dev_stripe_0.img", "disk_dev_stripe_1.img"};
+    std::string long_text(4 << 20, 's');
+    {
+        FileSystem fs(DiskMode::POSIX, paths, 16);
+        fs.format();
+        EXPECT_EQ(fs.stripe_count(), 2);
+        fs.touch("test");
+        auto fd = fs.fopen("test");
+        fs.fwrite(fd, long_text.c_str(), long_text.size());
+        fs.fclose(fd);
+    }
+    FileSystem fs(DiskMode::POSIX, paths, 16);
+    auto fd = fs.fopen("test");
+    std::string buffer(long_text.size(), '\0');
+    fs.fread(fd, buffer.data(), buffer.size());
+    fs.fclose(fd);
+    EXPECT_EQ(buffer, long_text);
+}
+
+// 运行时调整高速缓存大小，调整前的脏块被写回
+TEST(FileSystemTest, Test_cache_capacity) {
+    FileSystem fs;
+    fs.format();
+    EXPECT_EQ(fs.cache_capacity(), Geometry512::CACHE_BLOCK_NUM);
+    EXPECT_THROW(fs.set_cache_capacity(Geometry512::MIN_CACHE_BLOCK_NUM - 1), std::runtime_error);
+
+    std::string long_text(2 << 20, 'c');
+    for (auto capacity: {16u, 65536u}) {
+        fs.set_cache_capacity(capacity);
+        EXPECT_EQ(fs.cache_capacity(), capacity);
+        fs.touch("cache_" + std::to_string(capacity));
+        auto fd = fs.fopen("cache_" + std::to_string(capacity));
+        fs.fwrite(fd, long_text.c_str(), long_text.size());
+        fs.fclose(fd);
+    }
+    fs.set_cache_capacity(Geometry512::MIN_CACHE_BLOCK_NUM);
+    for (auto capacity: {16u, 65536u}) {
+        auto fd = fs.fopen("cache_" + std::to_string(capacity));
+        std::string buffer(long_text.size(), '\0');
+        fs.fread(fd, buffer.data(), buffer.size());
+        fs.fclose(fd);
+        EXPECT_EQ(buffer, long_text);
+    }
+}
+
+// 各种替换策略下读写结果相同
+TEST(FileSystemTest, Test_cache_policy) {
+    FileSystem fs;
+    fs.format();
+    EXPECT_EQ(fs.cache_policy(), CachePolicy::LRU);
+    fs.set_cache_capacity(64);
+
+    std::string long_text(1 << 20, 'p');
+    for (auto policy: {CachePolicy::CLOCK, CachePolicy::TWO_Q, CachePolicy::ARC, CachePolicy::LRU}) {
+        fs.set_cache_policy(policy);
+        EXPECT_EQ(fs.cache_policy(), policy);
+        auto name = "policy_" + std::to_string(static_cast<int>(policy));
+        fs.mkdir(name);
+        fs.cd(name);
+        fs.touch("data");
+        auto fd = fs.fopen("data");
+        fs.fwrite(fd, long_text.c_str(), long_text.size());
+        fs.fclose(fd);
+        fs.cd("..");
+    }
+    for (auto policy: {CachePolicy::CLOCK, CachePolicy::TWO_Q, CachePolicy::ARC, CachePolicy::LRU}) {
+        fs.set_cache_policy(policy);
+        fs.cd("policy_" + std::to_string(static_cast<int>(policy)));
+        auto fd = fs.fopen("data");
+        std::string buffer(long_text.size(), '\0');
+        fs.fread(fd, buffer.data(), buffer.size());
+        fs.fclose(fd);
+        EXPECT_EQ(buffer, long_text);
+        fs.cd("..");
+    }
+}
+
+// 顺序读取时预读：冷缓存下读取整个文件，磁盘读次数远少于块数；跳读时结果不变
+TEST(FileSystemTest, Test_readahead) {
+    std::string long_text(1 << 20, '\0');
+    for (size_t i = 0; i < long_text.size(); i++) {
+        long_text[i] = static_cast<char>('a' + i % 26);
+    }
+    {
+        FileSystem fs;
+        fs.format();
+        fs.touch("readahead");
+        auto fd = fs.fopen("readahead");
+        fs.fwrite(fd, long_text.c_str(), long_text.size());
+        fs.fclose(fd);
+    }
+
+    FileSystem fs;
+    auto fd = fs.fopen("readahead");
+    auto before = fs.disk_stats().read_calls;
+    std::string buffer(long_text.size(), '\0');
+    for (uint32_t offset = 0; offset < buffer.size(); offset += 1000) {
+        fs.fread(fd, buffer.data() + offset, std::min<uint32_t>(1000, buffer.size() - offset));
+    }
+    EXPECT_EQ(buffer, long_text);
+    EXPECT_LT(fs.disk_stats().read_calls - before, long_text.size() / FileSystem::block_size() / 16);
+
+    // 跳读
+    char chunk[100];
+    for (uint32_t offset: {900000u, 12345u, 500000u, 12445u}) {
+        fs.fseek(fd, offset);
+        fs.fread(fd, chunk, sizeof(chunk));
+        EXPECT_EQ(std::string(chunk, sizeof(chunk)), long_text.substr(offset, sizeof(chunk)));
+    }
+    fs.fclose(fd);
+}
+
+// 异步预读：预读的块在途时删除文件、重新分配盘块、格式化，读到的都是正确的数据
+TEST(FileSystemTest, Test_async_readahead) {
+    std::string long_text(1 << 20, '\0');
+    for (size_t i = 0; i < long_text.size(); i++) {
+        long_text[i] = static_cast<char>('a' + i % 26);
+    }
+    FileSystem fs(DiskMode::URING);
+    fs.format();
+    fs.set_direct_io_threshold(0);
+    fs.touch("old");
+    auto fd = fs.fopen("old");
+    fs.fwrite(fd, long_text.c_str(), long_text.size());
+    fs.fclose(fd);
+    // 清空缓存，之后的读取都要经过磁盘
+    fs.set_cache_capacity(fs.cache_capacity());
+
+    fd = fs.fopen("old");
+    std::string buffer(long_text.size() / 2, '\0');
+    for (uint32_t offset = 0; offset < buffer.size(); offset += 1000) {
+        fs.fread(fd, buffer.data() + offset, std::min<uint32_t>(1000, buffer.size() - offset));
+    }
+    EXPECT_EQ(buffer, long_text.substr(0, buffer.size()));
+    fs.fclose(fd);
+
+    // 预读的盘块被释放后分配给新文件，新文件的内容不能被预读的旧数据覆盖
+    fs.rm("old");
+    std::string new_text(long_text.size(), 'n');
+    fs.touch("new");
+    fd = fs.fopen("new");
+    fs.fwrite(fd, new_text.c_str(), new_text.size());
+    fs.fseek(fd, 0);
+    buffer.assign(new_text.size(), '\0');
+    fs.fread(fd, buffer.data(), buffer.size());
+    EXPECT_EQ(buffer, new_text);
+
+    fs.fseek(fd, 0);
+    fs.fread(fd, buffer.data(), 100000);
+    fs.fclose(fd);
+    fs.format();
+    EXPECT_FALSE(fs.exist("new"));
+}
+
+// 后台写回：前台写入时脏块不超过硬阈值，停留过久的脏块被后台线程写回，数据与同步写回相同
+TEST(FileSystemTest, Test_writeback) {
+    std::string long_text(4 << 20, '\0');
+    for (size_t i = 0; i < long_text.size(); i++) {
+        long_text[i] = static_cast<char>('A' + i % 31);
+    }
+    {
+        FileSystem fs;
+        fs.format();
+        fs.start_writeback(10, 40, std::chrono::milliseconds(20));
+        EXPECT_TRUE(fs.writeback_running());
+        const uint32_t hard_limit = fs.cache_capacity() * 40 / 100;
+
+        for (int round = 0; round < 3; round++) {
+            fs.touch("writeback");
+            auto fd = fs.fopen("writeback");
+            for (uint32_t offset = 0; offset < long_text.size(); offset += 64 * 1024) {
+                fs.fwrite(fd, long_text.c_str() + offset, 64 * 1024);
+                EXPECT_LE(fs.dirty_block_count(), hard_limit);
+            }
+            fs.fclose(fd);
+            if (round < 2) {
+                fs.rm("writeback");
+            }
+        }
+
+        // 不再写入后，所有脏块都会超过停留时间而被写回
+        for (int i = 0; i < 200 && fs.dirty_block_count() > 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_EQ(fs.dirty_block_count(), 0);
+        fs.stop_writeback();
+        EXPECT_FALSE(fs.writeback_running());
+    }
+
+    FileSystem fs;
+    auto fd = fs.fopen("writeback");
+    std::string buffer(long_text.size(), '\0');
+    fs.fread(fd, buffer.data(), buffer.size());
+    fs.fclose(fd);
+    EXPECT_EQ(buffer, long_text);
+    EXPECT_THROW(fs.start_writeback(50, 10), std::runtime_error);
+
+    FileSystem stream_fs(DiskMode::STREAM);
+    EXPECT_THROW(stream_fs.start_writeback(), std::runtime_error);
+}
+
+// 大段对齐读写绕过高速缓存：直接写入磁盘，与缓存中的块保持一致，重新挂载后数据不变
+TEST(FileSystemTest, Test_direct_io) {
+    const uint32_t block_size = FileSystem::block_size();
+    std::string long_text(1 << 20, '\0');
+    for (size_t i = 0; i < long_text.size(); i++) {
+        long_text[i] = static_cast<char>('a' + i * 7 % 26);
+    }
+    {
+        FileSystem fs;
+        fs.format();
+        fs.set_direct_io_threshold(16);
+        EXPECT_EQ(fs.direct_io_threshold(), 16);
+        fs.touch("direct");
+        auto fd = fs.fopen("direct");
+
+        // 大段写入在fwrite返回前已经到达磁盘，缓存中只留下脏的索引块
+        auto writes = fs.disk_stats().write_calls;
+        fs.fwrite(fd, long_text.c_str(), long_text.size());
+        EXPECT_GT(fs.disk_stats().write_calls, writes);
+        EXPECT_LT(fs.dirty_block_count(), long_text.size() / block_size / 16);
+
+        // 经过缓存写入一小段（脏块），直接读出的数据以缓存为准
+        fs.fseek(fd, 10 * block_size + 3);
+        fs.fwrite(fd, "cached", 6);
+        long_text.replace(10 * block_size + 3, 6, "cached");
+        std::string buffer(long_text.size(), '\0');
+        fs.fseek(fd, 0);
+        fs.fread(fd, buffer.data(), buffer.size());
+        EXPECT_EQ(buffer, long_text);
+
+        // 直接写入覆盖缓存中的块，之后经过缓存读到的是新数据
+        std::unique_ptr<char, decltype(&std::free)> aligned(
+                static_cast<char *>(std::aligned_alloc(DIRECT_IO_ALIGNMENT, 32 * block_size)), &std::free);
+        std::memset(aligned.get(), 'Z', 32 * block_size);
+        fs.fseek(fd, 0);
+        fs.fwrite(fd, aligned.get(), 32 * block_size);
+        long_text.replace(0, 32 * block_size, 32 * block_size, 'Z');
+        char chunk[100];
+        fs.fseek(fd, 10 * block_size);
+        fs.fread(fd, chunk, sizeof(chunk));
+        EXPECT_EQ(std::string(chunk, sizeof(chunk)), long_text.substr(10 * block_size, sizeof(chunk)));
+        EXPECT_EQ(fs.get_file_size(fd), long_text.size());
+        fs.fclose(fd);
+    }
+
+    FileSystem fs;
+    fs.set_direct_io_threshold(0);
+    auto fd = fs.fopen("direct");
+    std::string buffer(long_text.size(), '\0');
+    fs.fread(fd, buffer.data(), buffer.size());
+    EXPECT_EQ(buffer, long_text);
+    fs.fclose(fd);
+}
+
+// 逻辑页缓存：删除文件后新建的文件重用同一个Inode编号，不能读到旧文件的缓存页
+TEST(FileSystemTest, Test_page_cache) {
+    const uint32_t block_size = FileSystem::block_size();
+    FileSystem fs;
+    fs.format();
+    fs.set_direct_io_threshold(0);
+    for (char fill: {'x', 'y'}) {
+        std::string text(300 * block_size, fill);
+        fs.touch("pages");
+        auto fd = fs.fopen("pages");
+        fs.fwrite(fd, text.c_str(), text.size());
+        std::string buffer(text.size(), '\0');
+        for (int round = 0; round < 2; round++) {
+            fs.fseek(fd, 0);
+            fs.fread(fd, buffer.data(), buffer.size());
+            EXPECT_EQ(buffer, text);
+        }
+        fs.fclose(fd);
+        fs.rm("pages");
+    }
+
+    // 文件块号对应的盘块在写入时分配，覆盖写之后读到的是新数据
+    fs.touch("pages");
+    auto fd = fs.fopen("pages");
+    std::string text(3 * block_size, 'a');
+    fs.fwrite(fd, text.c_str(), text.size());
+    fs.fseek(fd, block_size);
+    fs.fwrite(fd, "bbbb", 4);
+    text.replace(block_size, 4, "bbbb");
+    std::string buffer(text.size(), '\0');
+    fs.fseek(fd, 0);
+    fs.fread(fd, buffer.data(), buffer.size());
+    EXPECT_EQ(buffer, text);
+    fs.fclose(fd);
+}
+
+// 一次写入的数据块一起分配：空盘上物理连续（只被途中的索引块隔开），越过文件末尾写入时中间补0
+TEST(FileSystemTest, Test_write_contiguous) {
+    const uint32_t block_size = FileSystem::block_size();
+    FileSystem fs;
+    fs.format();
+    fs.set_direct_io_threshold(0);
+    fs.touch("big");
+    auto fd = fs.fopen("big");
+    std::string text(2000 * block_size + 123, '\0');
+    for (size_t i = 0; i < text.size(); i++) {
+        text[i] = static_cast<char>('a' + i * 13 % 26);
+    }
+    fs.fwrite(fd, text.c_str(), text.size());
+
+    // 2001个数据块跨过直接、一次、二次间接索引，17个索引块按文件顺序夹在数据块之间，整体是一段连续的盘块
+    auto extents = fs.file_extents(fd);
+    uint32_t data_blocks = 0;
+    for (auto [block_no, length]: extents) {
+        data_blocks += length;
+    }
+    EXPECT_EQ(data_blocks, 2001);
+    EXPECT_EQ(extents.back().first + extents.back().second - extents.front().first, 2001 + 17);
+
+    // 覆盖写不分配新块
+    fs.fseek(fd, block_size * 3);
+    fs.fwrite(fd, "overwrite", 9);
+    text.replace(block_size * 3, 9, "overwrite");
+    EXPECT_EQ(fs.file_extents(fd), extents);
+
+    // 越过文件末尾写入
+    const uint32_t hole = 3 * block_size + 7;
+    fs.fseek(fd, text.size() + hole);
+    fs.fwrite(fd, "tail", 4);
+    text += std::string(hole, '\0') + "tail";
+    EXPECT_EQ(fs.get_file_size(fd), text.size());
+
+    std::string buffer(text.size(), 'x');
+    fs.fseek(fd, 0);
+    fs.fread(fd, buffer.data(), buffer.size());
+    EXPECT_EQ(buffer, text);
+    fs.fclose(fd);
+}
+
+// 延迟分配：交替追加两个文件，写回前没有盘块，save()时每个文件一次分配，得到连续的盘块
+TEST(FileSystemTest, Test_delayed_allocation) {
+    const uint32_t block_size = FileSystem::block_size();
+    const uint32_t blocks = 150;
+    std::string expected[2];
+    {
+        FileSystem fs;
+        fs.format();
+        fs.set_delayed_allocation(true);
+        EXPECT_TRUE(fs.delayed_allocation());
+        fs.touch("a");
+        fs.touch("b");
+        fs.touch("tmp");
+        uint32_t fds[2] = {fs.fopen("a"), fs.fopen("b")};
+        auto tmp = fs.fopen("tmp");
+        for (uint32_t i = 0; i < blocks; i++) {
+            for (int f = 0; f < 2; f++) {
+                std::string chunk(block_size, static_cast<char>('a' + (i + f) % 26));
+                fs.fwrite(fds[f], chunk.c_str(), chunk.size());
+                expected[f] += chunk;
+            }
+            fs.fwrite(tmp, "temporary", 9);
+        }
+        // 数据页不计入脏块，只有目录和Inode的修改
+        EXPECT_TRUE(fs.file_extents(fds[0]).empty());
+        EXPECT_LT(fs.dirty_block_count(), 4);
+
+        // 写回前被删除的文件不占用盘块
+        fs.fclose(tmp);
+        fs.rm("tmp");
+
+        // 延迟的块从缓存中读出，包括绕过缓存的对齐读
+        fs.set_direct_io_threshold(16);
+        std::string buffer(expected[0].size(), '\0');
+        fs.fseek(fds[0], 0);
+        fs.fread(fds[0], buffer.data(), buffer.size());
+        EXPECT_EQ(buffer, expected[0]);
+        fs.set_direct_io_threshold(0);
+
+        fs.save();
+        for (int f = 0; f < 2; f++) {
+            // 150个数据块只被途中的2个索引块隔开
+            auto extents = fs.file_extents(fds[f]);
+            EXPECT_EQ(extents.back().first + extents.back().second - extents.front().first, blocks + 2);
+            fs.fclose(fds[f]);
+        }
+        // tmp从未分配盘块，a和b紧挨在一起
+        auto a = fs.fopen("a"), b = fs.fopen("b");
+        auto last = fs.file_extents(a).back();
+        EXPECT_EQ(last.first + last.second, fs.file_extents(b).front().first);
+        fs.fclose(a);
+        fs.fclose(b);
+    }
+
+    FileSystem fs;
+    for (int f = 0; f < 2; f++) {
+        auto fd = fs.fopen(f == 0 ? "a" : "b");
+        std::string buffer(expected[f].size(), '\0');
+        fs.fread(fd, buffer.data(), buffer.size());
+        EXPECT_EQ(buffer, expected[f]);
+        fs.fclose(fd);
+    }
+
+    // 普通写入的延迟块不记为预先分配，删除后复用Inode编号的新文件只分配自己写入的块
+    fs.set_delayed_allocation(true);
+    fs.rm("a");
+    fs.touch("c");
+    auto fd = fs.fopen("c");
+    fs.fwrite(fd, "hello", 5);
+    fs.save();
+    auto extents = fs.file_extents(fd);
+    ASSERT_EQ(extents.size(), 1);
+    EXPECT_EQ(extents[0].second, 1);
+    fs.fclose(fd);
+}
+
+// fallocate预先分配连续的块，之后交替追加写入不再分配；zero模式扩展文件并清零
+TEST(FileSystemTest, Test_fallocate) {
+    const uint32_t block_size = FileSystem::block_size();
+    const uint32_t blocks = 300, written = 200;
+    std::string expected[2];
+    {
+        FileSystem fs;
+        fs.format();
+        fs.touch("a");
+        fs.touch("b");
+        uint32_t fds[2] = {fs.fopen("a"), fs.fopen("b")};
+        std::vector<std::pair<uint32_t, uint32_t>> extents[2];
+        for (int f = 0; f < 2; f++) {
+            EXPECT_THROW(fs.fallocate(fds[f], 0, 0), std::runtime_error);
+            fs.fallocate(fds[f], 0, blocks * block_size);
+            EXPECT_EQ(fs.get_file_size(fds[f]), 0);
+            // 300个数据块和途中的4个索引块一次分配
+            extents[f] = fs.file_extents(fds[f]);
+            EXPECT_EQ(extents[f].back().first + extents[f].back().second - extents[f].front().first, blocks + 4);
+        }
+        // 已分配的范围不变
+        fs.fallocate(fds[0], block_size, block_size);
+        EXPECT_EQ(fs.file_extents(fds[0]), extents[0]);
+
+        for (uint32_t i = 0; i < written; i++) {
+            for (int f = 0; f < 2; f++) {
+                std::string chunk(block_size, static_cast<char>('a' + (i + f) % 26));
+                fs.fwrite(fds[f], chunk.c_str(), chunk.size());
+                expected[f] += chunk;
+            }
+        }
+        for (int f = 0; f < 2; f++) {
+            EXPECT_EQ(fs.file_extents(fds[f]), extents[f]);
+        }
+
+        // 文件末尾之后清零，包括末尾所在的不完整的块
+        fs.fwrite(fds[1], "tail", 4);
+        expected[1] += "tail";
+        fs.fallocate(fds[1], expected[1].size() + 10, 20 * block_size, true);
+        expected[1].resize(expected[1].size() + 10 + 20 * block_size, '\0');
+        EXPECT_EQ(fs.get_file_size(fds[1]), expected[1].size());
+        EXPECT_EQ(fs.file_extents(fds[1]), extents[1]);
+        // 不完整的块直接写入磁盘，缓存中的旧内容已作废，挂载期间读出的也是清零后的内容
+        std::string head(block_size, '\1');
+        fs.fseek(fds[1], written * block_size);
+        fs.fread(fds[1], head.data(), head.size());
+        EXPECT_EQ(head, expected[1].substr(written * block_size, block_size));
+        fs.fclose(fds[0]);
+        fs.fclose(fds[1]);
+    }
+
+    FileSystem fs;
+    for (int f = 0; f < 2; f++) {
+        auto fd = fs.fopen(f == 0 ? "a" : "b");
+        std::string buffer(expected[f].size(), '\1');
+        fs.fread(fd, buffer.data(), buffer.size());
+        EXPECT_EQ(buffer, expected[f]);
+        // 预先分配的块重新挂载后仍然保留
+        EXPECT_EQ(fs.file_extents(fd).back().first + fs.file_extents(fd).back().second
+                  - fs.file_extents(fd).front().first, blocks + 4);
+        fs.fclose(fd);
+    }
+
+    // 删除后复用同一个Inode编号的新文件不继承原来的指针和预先分配的块
+    fs.rm("a");
+    fs.touch("c");
+    auto fd = fs.fopen("c");
+    fs.fwrite(fd, "hello", 5);
+    auto extents = fs.file_extents(fd);
+    ASSERT_EQ(extents.size(), 1);
+    EXPECT_EQ(extents[0].second, 1);
+    fs.fclose(fd);
+    EXPECT_EQ(fs.cat("c"), "hello");
+}
@@ -1,19 +1,145 @@
+#include <cstdlib>
+#include <cstring>
+#include <memory>
 #include <gtest/gtest.h>
 #include "fs/SuperBlock.hpp"
 
 // 测试SuperBlock的大小是否正确，即是否为1024字节
 TEST(SuperBlockTest, TestSize) {
     SuperBlock sb;
-    EXPECT_EQ(sizeof(sb), SUPER_BLOCK_SIZE * 512);
+    EXPECT_EQ(sizeof(sb), Geometry512::SUPER_BLOCK_BLOCKS * 512);
 }
 
 // 测试SuperBlock的初始化
 TEST(SuperBlockTest, TestInit) {
     SuperBlock sb;
-    EXPECT_EQ(sb.block_count, BLOCK_COUNT);
-    EXPECT_EQ(sb.inode_count, INODE_COUNT);
+    EXPECT_EQ(sb.block_count, Geometry512::BLOCK_COUNT);
+    EXPECT_EQ(sb.inode_count, Geometry512::INODE_COUNT);
     EXPECT_EQ(sb.dirty_flag, 0);
     EXPECT_EQ(sb.inode_bitmap.count(), 0);
     EXPECT_EQ(sb.block_bitmap.count(), 0);
 }
 
+
+// 测试不同几何参数下的磁盘布局
+TEST(SuperBlockTest, TestGeometry) {
+    SuperBlock sb;
+    EXPECT_EQ(sb.block_size, 512);
+    EXPECT_EQ(sb.inode_start_index, Geometry512::SUPER_BLOCK_BLOCKS);
+    EXPECT_EQ(sb.block_start_index, Geometry512::SUPER_BLOCK_BLOCKS + Geometry512::INODE_BLOCKS);
+    EXPECT_TRUE(sb.matches_geometry());
+    static_assert(Geometry512::INODES_PER_BLOCK == 8);
+    static_assert(Geometry512::ENTRIES_PER_BLOCK == 16);
+
+    BasicSuperBlock<Geometry4K> sb4k;
+    EXPECT_EQ(sizeof(sb4k), Geometry4K::SUPER_BLOCK_BLOCKS * 4096);
+    EXPECT_EQ(sb4k.block_size, 4096);
+    EXPECT_EQ((sb4k.block_start_index - sb4k.inode_start_index) * 4096, Geometry4K::INODE_COUNT * sizeof(DiskInode));
+    static_assert(Geometry4K::PTRS_PER_BLOCK == 1024);
+    static_assert(Geometry4K::ENTRIES_PER_BLOCK == 128);
+    static_assert(Geometry4K::INDEX_LEVEL_END[1] == 5 + 2 * 1024);
+
+    // 其他几何参数格式化的SuperBlock不能直接挂载
+    sb4k.block_size = 512;
+    EXPECT_FALSE(sb4k.matches_geometry());
+}
+
+// 之前的位图是std::bitset，按64位字存放，第i位在第i/64个字的第i%64位；Bitmap中位的排列与之相同
+// （SuperBlock头部已经改变，旧的磁盘映像仍需重新格式化，这里只比较位图本身）
+TEST(SuperBlockTest, TestBitmapLayout) {
+    static_assert(sizeof(Bitmap<Geometry512::BLOCK_COUNT>) == (Geometry512::BLOCK_COUNT + 63) / 64 * sizeof(uint64_t));
+    static_assert(sizeof(Bitmap<Geometry512::INODE_COUNT>) == (Geometry512::INODE_COUNT + 63) / 64 * sizeof(uint64_t));
+    static_assert(sizeof(Bitmap<3968>) == 62 * sizeof(uint64_t));
+    uint64_t old_image[62] = {};
+    for (uint32_t i: {1u, 63u, 64u, 1000u, 3967u}) {
+        old_image[i / 64] |= 1ull << (i % 64);
+    }
+    Bitmap<3968> bitmap;
+    std::memcpy(&bitmap, old_image, sizeof(bitmap));
+    for (uint32_t i = 0; i < 3968; i++) {
+        EXPECT_EQ(bitmap.test(i), (old_image[i / 64] >> (i % 64) & 1) != 0) << i;
+    }
+    EXPECT_EQ(bitmap.count(), 5);
+    EXPECT_TRUE(bitmap.test(1000));
+    EXPECT_FALSE(bitmap.test(999));
+}
+
+// 按字查找：跨字边界、跳过长段全1（覆盖AVX2路径）、查找范围的上界
+TEST(SuperBlockTest, TestBitmapFind) {
+    Bitmap<4096> bitmap;
+    EXPECT_EQ(bitmap.find_zero(0, 4096), 0);
+    EXPECT_EQ(bitmap.find_one(0, 4096), bitmap.NPOS);
+
+    bitmap.set_range(0, 3000);
+    EXPECT_EQ(bitmap.count(), 3000);
+    EXPECT_EQ(bitmap.find_zero(0, 4096), 3000);
+    EXPECT_EQ(bitmap.find_zero(5, 3000), bitmap.NPOS);
+    EXPECT_EQ(bitmap.find_one(3000, 4096), bitmap.NPOS);
+    bitmap.reset(1234);
+    EXPECT_EQ(bitmap.find_zero(0, 4096), 1234);
+    EXPECT_EQ(bitmap.find_zero(1235, 4096), 3000);
+    EXPECT_EQ(bitmap.find_one(3000, 4096), bitmap.NPOS);
+    bitmap.set(4000);
+    EXPECT_EQ(bitmap.find_one(3000, 4096), 4000);
+    EXPECT_EQ(bitmap.find_one(3000, 4000), bitmap.NPOS);
+
+    // 连续的0：1234处只有1位，3000开始有1000位
+    EXPECT_EQ(bitmap.find_zero_run(1, 0, 4096), 1234);
+    EXPECT_EQ(bitmap.find_zero_run(2, 0, 4096), 3000);
+    EXPECT_EQ(bitmap.find_zero_run(1000, 0, 4096), 3000);
+    EXPECT_EQ(bitmap.find_zero_run(1001, 0, 4096), bitmap.NPOS);
+    EXPECT_EQ(bitmap.find_zero_run(95, 0, 4096), 3000);
+    EXPECT_EQ(bitmap.find_zero_run(95, 3990, 4096), 4001);
+
+    // 与逐位查找的结果比对
+    Bitmap<4096> random;
+    std::srand(20);
+    for (uint32_t i = 0; i < 4096; i++) {
+        if (std::rand() % 8 != 0) {
+            random.set(i);
+        }
+    }
+    for (uint32_t begin = 0; begin < 4096; begin += 37) {
+        uint32_t expected = begin;
+        while (expected < 4096 && random.test(expected)) {
+            expected++;
+        }
+        EXPECT_EQ(random.find_zero(begin, 4096), expected == 4096 ? random.NPOS : expected);
+    }
+}
+
+// 分配Block：跳过已分配的位，到末尾后回绕，不使用0号数据块
+TEST(SuperBlockTest, TestGetFreeBlock) {
+    auto sb = std::make_unique<SuperBlock>();
+    sb->block_bitmap.set_range(1, 100000);
+    EXPECT_EQ(sb->get_free_block(), 100001 + Geometry512::BLOCK_START_INDEX);
+    EXPECT_EQ(sb->last_i, 100002);
+    EXPECT_EQ(sb->dirty_flag, 1);
+
+    sb->block_bitmap.set_range(100002, Geometry512::BLOCK_COUNT - 100002);
+    sb->block_bitmap.reset(77);
+    EXPECT_EQ(sb->get_free_block(), 77 + Geometry512::BLOCK_START_INDEX);
+    EXPECT_FALSE(sb->block_bitmap.test(0));
+    EXPECT_THROW(sb->get_free_block(), std::runtime_error);
+
+    sb->block_bitmap.reset(500);
+    sb->block_bitmap.reset(501);
+    sb->block_bitmap.reset(1000);
+    sb->block_bitmap.reset(1001);
+    sb->block_bitmap.reset(1002);
+    EXPECT_EQ(sb->get_free_blocks(3), 1000 + Geometry512::BLOCK_START_INDEX);
+    EXPECT_EQ(sb->get_free_blocks(2), 500 + Geometry512::BLOCK_START_INDEX);
+    EXPECT_THROW(sb->get_free_blocks(1), std::runtime_error);
+}
+
+// 分配Inode：0号不使用，用完时抛出异常
+TEST(SuperBlockTest, TestGetFreeInode) {
+    auto sb = std::make_unique<SuperBlock>();
+    EXPECT_EQ(sb->get_free_inode(), 1);
+    EXPECT_EQ(sb->get_free_inode(), 2);
+    sb->inode_bitmap.set_range(3, Geometry512::INODE_COUNT - 4);
+    EXPECT_EQ(sb->get_free_inode(), Geometry512::INODE_COUNT - 1);
+    EXPECT_THROW(sb->get_free_inode(), std::runtime_error);
+    sb->inode_bitmap.reset(2);
+    EXPECT_EQ(sb->get_free_inode(), 2);
+}